@@ -14,6 +14,7 @@
 #include <stdint.h>
 #include <zephyr/kernel.h>
 #include <zephyr/net/coap.h>
+#include <zephyr/net/net_ip.h>
 #include <zephyr/net/tls_credentials.h>
 
 /**
@@ -44,6 +45,55 @@ struct golioth_tls {
 	size_t sec_tag_count;
 };
 
+/** Number of CoAP response classes counted by metrics (2.xx, 4.xx, 5.xx, other) */
+#define GOLIOTH_METRICS_RSP_CLASSES	4
+
+/** Number of round-trip time histogram buckets */
+#define GOLIOTH_METRICS_RTT_BUCKETS	8
+
+#ifdef CONFIG_GOLIOTH_METRICS
+/**
+ * @brief Runtime counters of Golioth client.
+ *
+ * Updated lock-free from hot paths. Use golioth_metrics_get() to obtain snapshot.
+ */
+struct golioth_metrics_counters {
+	atomic_t reqs_sent;
+	atomic_t retransmits;
+	atomic_t timeouts;
+	atomic_t responses[GOLIOTH_METRICS_RSP_CLASSES];
+	atomic_t rtt_hist[GOLIOTH_METRICS_RTT_BUCKETS];
+	atomic_t pending;
+	atomic_t pending_max;
+	atomic_t bytes_tx;
+	atomic_t bytes_rx;
+	atomic_t reconnects;
+	atomic_t handshakes;
+	atomic_t handshake_failures;
+	atomic_t handshake_last_ms;
+	atomic_t handshake_max_ms;
+	atomic_t handshake_total_ms;
+	atomic_t log_drops;
+	atomic_t heap_used;
+	atomic_t heap_used_max;
+};
+#endif
+
+#ifdef CONFIG_GOLIOTH_DNS_CACHE
+/**
+ * @brief Cached addresses of Golioth server.
+ */
+struct golioth_dns_cache {
+	char host[CONFIG_GOLIOTH_DNS_CACHE_HOST_MAX_LEN];
+	uint16_t port;
+	struct sockaddr addrs[CONFIG_GOLIOTH_DNS_CACHE_MAX_ADDRS];
+	socklen_t addrlens[CONFIG_GOLIOTH_DNS_CACHE_MAX_ADDRS];
+	uint8_t count;
+	int8_t good;
+	int64_t expiry;
+};
+#endif
+
 /**
  * @brief Represents a Golioth client instance.
  */
@@ -58,12 +108,39 @@ struct golioth_client {
 
 	struct coap_packet rx_packet;
 
+#ifdef CONFIG_GOLIOTH_RX_BUF_POOL
+	uint8_t *rx_buffer_next;
+	uint8_t *rx_buffer_spare;
+#endif
+
 	struct k_mutex lock;
+
+	/*
+	 * Socket is modified (on connect and close) with both rx_lock and tx_lock held, so holding
+	 * just one of them is enough for using it. This allows sending and receiving concurrently.
+	 *
+	 * Socket descriptor cannot be swapped atomically (RCU style) instead, as there is no grace
+	 * period in which a sender or receiver could still use closed descriptor: Zephyr reuses
+	 * descriptor numbers right after close, so a stale one might refer to unrelated socket. Held
+	 * rx_lock or tx_lock is what makes the descriptor valid until send or recv returns.
+	 */
+	struct k_mutex rx_lock;
+	struct k_mutex tx_lock;
 	int sock;
 
+#ifdef CONFIG_GOLIOTH_METRICS
+	struct golioth_metrics_counters metrics;
+#endif
+#ifdef CONFIG_GOLIOTH_DNS_CACHE
+	struct golioth_dns_cache dns_cache;
+#endif
+
 	sys_dlist_t coap_reqs;
-	bool coap_reqs_connected;
+	atomic_t coap_reqs_connected;
+	/* Lock-free stack of requests submitted by application threads */
+	atomic_ptr_t coap_reqs_submitted;
 	struct k_mutex coap_reqs_lock;
+	atomic_t coap_reqs_next_handle;
 
 	void (*on_connect)(struct golioth_client *client);
 
@@ -71,6 +148,7 @@ struct golioth_client {
 
 	struct golioth_rpc rpc;
 	struct golioth_settings settings;
+	struct golioth_lightdb_cache lightdb_cache;
 };
 
 static inline void golioth_lock(struct golioth_client *client)
@@ -83,6 +161,18 @@ static inline void golioth_unlock(struct golioth_client *client)
 	k_mutex_unlock(&client->lock);
 }
 
+static inline void golioth_sock_lock(struct golioth_client *client)
+{
+	k_mutex_lock(&client->rx_lock, K_FOREVER);
+	k_mutex_lock(&client->tx_lock, K_FOREVER);
+}
+
+static inline void golioth_sock_unlock(struct golioth_client *client)
+{
+	k_mutex_unlock(&client->tx_lock);
+	k_mutex_unlock(&client->rx_lock);
+}
+
 /**
  * @brief Initialize golioth client instance
  *
@@ -120,6 +210,51 @@ bool golioth_is_connected(struct golioth_client *client);
 int golioth_connect(struct golioth_client *client, const char *host,
 		    uint16_t port);
 
+/**
+ * @brief Take ownership of received datagram buffer
+ *
+ * Allows to use received payload (e.g. @a data member of @ref golioth_req_rsp) after returning
+ * from response callback, without copying it. Buffer containing received datagram is lent to the
+ * caller, while client continues receiving into fresh buffer from RX buffer pool (see
+ * CONFIG_GOLIOTH_RX_BUF_POOL).
+ *
+ * Can be called only from response callbacks, i.e. while received datagram is being processed.
+ * Buffer needs to be returned with golioth_rx_buf_release() once payload is no longer needed.
+ *
+ * @param client Client instance
+ * @param data Pointer to received data (e.g. @a data member of @ref golioth_req_rsp)
+ *
+ * @return Pointer to beginning of claimed buffer (@a data points inside it), to be passed to
+ *         golioth_rx_buf_release()
+ * @retval NULL When @a data does not point to received datagram or there is no free buffer in
+ *              the pool. Payload needs to be copied in that case.
+ */
+uint8_t *golioth_rx_buf_claim(struct golioth_client *client, const uint8_t *data);
+
+/**
+ * @brief Return buffer claimed with golioth_rx_buf_claim()
+ *
+ * Can be called from any thread.
+ *
+ * @param client Client instance
+ * @param buf Buffer returned by golioth_rx_buf_claim()
+ */
+void golioth_rx_buf_release(struct golioth_client *client, uint8_t *buf);
+
+/**
+ * @brief Check if DTLS Connection ID is used by client
+ *
+ * Connection ID is used when CONFIG_GOLIOTH_USE_CONNECTION_ID is enabled and server provided a
+ * Connection ID during handshake. In that case DTLS session survives change of device IP address
+ * or port (e.g. NAT rebinding).
+ *
+ * @param client Client instance
+ *
+ * @retval true When client is connected and sends Connection ID
+ * @retval false Otherwise
+ */
+bool golioth_connection_id_is_active(struct golioth_client *client);
+
 /**
  * @brief Disconnect from Golioth
  *
@@ -151,6 +286,22 @@ int golioth_set_proto_coap_dtls(struct golioth_client *client,
 				sec_tag_t *sec_tag_list,
 				size_t sec_tag_count);
 
+#if defined(CONFIG_GOLIOTH_PROTO_COAP_UDP) || defined(__DOXYGEN__)
+
+/**
+ * @brief Set plain UDP (no DTLS) as transport protocol
+ *
+ * Meant only for testing against local CoAP servers, as Golioth server accepts DTLS only. See
+ * CONFIG_GOLIOTH_PROTO_COAP_UDP.
+ *
+ * @param client Client instance
+ *
+ * @retval 0 On success
+ */
+int golioth_set_proto_coap_udp(struct golioth_client *client);
+
+#endif /* CONFIG_GOLIOTH_PROTO_COAP_UDP */
+
 /**
  * @brief Send CoAP packet to Golioth
  *
@@ -212,6 +363,9 @@ int golioth_send_hello(struct golioth_client *client);
  * Process incoming data on network socket. It does not block when there is no
  * more data, so it is best to use it with zsock_poll.
  *
+ * Up to CONFIG_GOLIOTH_RX_DRAIN_MAX datagrams queued on network socket are
+ * processed in a single call.
+ *
  * @param client Client instance
  *
  * @retval 0 On success
@@ -136,4 +136,29 @@ int golioth_fw_report_state(struct golioth_client *client,
 			    enum golioth_fw_state state,
 			    enum golioth_dfu_result result);
 
+/**
+ * @brief Report state of firmware, with options
+ *
+ * Same as golioth_fw_report_state(), but additionally accepts @p opts (e.g. with timeout).
+ *
+ * @param client Client instance
+ * @param package_name Package name of firmware
+ * @param current_version Current firmware version
+ * @param target_version Target firmware version
+ * @param state State of firmware
+ * @param result Result of downloading or updating firmware
+ * @param opts Request options (can be NULL)
+ *
+ * @retval 0 On success
+ * @retval -ETIMEDOUT Request timed out
+ * @retval <0 On other failure
+ */
+int golioth_fw_report_state_opts(struct golioth_client *client,
+				 const char *package_name,
+				 const char *current_version,
+				 const char *target_version,
+				 enum golioth_fw_state state,
+				 enum golioth_dfu_result result,
+				 const struct golioth_req_opts *opts);
+
 #endif /* GOLIOTH_INCLUDE_NET_GOLIOTH_FW_H_ */
@@ -7,7 +7,9 @@
 #ifndef GOLIOTH_INCLUDE_NET_GOLIOTH_LIGHTDB_H_
 #define GOLIOTH_INCLUDE_NET_GOLIOTH_LIGHTDB_H_
 
+#include <stdbool.h>
 #include <stdint.h>
+#include <zephyr/kernel.h>
 #include <zephyr/net/coap.h>
 #include <net/golioth/req.h>
 
@@ -21,12 +23,47 @@
 struct golioth_client;
 enum golioth_content_format;
 
+#if defined(CONFIG_GOLIOTH_LIGHTDB_CACHE)
+/**
+ * @brief Cached LightDB value, identified by its ETag
+ *
+ * All members are private and should not be accessed directly.
+ */
+struct golioth_lightdb_cache_entry {
+	/* Single allocation storing both NULL-terminated path and value */
+	uint8_t *path;
+	uint8_t *value;
+	size_t value_len;
+	int format;
+
+	uint8_t etag[8];
+	uint8_t etag_len;
+
+	int64_t last_used;
+};
+#endif
+
+/**
+ * @brief Per-client cache of LightDB values
+ */
+struct golioth_lightdb_cache {
+#if defined(CONFIG_GOLIOTH_LIGHTDB_CACHE)
+	struct k_mutex lock;
+	struct golioth_lightdb_cache_entry entries[CONFIG_GOLIOTH_LIGHTDB_CACHE_MAX_ENTRIES];
+#endif
+};
+
 /**
  * @brief Get value from Golioth's LightDB (callback based)
  *
  * Asynchronously request value from Golioth's LightDB and let @p cb be invoked when such value is
  * retrieved or some error condtition happens.
  *
+ * With CONFIG_GOLIOTH_LIGHTDB_CACHE enabled, ETag of previously received value is sent along with
+ * request. If value did not change, server responds with 2.03 Valid (without payload) and @p cb is
+ * invoked with locally cached value and @a valid flag set in response. @p cb is invoked with
+ * -ENODATA error if cached value was evicted in the meantime.
+ *
  * @warning Experimental API
  *
  * @param[in] client Client instance
@@ -42,11 +79,37 @@ int golioth_lightdb_get_cb(struct golioth_client *client, const uint8_t *path,
 			   enum golioth_content_format format,
 			   golioth_req_cb_t cb, void *user_data);
 
+/**
+ * @brief Get value from Golioth's LightDB (callback based, with options)
+ *
+ * Same as golioth_lightdb_get_cb(), but additionally accepts @p opts (e.g. for obtaining request
+ * handle, which can be passed to golioth_req_cancel()).
+ *
+ * @warning Experimental API
+ *
+ * @param[in] client Client instance
+ * @param[in] path LightDB resource path
+ * @param[in] format Requested format of payload
+ * @param[in] cb Callback executed on response received, timeout or error
+ * @param[in] user_data User data passed to @p cb
+ * @param[in] opts Request options (can be NULL)
+ *
+ * @retval 0 On success
+ * @retval <0 On failure
+ */
+int golioth_lightdb_get_cb_opts(struct golioth_client *client, const uint8_t *path,
+				enum golioth_content_format format,
+				golioth_req_cb_t cb, void *user_data,
+				const struct golioth_req_opts *opts);
+
 /**
  * @brief Get value from Golioth's LightDB (synchronous, into preallocated buffer)
  *
  * Synchronously get value from Golioth's LightDB and store it into preallocated buffer.
  *
+ * With CONFIG_GOLIOTH_LIGHTDB_CACHE enabled, unchanged value is copied from local cache, see
+ * golioth_lightdb_get_cb() for details.
+ *
  * @param[in] client Client instance
  * @param[in] path LightDB resource path
  * @param[in] format Requested format of payload
@@ -54,12 +117,35 @@ int golioth_lightdb_get_cb(struct golioth_client *client, const uint8_t *path,
  * @param[in,out] len Size of buffer on input, size of response on output
  *
  * @retval 0 On success
+ * @retval -ENOSPC Buffer is too small for received value
  * @retval <0 On failure
  */
 int golioth_lightdb_get(struct golioth_client *client, const uint8_t *path,
 			enum golioth_content_format format,
 			uint8_t *data, size_t *len);
 
+/**
+ * @brief Get value from Golioth's LightDB (synchronous, with options)
+ *
+ * Same as golioth_lightdb_get(), but additionally accepts @p opts (e.g. with timeout).
+ *
+ * @param[in] client Client instance
+ * @param[in] path LightDB resource path
+ * @param[in] format Requested format of payload
+ * @param[out] data Buffer for received data
+ * @param[in,out] len Size of buffer on input, size of response on output
+ * @param[in] opts Request options (can be NULL)
+ *
+ * @retval 0 On success
+ * @retval -ETIMEDOUT Request timed out
+ * @retval -ENOSPC Buffer is too small for received value
+ * @retval <0 On other failure
+ */
+int golioth_lightdb_get_opts(struct golioth_client *client, const uint8_t *path,
+			     enum golioth_content_format format,
+			     uint8_t *data, size_t *len,
+			     const struct golioth_req_opts *opts);
+
 /**
  * @brief Set value to Golioth's LightDB (callback based)
  *
@@ -84,6 +170,32 @@ int golioth_lightdb_set_cb(struct golioth_client *client, const uint8_t *path,
 			   const uint8_t *data, size_t data_len,
 			   golioth_req_cb_t cb, void *user_data);
 
+/**
+ * @brief Set value to Golioth's LightDB (callback based, with options)
+ *
+ * Same as golioth_lightdb_set_cb(), but additionally accepts @p opts (e.g. for obtaining request
+ * handle, which can be passed to golioth_req_cancel()).
+ *
+ * @warning Experimental API
+ *
+ * @param[in] client Client instance
+ * @param[in] path LightDB resource path
+ * @param[in] format Format of payload
+ * @param[in] data Payload data
+ * @param[in] data_len Payload length
+ * @param[in] cb Callback executed on response received, timeout or error
+ * @param[in] user_data User data passed to @p cb
+ * @param[in] opts Request options (can be NULL)
+ *
+ * @retval 0 On success
+ * @retval <0 On failure
+ */
+int golioth_lightdb_set_cb_opts(struct golioth_client *client, const uint8_t *path,
+				enum golioth_content_format format,
+				const uint8_t *data, size_t data_len,
+				golioth_req_cb_t cb, void *user_data,
+				const struct golioth_req_opts *opts);
+
 /**
  * @brief Set value to Golioth's LightDB (synchronously)
  *
@@ -102,12 +214,45 @@ int golioth_lightdb_set(struct golioth_client *client, const uint8_t *path,
 			enum golioth_content_format format,
 			const uint8_t *data, size_t data_len);
 
+/**
+ * @brief Set value to Golioth's LightDB (synchronous, with options)
+ *
+ * Same as golioth_lightdb_set(), but additionally accepts @p opts (e.g. with timeout).
+ *
+ * @param[in] client Client instance
+ * @param[in] path LightDB resource path
+ * @param[in] format Format of payload
+ * @param[in] data Payload data
+ * @param[in] data_len Payload length
+ * @param[in] opts Request options (can be NULL)
+ *
+ * @retval 0 On success
+ * @retval -ETIMEDOUT Request timed out
+ * @retval <0 On other failure
+ */
+int golioth_lightdb_set_opts(struct golioth_client *client, const uint8_t *path,
+			     enum golioth_content_format format,
+			     const uint8_t *data, size_t data_len,
+			     const struct golioth_req_opts *opts);
+
 /**
  * @brief Observe value in Golioth's LightDB (callback based)
  *
  * Asynchronously request to observe value in Golioth's LightDB and let @p cb be invoked when such
  * value is retrieved (for the first time or after an update) or some error condition happens.
  *
+ * Observation is kept across reconnects and registered again automatically after connecting, so
+ * it is enough to call this function once (even before client is connected). Calling it again with
+ * the same parameters (e.g. from on_connect callback) has no effect.
+ *
+ * Observation (and @p user_data) is in use until it is stopped with golioth_observe_stop(), or
+ * cancelled with golioth_observe_cancel_all() or golioth_system_client_stop(). In all cases @p cb
+ * is invoked with -ECANCELED error as the last time.
+ *
+ * With CONFIG_GOLIOTH_LIGHTDB_CACHE enabled, ETag of cached value is sent when registering
+ * observation, so unchanged value is not transferred again. See golioth_lightdb_get_cb() for
+ * details.
+ *
  * @warning Experimental API
  *
  * @param[in] client Client instance
@@ -123,6 +268,29 @@ int golioth_lightdb_observe_cb(struct golioth_client *client, const uint8_t *pat
 			       enum golioth_content_format format,
 			       golioth_req_cb_t cb, void *user_data);
 
+/**
+ * @brief Observe value in Golioth's LightDB (callback based, with options)
+ *
+ * Same as golioth_lightdb_observe_cb(), but additionally accepts @p opts. Handle of observation
+ * obtained with @a handle member of @p opts can be passed to golioth_observe_stop().
+ *
+ * @warning Experimental API
+ *
+ * @param[in] client Client instance
+ * @param[in] path LightDB resource path
+ * @param[in] format Requested format of payload
+ * @param[in] cb Callback executed on response received, timeout or error
+ * @param[in] user_data User data passed to @p cb
+ * @param[in] opts Request options (can be NULL)
+ *
+ * @retval 0 On success
+ * @retval <0 On failure
+ */
+int golioth_lightdb_observe_cb_opts(struct golioth_client *client, const uint8_t *path,
+				    enum golioth_content_format format,
+				    golioth_req_cb_t cb, void *user_data,
+				    const struct golioth_req_opts *opts);
+
 /**
  * @brief Delete value in Golioth's LightDB (callback based)
  *
@@ -142,6 +310,27 @@ int golioth_lightdb_observe_cb(struct golioth_client *client, const uint8_t *pat
 int golioth_lightdb_delete_cb(struct golioth_client *client, const uint8_t *path,
 			      golioth_req_cb_t cb, void *user_data);
 
+/**
+ * @brief Delete value in Golioth's LightDB (callback based, with options)
+ *
+ * Same as golioth_lightdb_delete_cb(), but additionally accepts @p opts (e.g. for obtaining
+ * request handle, which can be passed to golioth_req_cancel()).
+ *
+ * @warning Experimental API
+ *
+ * @param[in] client Client instance
+ * @param[in] path LightDB resource path
+ * @param[in] cb Callback executed on response received, timeout or error
+ * @param[in] user_data User data passed to @p cb
+ * @param[in] opts Request options (can be NULL)
+ *
+ * @retval 0 On success
+ * @retval <0 On failure
+ */
+int golioth_lightdb_delete_cb_opts(struct golioth_client *client, const uint8_t *path,
+				   golioth_req_cb_t cb, void *user_data,
+				   const struct golioth_req_opts *opts);
+
 /**
  * @brief Delete value in Golioth's LightDB (synchronous)
  *
@@ -155,6 +344,153 @@ int golioth_lightdb_delete_cb(struct golioth_client *client, const uint8_t *path
  */
 int golioth_lightdb_delete(struct golioth_client *client, const uint8_t *path);
 
+/**
+ * @brief Delete value in Golioth's LightDB (synchronous, with options)
+ *
+ * Same as golioth_lightdb_delete(), but additionally accepts @p opts (e.g. with timeout).
+ *
+ * @param[in] client Client instance
+ * @param[in] path LightDB resource path
+ * @param[in] opts Request options (can be NULL)
+ *
+ * @retval 0 On success
+ * @retval -ETIMEDOUT Request timed out
+ * @retval <0 On other failure
+ */
+int golioth_lightdb_delete_opts(struct golioth_client *client, const uint8_t *path,
+				const struct golioth_req_opts *opts);
+
+#ifdef CONFIG_GOLIOTH_LIGHTDB_BATCH
+
+/**
+ * @brief Type of value in LightDB batch set item
+ */
+enum golioth_lightdb_value_type {
+	GOLIOTH_LIGHTDB_VALUE_INT,
+	GOLIOTH_LIGHTDB_VALUE_FLOAT,
+	GOLIOTH_LIGHTDB_VALUE_BOOL,
+	GOLIOTH_LIGHTDB_VALUE_STRING,
+};
+
+/**
+ * @brief Single (path, value) pair of LightDB batch set request
+ */
+struct golioth_lightdb_set_item {
+	const char *path;
+	enum golioth_lightdb_value_type type;
+	union {
+		int64_t i64;
+		double f;
+		bool b;
+		const char *str;
+	};
+};
+
+#define GOLIOTH_LIGHTDB_SET_ITEM_INT(_path, _value)			\
+	{ .path = (_path), .type = GOLIOTH_LIGHTDB_VALUE_INT, .i64 = (_value) }
+
+#define GOLIOTH_LIGHTDB_SET_ITEM_FLOAT(_path, _value)			\
+	{ .path = (_path), .type = GOLIOTH_LIGHTDB_VALUE_FLOAT, .f = (_value) }
+
+#define GOLIOTH_LIGHTDB_SET_ITEM_BOOL(_path, _value)			\
+	{ .path = (_path), .type = GOLIOTH_LIGHTDB_VALUE_BOOL, .b = (_value) }
+
+#define GOLIOTH_LIGHTDB_SET_ITEM_STRING(_path, _value)			\
+	{ .path = (_path), .type = GOLIOTH_LIGHTDB_VALUE_STRING, .str = (_value) }
+
+/**
+ * @brief Single path of LightDB batch get request
+ *
+ * @a cb is invoked with CBOR encoded value of @a path, with -ENOENT error when there is no such
+ * value or with error of whole batch request.
+ */
+struct golioth_lightdb_get_item {
+	const char *path;
+	golioth_req_cb_t cb;
+	void *user_data;
+};
+
+/**
+ * @brief Set multiple values in Golioth's LightDB (callback based)
+ *
+ * Encode all items into single CBOR map and send it with a single request to the common parent
+ * path of all items. This is equivalent to setting each of items separately, but needs just one
+ * round-trip.
+ *
+ * All items need to be direct children of common parent path, e.g. "sensor/temp" and
+ * "sensor/hum" (common parent "sensor") or "temp" and "hum" (LightDB root).
+ *
+ * @warning Experimental API
+ *
+ * @param[in] client Client instance
+ * @param[in] items Array of (path, value) pairs
+ * @param[in] num_items Number of @p items
+ * @param[in] cb Callback executed on response received, timeout or error
+ * @param[in] user_data User data passed to @p cb
+ *
+ * @retval 0 On success
+ * @retval -EINVAL Items do not share common parent or path is duplicated
+ * @retval -ENOMEM Encoded items exceed CONFIG_GOLIOTH_LIGHTDB_BATCH_MAX_LEN
+ * @retval <0 On other failure
+ */
+int golioth_lightdb_set_batch_cb(struct golioth_client *client,
+				 const struct golioth_lightdb_set_item *items, size_t num_items,
+				 golioth_req_cb_t cb, void *user_data);
+
+/**
+ * @brief Set multiple values in Golioth's LightDB (synchronous)
+ *
+ * Synchronous version of golioth_lightdb_set_batch_cb().
+ *
+ * @param[in] client Client instance
+ * @param[in] items Array of (path, value) pairs
+ * @param[in] num_items Number of @p items
+ *
+ * @retval 0 On success
+ * @retval <0 On failure
+ */
+int golioth_lightdb_set_batch(struct golioth_client *client,
+			      const struct golioth_lightdb_set_item *items, size_t num_items);
+
+/**
+ * @brief Get multiple values from Golioth's LightDB (callback based)
+ *
+ * Request value of common parent path of all items with a single request and split response
+ * into per-item callbacks. Each callback receives CBOR encoded value of its path.
+ *
+ * Items (and paths) are copied, so they do not need to be valid after this function returns.
+ * Restrictions on paths are the same as in golioth_lightdb_set_batch_cb().
+ *
+ * @warning Experimental API
+ *
+ * @param[in] client Client instance
+ * @param[in] items Array of paths with their callbacks
+ * @param[in] num_items Number of @p items
+ *
+ * @retval 0 On success
+ * @retval <0 On failure
+ */
+int golioth_lightdb_get_batch_cb(struct golioth_client *client,
+				 const struct golioth_lightdb_get_item *items, size_t num_items);
+
+/**
+ * @brief Get multiple values from Golioth's LightDB (synchronous)
+ *
+ * Synchronous version of golioth_lightdb_get_batch_cb(). Item callbacks are invoked from the
+ * calling thread before this function returns.
+ *
+ * @param[in] client Client instance
+ * @param[in] items Array of paths with their callbacks
+ * @param[in] num_items Number of @p items
+ *
+ * @retval 0 On success
+ * @retval <0 On failure
+ */
+int golioth_lightdb_get_batch(struct golioth_client *client,
+			      const struct golioth_lightdb_get_item *items, size_t num_items);
+
+#endif /* CONFIG_GOLIOTH_LIGHTDB_BATCH */
+
 /** @} */
 
 #endif /* GOLIOTH_INCLUDE_NET_GOLIOTH_LIGHTDB_H_ */
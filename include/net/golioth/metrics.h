@@ -0,0 +1,143 @@
+/*
+ * Copyright (c) 2023 Golioth, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef GOLIOTH_INCLUDE_NET_GOLIOTH_METRICS_H_
+#define GOLIOTH_INCLUDE_NET_GOLIOTH_METRICS_H_
+
+#include <net/golioth.h>
+#include <stdint.h>
+
+/**
+ * @defgroup golioth_metrics Golioth Client Metrics
+ * @ingroup net
+ * Runtime statistics of Golioth client
+ * @{
+ */
+
+/**
+ * @brief Class of received CoAP response
+ */
+enum golioth_metrics_rsp_class {
+	/** 2.xx Success */
+	GOLIOTH_METRICS_RSP_SUCCESS,
+	/** 4.xx Client Error */
+	GOLIOTH_METRICS_RSP_CLIENT_ERROR,
+	/** 5.xx Server Error */
+	GOLIOTH_METRICS_RSP_SERVER_ERROR,
+	/** Other, e.g. empty ACK of separate response */
+	GOLIOTH_METRICS_RSP_OTHER,
+};
+
+/**
+ * @brief Upper bounds (in milliseconds) of round-trip time histogram buckets
+ *
+ * Last bucket (not listed) collects all samples above the last bound.
+ */
+#define GOLIOTH_METRICS_RTT_BUCKET_BOUNDS_MS	{ 50, 100, 200, 500, 1000, 2000, 5000 }
+
+/**
+ * @brief Statistics of (D)TLS handshakes performed by Golioth client
+ *
+ * Useful for measuring benefit of session resumption (see CONFIG_GOLIOTH_TLS_SESSION_CACHE), as
+ * abbreviated handshakes are considerably shorter than full ones.
+ */
+struct golioth_handshake_stats {
+	/** Number of successful handshakes */
+	uint32_t count;
+	/** Number of failed connection attempts (including handshake failures) */
+	uint32_t failures;
+	/** Duration of last successful handshake in milliseconds */
+	uint32_t last_ms;
+	/** Duration of longest successful handshake in milliseconds */
+	uint32_t max_ms;
+	/** Sum of durations of all successful handshakes in milliseconds */
+	uint32_t total_ms;
+};
+
+/**
+ * @brief Snapshot of Golioth client metrics
+ *
+ * Counters are accumulated since client initialization or last golioth_metrics_reset() call.
+ */
+struct golioth_metrics {
+	/** Number of requests transmitted for the first time */
+	uint32_t reqs_sent;
+	/** Number of request retransmissions */
+	uint32_t retransmits;
+	/** Number of requests, which timed out (all retransmissions or deadline elapsed) */
+	uint32_t timeouts;
+	/** Number of received responses, indexed by #golioth_metrics_rsp_class */
+	uint32_t responses[GOLIOTH_METRICS_RSP_CLASSES];
+	/**
+	 * Histogram of round-trip times, measured from last (re)transmission of request until
+	 * response. See #GOLIOTH_METRICS_RTT_BUCKET_BOUNDS_MS for bucket bounds.
+	 */
+	uint32_t rtt_hist[GOLIOTH_METRICS_RTT_BUCKETS];
+	/** Current number of requests (including observations) in pending list */
+	uint32_t pending;
+	/** High-water mark of @a pending */
+	uint32_t pending_max;
+	/** Number of bytes sent to socket (CoAP layer, without (D)TLS overhead) */
+	uint32_t bytes_tx;
+	/** Number of bytes received from socket (CoAP layer, without (D)TLS overhead) */
+	uint32_t bytes_rx;
+	/** Number of connections re-established by system client (first one after start excluded) */
+	uint32_t reconnects;
+	/** Statistics of (D)TLS handshakes */
+	struct golioth_handshake_stats handshake;
+	/** Number of log messages dropped by Golioth logging backend */
+	uint32_t log_drops;
+	/** Heap memory (in bytes) currently allocated for requests */
+	uint32_t heap_used;
+	/** High-water mark of @a heap_used */
+	uint32_t heap_used_max;
+};
+
+/**
+ * @brief Get snapshot of client metrics
+ *
+ * @param[in] client Client instance
+ * @param[out] metrics Metrics to be filled
+ */
+void golioth_metrics_get(struct golioth_client *client, struct golioth_metrics *metrics);
+
+/**
+ * @brief Reset client metrics
+ *
+ * Resets all counters and high-water marks. Gauges (@a pending and @a heap_used) are kept, as they
+ * reflect current state.
+ *
+ * @param[in] client Client instance
+ */
+void golioth_metrics_reset(struct golioth_client *client);
+
+/**
+ * @brief Report client metrics to LightDB Stream
+ *
+ * Pushes JSON encoded snapshot of metrics to CONFIG_GOLIOTH_METRICS_REPORT_PATH stream path.
+ * Called periodically for the default system client instance (GOLIOTH_SYSTEM_CLIENT_GET()) when
+ * CONFIG_GOLIOTH_METRICS_REPORT is enabled. Other instances need to be reported by application.
+ *
+ * @param[in] client Client instance
+ *
+ * @retval 0 On success
+ * @retval <0 On failure
+ */
+int golioth_metrics_report(struct golioth_client *client);
+
+/**
+ * @brief Account log messages dropped by logging backend
+ *
+ * Meant to be called by Golioth logging backend.
+ *
+ * @param[in] client Client instance
+ * @param[in] cnt Number of dropped messages
+ */
+void golioth_metrics_log_dropped(struct golioth_client *client, uint32_t cnt);
+
+/** @} */
+
+#endif /* GOLIOTH_INCLUDE_NET_GOLIOTH_METRICS_H_ */
@@ -7,6 +7,7 @@
 #ifndef GOLIOTH_INCLUDE_NET_GOLIOTH_REQ_H_
 #define GOLIOTH_INCLUDE_NET_GOLIOTH_REQ_H_
 
+#include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
 
@@ -40,6 +41,13 @@ struct golioth_req_rsp {
 
 	void *user_data;
 
+	/* ETag option of received response (etag_len is 0 if not present) */
+	const uint8_t *etag;
+	size_t etag_len;
+
+	/* 2.03 Valid was received, i.e. representation identified by sent ETag is still current */
+	bool valid;
+
 	int err;
 };
 
@@ -50,4 +58,120 @@ struct golioth_req_rsp {
  */
 typedef int (*golioth_req_cb_t)(struct golioth_req_rsp *rsp);
 
+/**
+ * @brief Priority class of request
+ *
+ * Class determines retransmission parameters (number of retries and initial ACK timeout, see
+ * CONFIG_GOLIOTH_COAP_REQ_* options) and the order in which requests are transmitted, which
+ * matters when number of requests in flight is limited (CONFIG_GOLIOTH_COAP_REQ_MAX_IN_FLIGHT).
+ */
+enum golioth_req_priority {
+	/** Default class of the API, interactive for most requests */
+	GOLIOTH_REQ_PRIORITY_DEFAULT = 0,
+	/** Interactive traffic, e.g. LightDB get/set */
+	GOLIOTH_REQ_PRIORITY_INTERACTIVE,
+	/** Control traffic, e.g. RPC and settings status, firmware state (transmitted first) */
+	GOLIOTH_REQ_PRIORITY_CONTROL,
+	/** Bulk traffic, e.g. large stream pushes (transmitted last) */
+	GOLIOTH_REQ_PRIORITY_BULK,
+};
+
+/** Value of request handle, which never identifies any request */
+#define GOLIOTH_REQ_HANDLE_INVALID	0
+
+/** Value of golioth_req_opts.max_retries, which disables retransmissions */
+#define GOLIOTH_REQ_NO_RETRIES		-1
+
+/** Maximum value of golioth_req_opts.ack_timeout_ms */
+#define GOLIOTH_REQ_ACK_TIMEOUT_MAX_MS	60000
+
+/**
+ * @brief Options of user request
+ *
+ * All members are optional, so zero-initialized structure results in default behavior.
+ */
+struct golioth_req_opts {
+	/**
+	 * Time in milliseconds to wait for completion of synchronous request. Request is cancelled
+	 * and -ETIMEDOUT is returned when it elapses. 0 means waiting until response is received,
+	 * all retransmissions time out or client disconnects. Ignored by asynchronous requests.
+	 */
+	int32_t timeout_ms;
+
+	/**
+	 * Handle of scheduled request is stored here (if not NULL), so it can be cancelled with
+	 * golioth_req_cancel(), e.g. from another thread.
+	 */
+	uint32_t *handle;
+
+	/** Priority class of request (0 means default class of the API) */
+	enum golioth_req_priority priority;
+
+	/**
+	 * Maximum number of retransmissions. 0 means default of priority class. Use
+	 * #GOLIOTH_REQ_NO_RETRIES to transmit request just once.
+	 */
+	int8_t max_retries;
+
+	/**
+	 * Initial ACK timeout in milliseconds, doubled with each retransmission. 0 means default
+	 * of priority class. Values above #GOLIOTH_REQ_ACK_TIMEOUT_MAX_MS are rejected with
+	 * -EINVAL.
+	 */
+	uint32_t ack_timeout_ms;
+
+	/**
+	 * Total time in milliseconds, after which request is abandoned (including all
+	 * retransmissions and blockwise transfer) and its callback is invoked with -ETIMEDOUT
+	 * error. 0 means no deadline. Useful for data, which is worthless after some time (e.g.
+	 * telemetry samples). Ignored by observations.
+	 */
+	uint32_t deadline_ms;
+};
+
+struct golioth_client;
+
+/**
+ * @brief Cancel scheduled request
+ *
+ * Request is removed and freed. Its callback (if any) is invoked with -ECANCELED error before
+ * this function returns, so associated user data can be released right after that. Synchronous
+ * request returns -ECANCELED.
+ *
+ * @param[in] client Client instance
+ * @param[in] handle Handle of request, obtained with @a handle member of #golioth_req_opts
+ *
+ * @retval 0 On success
+ * @retval -ENOENT Request is already completed (or handle is invalid)
+ */
+int golioth_req_cancel(struct golioth_client *client, uint32_t handle);
+
+/**
+ * @brief Stop observation
+ *
+ * Observation is removed and freed, with its callback invoked with -ECANCELED error before this
+ * function returns. Deregistration request (GET with Observe option set to 1) is sent, so that
+ * server stops sending notifications.
+ *
+ * @param[in] client Client instance
+ * @param[in] handle Handle of observation, obtained with @a handle member of #golioth_req_opts
+ *
+ * @retval 0 On success
+ * @retval -ENOENT There is no such observation (or handle is invalid)
+ * @retval -EINVAL Handle does not identify an observation
+ */
+int golioth_observe_stop(struct golioth_client *client, uint32_t handle);
+
+/**
+ * @brief Cancel all observations
+ *
+ * All observations, both registered and suspended while client is disconnected, are removed and
+ * freed, with their callbacks invoked with -ECANCELED error before this function returns. No
+ * deregistration request is sent, so this is meant to be used when client is stopped for good.
+ * golioth_system_client_stop() does that after disconnecting.
+ *
+ * @param[in] client Client instance
+ */
+void golioth_observe_cancel_all(struct golioth_client *client);
+
 #endif /* GOLIOTH_INCLUDE_NET_GOLIOTH_REQ_H_ */
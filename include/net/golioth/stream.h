@@ -11,6 +11,10 @@
 #include <zephyr/net/coap.h>
 #include <net/golioth/req.h>
 
+#ifdef CONFIG_GOLIOTH_STREAM_CBOR
+#include <zcbor_encode.h>
+#endif
+
 /**
  * @defgroup golioth_stream Golioth LightDB Stream
  * @ingroup net
@@ -42,6 +46,30 @@ int golioth_stream_push_cb(struct golioth_client *client, const uint8_t *path,
 			   const uint8_t *data, size_t data_len,
 			   golioth_req_cb_t cb, void *user_data);
 
+/**
+ * @brief Push value to Golioth's LightDB Stream (callback based, with options)
+ *
+ * Same as golioth_stream_push_cb(), but additionally accepts @p opts (e.g. for obtaining request
+ * handle, which can be passed to golioth_req_cancel()).
+ *
+ * @param[in] client Client instance
+ * @param[in] path LightDB Stream resource path
+ * @param[in] format Format of payload
+ * @param[in] data Payload data
+ * @param[in] data_len Payload length
+ * @param[in] cb Callback executed on response received, timeout or error
+ * @param[in] user_data User data passed to @p cb
+ * @param[in] opts Request options (can be NULL)
+ *
+ * @retval 0 On success
+ * @retval <0 On failure
+ */
+int golioth_stream_push_cb_opts(struct golioth_client *client, const uint8_t *path,
+				enum golioth_content_format format,
+				const uint8_t *data, size_t data_len,
+				golioth_req_cb_t cb, void *user_data,
+				const struct golioth_req_opts *opts);
+
 /**
  * @brief Push value to Golioth's LightDB Stream (synchronously)
  *
@@ -60,6 +88,147 @@ int golioth_stream_push(struct golioth_client *client, const uint8_t *path,
 			enum golioth_content_format format,
 			const uint8_t *data, size_t data_len);
 
+/**
+ * @brief Push value to Golioth's LightDB Stream (synchronously, with options)
+ *
+ * Same as golioth_stream_push(), but additionally accepts @p opts (e.g. with timeout).
+ *
+ * @param[in] client Client instance
+ * @param[in] path LightDB Stream resource path
+ * @param[in] format Format of payload
+ * @param[in] data Payload data
+ * @param[in] data_len Payload length
+ * @param[in] opts Request options (can be NULL)
+ *
+ * @retval 0 On success
+ * @retval -ETIMEDOUT Request timed out
+ * @retval <0 On other failure
+ */
+int golioth_stream_push_opts(struct golioth_client *client, const uint8_t *path,
+			     enum golioth_content_format format,
+			     const uint8_t *data, size_t data_len,
+			     const struct golioth_req_opts *opts);
+
+#ifdef CONFIG_GOLIOTH_STREAM_CBOR
+
+/** Number of zcbor encoder states needed by @ref golioth_stream_cbor */
+#define GOLIOTH_STREAM_CBOR_NUM_STATES	(1 /* num_backups */ + 2)
+
+/**
+ * @brief Typed LightDB Stream sample builder
+ *
+ * Encoder context, which appends named fields into CBOR map stored in preallocated buffer. Once
+ * all fields of a sample are appended, the map is pushed to LightDB Stream with
+ * golioth_stream_cbor_push() or golioth_stream_cbor_push_cb(). After push the context is ready for
+ * encoding the next sample, so it can be reused without reinitialization.
+ *
+ * All members are private and should not be accessed directly.
+ */
+struct golioth_stream_cbor {
+	struct golioth_client *client;
+	const uint8_t *path;
+
+	uint8_t *buf;
+	size_t buf_len;
+
+	zcbor_state_t zse[GOLIOTH_STREAM_CBOR_NUM_STATES];
+};
+
+/**
+ * @brief Initialize typed LightDB Stream sample builder
+ *
+ * @param[out] ctx Sample builder context
+ * @param[in] client Client instance
+ * @param[in] path LightDB Stream resource path (empty string for root path)
+ * @param[in] buf Buffer for encoded sample, which needs to be valid as long as @p ctx is used
+ * @param[in] buf_len Length of @p buf
+ */
+void golioth_stream_cbor_init(struct golioth_stream_cbor *ctx,
+			      struct golioth_client *client, const uint8_t *path,
+			      uint8_t *buf, size_t buf_len);
+
+/**
+ * @brief Discard all fields appended so far to the sample
+ *
+ * @param[inout] ctx Sample builder context
+ */
+void golioth_stream_cbor_reset(struct golioth_stream_cbor *ctx);
+
+/**
+ * @brief Append integer field to the sample
+ *
+ * @param[inout] ctx Sample builder context
+ * @param[in] name Field name
+ * @param[in] value Field value
+ *
+ * @retval 0 On success
+ * @retval -ENOMEM Not enough space in buffer
+ */
+int golioth_stream_cbor_add_int(struct golioth_stream_cbor *ctx,
+				const char *name, int64_t value);
+
+/**
+ * @brief Append floating point field to the sample
+ *
+ * Value is encoded as single-precision CBOR float.
+ *
+ * @param[inout] ctx Sample builder context
+ * @param[in] name Field name
+ * @param[in] value Field value
+ *
+ * @retval 0 On success
+ * @retval -ENOMEM Not enough space in buffer
+ */
+int golioth_stream_cbor_add_float(struct golioth_stream_cbor *ctx,
+				  const char *name, float value);
+
+/**
+ * @brief Append boolean field to the sample
+ *
+ * @param[inout] ctx Sample builder context
+ * @param[in] name Field name
+ * @param[in] value Field value
+ *
+ * @retval 0 On success
+ * @retval -ENOMEM Not enough space in buffer
+ */
+int golioth_stream_cbor_add_bool(struct golioth_stream_cbor *ctx,
+				 const char *name, bool value);
+
+/**
+ * @brief Push built sample to Golioth's LightDB Stream (callback based)
+ *
+ * Finalizes CBOR map and asynchronously pushes it to LightDB Stream. Encoded sample is copied
+ * into request, so the context is reset and ready for the next sample as soon as this function
+ * returns (regardless of result).
+ *
+ * @warning Experimental API
+ *
+ * @param[inout] ctx Sample builder context
+ * @param[in] cb Callback executed on response received, timeout or error
+ * @param[in] user_data User data passed to @p cb
+ *
+ * @retval 0 On success
+ * @retval <0 On failure
+ */
+int golioth_stream_cbor_push_cb(struct golioth_stream_cbor *ctx,
+				golioth_req_cb_t cb, void *user_data);
+
+/**
+ * @brief Push built sample to Golioth's LightDB Stream (synchronously)
+ *
+ * Finalizes CBOR map and synchronously pushes it to LightDB Stream. The context is reset and
+ * ready for the next sample when this function returns (regardless of result).
+ *
+ * @param[inout] ctx Sample builder context
+ *
+ * @retval 0 On success
+ * @retval <0 On failure
+ */
+int golioth_stream_cbor_push(struct golioth_stream_cbor *ctx);
+
+#endif /* CONFIG_GOLIOTH_STREAM_CBOR */
+
 /** @} */
 
 #endif /* GOLIOTH_INCLUDE_NET_GOLIOTH_STREAM_H_ */
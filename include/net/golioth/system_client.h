@@ -8,8 +8,9 @@
 #define GOLIOTH_INCLUDE_NET_GOLIOTH_SYSTEM_CLIENT_H_
 
 #include <net/golioth.h>
-
-extern struct golioth_client _golioth_system_client;
+#include <zephyr/kernel.h>
+#include <zephyr/net/socket.h>
+#include <zephyr/net/tls_credentials.h>
 
 /**
  * @defgroup system_client Golioth System Client
@@ -17,6 +18,230 @@ extern struct golioth_client _golioth_system_client;
  * @{
  */
 
+/** Maximum length of server host (including NULL terminator) */
+#define GOLIOTH_SYSTEM_CLIENT_HOST_MAX_LEN	64
+
+struct golioth_system_client_loop;
+
+/**
+ * @brief Configuration of system client instance
+ */
+struct golioth_system_client_config {
+	/** Hostname or IP address of Golioth server */
+	const char *host;
+	/** Port number of Golioth server */
+	uint16_t port;
+	/**
+	 * Secure tag of TLS credentials (e.g. PSK-ID and PSK) of this instance. With certificate
+	 * authentication, CA certificate of Golioth server is registered under this tag by
+	 * golioth_system_client_init(), unless application has provisioned one already.
+	 */
+	sec_tag_t sec_tag;
+	/** Buffer for receiving data from network socket */
+	uint8_t *rx_buffer;
+	/** Size of @a rx_buffer */
+	size_t rx_buffer_len;
+	/**
+	 * Shared loop driving this instance. When NULL, instance runs its own thread
+	 * (@a thread, @a stack, @a stack_size and @a priority). Otherwise thread related members
+	 * are ignored.
+	 */
+	struct golioth_system_client_loop *loop;
+	/** Thread object of instance thread */
+	struct k_thread *thread;
+	/** Stack of instance thread */
+	k_thread_stack_t *stack;
+	/** Size of @a stack, as returned by K_THREAD_STACK_SIZEOF() */
+	size_t stack_size;
+	/** Priority of instance thread */
+	int priority;
+};
+
+/**
+ * @brief System client instance
+ *
+ * Golioth client together with the thread, which connects it to the server, reconnects in case of
+ * networking issues, keeps connection alive and processes received data.
+ *
+ * All members are private and should not be accessed directly. Use
+ * golioth_system_client_get_client() to obtain client instance, which can be passed to LightDB,
+ * Stream and other APIs.
+ */
+struct golioth_system_client {
+	struct golioth_client client;
+
+	char host[GOLIOTH_SYSTEM_CLIENT_HOST_MAX_LEN];
+	uint16_t port;
+	sec_tag_t sec_tag_list[1];
+
+	struct zsock_pollfd fds[2];
+	atomic_t flags;
+
+	int64_t reconnect_expiry;
+	uint16_t reconnect_attempts;
+	/* Connected since started, so next connection is counted as reconnect */
+	bool connected_once;
+	int64_t recv_expiry;
+	int64_t ping_expiry;
+
+	/* Keepalive */
+	int32_t ping_interval;
+	int32_t ping_interval_limit;
+	int32_t ping_interval_suspect;
+	uint16_t ping_successes;
+	bool ping_pending;
+	bool rx_seen;
+	bool cid_probe;
+};
+
+extern struct golioth_system_client _golioth_system_client;
+
+#if defined(CONFIG_GOLIOTH_SYSTEM_CLIENT_LOOP) || defined(__DOXYGEN__)
+
+/**
+ * @brief Configuration of shared system client loop
+ */
+struct golioth_system_client_loop_config {
+	/** Stack of loop thread */
+	k_thread_stack_t *stack;
+	/** Size of @a stack, as returned by K_THREAD_STACK_SIZEOF() */
+	size_t stack_size;
+	/** Priority of loop thread */
+	int priority;
+};
+
+/**
+ * @brief Shared system client loop
+ *
+ * Single thread driving multiple system client instances, by polling all of their sockets with a
+ * single zsock_poll() call. This allows to scale to many device identities (e.g. on gateways)
+ * without dedicated thread stack per instance.
+ *
+ * All members are private and should not be accessed directly.
+ */
+struct golioth_system_client_loop {
+	struct k_mutex lock;
+	struct golioth_system_client *clients[CONFIG_GOLIOTH_SYSTEM_CLIENT_LOOP_MAX_CLIENTS];
+	int num_clients;
+
+	/* Shared eventfd followed by socket of each client */
+	struct zsock_pollfd fds[1 + CONFIG_GOLIOTH_SYSTEM_CLIENT_LOOP_MAX_CLIENTS];
+	int64_t expiry[CONFIG_GOLIOTH_SYSTEM_CLIENT_LOOP_MAX_CLIENTS];
+
+	struct k_thread thread;
+};
+
+/**
+ * @brief Initialize shared system client loop
+ *
+ * Creates loop thread. System client instances are attached to the loop by setting
+ * golioth_system_client_config.loop before calling golioth_system_client_init().
+ *
+ * Connecting (DNS resolution and DTLS handshake) of one instance is blocking, so other instances
+ * driven by the same loop are not serviced until it finishes.
+ *
+ * @param[out] loop Shared loop
+ * @param[in] config Configuration of loop
+ *
+ * @retval 0 On success
+ * @retval <0 On failure
+ */
+int golioth_system_client_loop_init(struct golioth_system_client_loop *loop,
+				    const struct golioth_system_client_loop_config *config);
+
+#endif /* CONFIG_GOLIOTH_SYSTEM_CLIENT_LOOP */
+
+/**
+ * @brief Initialize system client instance
+ *
+ * Initializes client and creates its thread. Connection is not established until
+ * golioth_system_client_inst_start() is called.
+ *
+ * Default instance (see GOLIOTH_SYSTEM_CLIENT_GET()) is initialized automatically. This function
+ * is meant for additional instances, e.g. with different credentials or server. Thread of default
+ * instance is named "golioth_system", threads of additional instances "golioth_system_1",
+ * "golioth_system_2" and so on.
+ *
+ * Each instance with its own thread uses one eventfd (instances driven by a shared loop use the
+ * eventfd of that loop), so CONFIG_EVENTFD_MAX needs to be increased accordingly.
+ *
+ * @param[out] sc System client instance
+ * @param[in] config Configuration of instance
+ *
+ * @retval 0 On success
+ * @retval -EINVAL Invalid configuration
+ * @retval -ENOMEM No space left in shared loop
+ * @retval <0 On failure
+ */
+int golioth_system_client_init(struct golioth_system_client *sc,
+			       const struct golioth_system_client_config *config);
+
+/**
+ * @brief Start system client instance
+ *
+ * @param[in] sc System client instance
+ */
+void golioth_system_client_inst_start(struct golioth_system_client *sc);
+
+/**
+ * @brief Stop system client instance
+ *
+ * Client is disconnected and all observations are cancelled (see golioth_observe_cancel_all()),
+ * so they are not registered again when instance is started later.
+ *
+ * @param[in] sc System client instance
+ */
+void golioth_system_client_inst_stop(struct golioth_system_client *sc);
+
+/**
+ * @brief Request reconnect of system client instance
+ *
+ * @param[in] sc System client instance
+ */
+void golioth_system_client_inst_request_reconnect(struct golioth_system_client *sc);
+
+/**
+ * @brief Reset reconnect backoff of system client instance
+ *
+ * Makes disconnected instance attempt to connect immediately, and restarts exponential backoff
+ * from minimal delay. Meant to be called on network-up events (e.g. network interface or LTE
+ * link becoming available).
+ *
+ * @param[in] sc System client instance
+ */
+void golioth_system_client_inst_reset_backoff(struct golioth_system_client *sc);
+
+/**
+ * @brief Notify system client instance about network change
+ *
+ * Meant to be called when device IP address or network path changed (e.g. switch between network
+ * interfaces, or new IP address assigned after LTE reattach), as connection over previous path is
+ * most likely lost.
+ *
+ * When DTLS Connection ID is active (see golioth_connection_id_is_active()), existing session does
+ * not depend on device address, so it is kept and only a ping is sent to verify it. Client
+ * reconnects (with full handshake) when there is no response within
+ * CONFIG_GOLIOTH_SYSTEM_CLIENT_CID_PROBE_TIMEOUT_SEC. Without Connection ID client reconnects
+ * right away. Disconnected instance attempts to connect immediately, like after
+ * golioth_system_client_inst_reset_backoff().
+ *
+ * @param[in] sc System client instance
+ */
+void golioth_system_client_inst_network_changed(struct golioth_system_client *sc);
+
+/**
+ * @brief Get Golioth client of system client instance
+ *
+ * @param[in] sc System client instance
+ *
+ * @return Client instance
+ */
+static inline struct golioth_client *
+golioth_system_client_get_client(struct golioth_system_client *sc)
+{
+	return &sc->client;
+}
+
 /**
  * @brief Start Golioth system client
  */
@@ -24,6 +249,8 @@ void golioth_system_client_start(void);
 
 /**
  * @brief Stop Golioth system client
+ *
+ * See golioth_system_client_inst_stop().
  */
 void golioth_system_client_stop(void);
 
@@ -32,10 +259,24 @@ void golioth_system_client_stop(void);
  */
 void golioth_system_client_request_reconnect(void);
 
+/**
+ * @brief Reset reconnect backoff of Golioth system client
+ *
+ * @see golioth_system_client_inst_reset_backoff()
+ */
+void golioth_system_client_reset_backoff(void);
+
+/**
+ * @brief Notify Golioth system client about network change
+ *
+ * @see golioth_system_client_inst_network_changed()
+ */
+void golioth_system_client_network_changed(void);
+
 /**
  * @brief Get pointer to Golioth system client instance
  */
-#define GOLIOTH_SYSTEM_CLIENT_GET()	(&_golioth_system_client)
+#define GOLIOTH_SYSTEM_CLIENT_GET()	(&_golioth_system_client.client)
 
 /** @} */
 
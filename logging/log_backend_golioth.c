@@ -5,6 +5,7 @@
  */
 
 #include <net/golioth.h>
+#include <net/golioth/metrics.h>
 #include <zephyr/logging/log_backend.h>
 #include <zephyr/logging/log_ctrl.h>
 #include <zephyr/logging/log_core.h>
@@ -446,6 +447,10 @@ static void dropped(const struct log_backend *const backend, uint32_t cnt)
 	struct golioth_log_ctx *ctx = backend->cb->ctx;
 
 	ctx->msg_index += cnt;
+
+#ifdef CONFIG_GOLIOTH_METRICS
+	golioth_metrics_log_dropped(ctx->client, cnt);
+#endif
 }
 
 static const struct log_backend_api log_backend_golioth_api = {
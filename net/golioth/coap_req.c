@@ -13,16 +13,17 @@ LOG_MODULE_DECLARE(golioth);
 
 #include "coap_req.h"
 #include "coap_utils.h"
+#include "golioth_metrics.h"
+#include "golioth_trace.h"
 #include "golioth_utils.h"
 
 static const int64_t COAP_OBSERVE_TS_DIFF_NEWER = 128 * (int64_t)MSEC_PER_SEC;
 
-#define COAP_RESPONSE_CODE_CLASS(code)	((code) >> 5)
-
 void golioth_coap_reqs_init(struct golioth_client *client)
 {
 	sys_dlist_init(&client->coap_reqs);
-	client->coap_reqs_connected = false;
+	atomic_clear(&client->coap_reqs_connected);
+	atomic_ptr_clear(&client->coap_reqs_submitted);
 	k_mutex_init(&client->coap_reqs_lock);
 }
 
@@ -31,33 +32,207 @@ static int golioth_coap_req_send(struct golioth_coap_req *req)
 	return golioth_send_coap(req->client, &req->request);
 }
 
+static int golioth_coap_req_call_cb(struct golioth_coap_req *req, struct golioth_req_rsp *rsp)
+{
+	int ret;
+
+	GOLIOTH_TRACE_REQ_CB_ENTER(req, rsp->err);
+	ret = req->cb(rsp);
+	GOLIOTH_TRACE_REQ_CB_EXIT(req, ret);
+
+	return ret;
+}
+
+/* Retransmission parameters of each priority class */
+static const struct {
+	uint8_t retries;
+	uint32_t ack_timeout;
+} golioth_coap_req_classes[] = {
+	[GOLIOTH_REQ_PRIORITY_CONTROL] = {
+		.retries = CONFIG_GOLIOTH_COAP_REQ_CONTROL_RETRIES,
+		.ack_timeout = CONFIG_GOLIOTH_COAP_REQ_CONTROL_ACK_TIMEOUT_MS,
+	},
+	[GOLIOTH_REQ_PRIORITY_INTERACTIVE] = {
+		.retries = CONFIG_GOLIOTH_COAP_REQ_INTERACTIVE_RETRIES,
+		.ack_timeout = CONFIG_GOLIOTH_COAP_REQ_INTERACTIVE_ACK_TIMEOUT_MS,
+	},
+	[GOLIOTH_REQ_PRIORITY_BULK] = {
+		.retries = CONFIG_GOLIOTH_COAP_REQ_BULK_RETRIES,
+		.ack_timeout = CONFIG_GOLIOTH_COAP_REQ_BULK_ACK_TIMEOUT_MS,
+	},
+};
+
+/* Order in which requests of each priority class are (re)transmitted */
+static const enum golioth_req_priority golioth_coap_req_sched_order[] = {
+	GOLIOTH_REQ_PRIORITY_CONTROL,
+	GOLIOTH_REQ_PRIORITY_INTERACTIVE,
+	GOLIOTH_REQ_PRIORITY_BULK,
+};
+
 static void golioth_coap_pending_init(struct golioth_coap_pending *pending,
-				      uint8_t retries)
+				      uint8_t retries, uint32_t ack_timeout)
 {
 	pending->t0 = k_uptime_get_32();
 	pending->timeout = 0;
+	pending->ack_timeout = ack_timeout;
 	pending->retries = retries;
 }
 
+static void golioth_coap_req_pending_init(struct golioth_coap_req *req)
+{
+	uint8_t retries = golioth_coap_req_classes[req->priority].retries;
+	uint32_t ack_timeout = golioth_coap_req_classes[req->priority].ack_timeout;
+
+	if (req->max_retries < 0) {
+		retries = 0;
+	} else if (req->max_retries > 0) {
+		retries = req->max_retries;
+	}
+
+	if (req->ack_timeout) {
+		ack_timeout = req->ack_timeout;
+	}
+
+	golioth_coap_pending_init(&req->pending, retries, ack_timeout);
+}
+
+static bool golioth_coap_req_is_same_observe(const struct golioth_coap_req *a,
+					     const struct golioth_coap_req *b)
+{
+	/*
+	 * Compare options following Observe, skipping (possibly different or missing) ETag. Header
+	 * of Observe option is skipped as well, as its delta depends on ETag presence. Register
+	 * (value 0) is encoded in this single byte, so following options start right after it.
+	 */
+	size_t a_off = a->observe_offset + 1;
+	size_t b_off = b->observe_offset + 1;
+	size_t a_len = a->request.offset - a_off;
+	size_t b_len = b->request.offset - b_off;
+
+	return a->app_cb == b->app_cb &&
+		a->app_user_data == b->app_user_data &&
+		a_len == b_len &&
+		memcmp(&a->request.data[a_off], &b->request.data[b_off], a_len) == 0;
+}
+
 static int __golioth_coap_req_submit(struct golioth_coap_req *req)
 {
 	struct golioth_client *client = req->client;
 
-	if (!client->coap_reqs_connected) {
-		return -ENETDOWN;
+	if (req->is_observe) {
+		struct golioth_coap_req *obs;
+
+		SYS_DLIST_FOR_EACH_CONTAINER(&client->coap_reqs, obs, node) {
+			if (obs->is_observe && golioth_coap_req_is_same_observe(obs, req)) {
+				req->handle = obs->handle;
+				return -EALREADY;
+			}
+		}
+	}
+
+	if (!atomic_get(&client->coap_reqs_connected)) {
+		if (!req->is_observe) {
+			return -ENETDOWN;
+		}
+
+		/* Observation will be registered once connected */
+		req->is_pending = false;
+		req->is_suspended = true;
 	}
 
 	sys_dlist_append(&client->coap_reqs, &req->node);
+	golioth_metrics_pending_inc(client);
 
 	return 0;
 }
 
+/*
+ * Submission of new requests
+ *
+ * Regular (non-observe) requests are pushed onto lock-free stack (client->coap_reqs_submitted)
+ * by application threads, so that they never wait for coap_reqs_lock, which is held by the
+ * thread processing received data and timeouts. Pushed requests are moved to client->coap_reqs
+ * list (in submission order) by any code path holding coap_reqs_lock before walking that list.
+ *
+ * Observations still need to be checked for duplicates against established ones, so they are
+ * submitted directly to client->coap_reqs list with coap_reqs_lock held.
+ */
+
+static void golioth_coap_req_push(struct golioth_coap_req *req)
+{
+	struct golioth_client *client = req->client;
+	atomic_ptr_val_t head;
+
+	do {
+		head = atomic_ptr_get(&client->coap_reqs_submitted);
+		req->submitted_next = head;
+	} while (!atomic_ptr_cas(&client->coap_reqs_submitted, head, req));
+}
+
+/* Must be called with coap_reqs_lock held */
+static void golioth_coap_reqs_drain_submitted(struct golioth_client *client)
+{
+	struct golioth_coap_req *req = atomic_ptr_clear(&client->coap_reqs_submitted);
+	struct golioth_coap_req *fifo = NULL;
+	struct golioth_coap_req *next;
+
+	/* Stack holds requests in reverse order */
+	while (req) {
+		next = req->submitted_next;
+		req->submitted_next = fifo;
+		fifo = req;
+		req = next;
+	}
+
+	for (req = fifo; req; req = next) {
+		next = req->submitted_next;
+
+		if (!atomic_get(&client->coap_reqs_connected)) {
+			/* Disconnected after request was pushed */
+			struct golioth_req_rsp rsp = {
+				.user_data = req->user_data,
+				.err = -ENETDOWN,
+			};
+
+			(void)golioth_coap_req_call_cb(req, &rsp);
+
+			golioth_coap_req_free(req);
+			continue;
+		}
+
+		sys_dlist_append(&client->coap_reqs, &req->node);
+		golioth_metrics_pending_inc(client);
+	}
+}
+
 static int golioth_coap_req_submit(struct golioth_coap_req *req)
 {
 	struct golioth_client *client = req->client;
 	int err;
 
+	if (!req->is_observe) {
+		if (!atomic_get(&client->coap_reqs_connected)) {
+			return -ENETDOWN;
+		}
+
+		golioth_coap_req_push(req);
+
+		/*
+		 * Disconnected meanwhile, possibly after requests were drained by
+		 * golioth_coap_reqs_on_disconnect(). Nothing drains them until reconnected,
+		 * so fail them right away.
+		 */
+		if (!atomic_get(&client->coap_reqs_connected)) {
+			k_mutex_lock(&client->coap_reqs_lock, K_FOREVER);
+			golioth_coap_reqs_drain_submitted(client);
+			k_mutex_unlock(&client->coap_reqs_lock);
+		}
+
+		return 0;
+	}
+
 	k_mutex_lock(&client->coap_reqs_lock, K_FOREVER);
+	golioth_coap_reqs_drain_submitted(client);
 	err = __golioth_coap_req_submit(req);
 	k_mutex_unlock(&client->coap_reqs_lock);
 
@@ -67,6 +242,7 @@ static int golioth_coap_req_submit(struct golioth_coap_req *req)
 static void golioth_coap_req_cancel(struct golioth_coap_req *req)
 {
 	sys_dlist_remove(&req->node);
+	golioth_metrics_pending_dec(req->client);
 }
 
 static void golioth_coap_req_cancel_and_free(struct golioth_coap_req *req)
@@ -74,8 +250,7 @@ static void golioth_coap_req_cancel_and_free(struct golioth_coap_req *req)
 	LOG_DBG("cancel and free req %p data %p", req, req->request.data);
 
 	golioth_coap_req_cancel(req);
-	free(req->request.data);
-	free(req);
+	golioth_coap_req_free(req);
 }
 
 static int golioth_coap_code_to_posix(uint8_t code)
@@ -159,7 +334,7 @@ static int golioth_coap_req_next_block(void *data, int status)
 			.err = -ENOTSUP,
 		};
 
-		(void)req->cb(&rsp);
+		(void)golioth_coap_req_call_cb(req, &rsp);
 
 		return 0;
 	}
@@ -171,7 +346,7 @@ static int golioth_coap_req_next_block(void *data, int status)
 		return err;
 	}
 
-	golioth_coap_pending_init(&req->pending, 3);
+	golioth_coap_req_pending_init(req);
 
 	return 0;
 }
@@ -193,6 +368,7 @@ static bool golioth_coap_reply_is_newer(struct golioth_coap_reply *reply,
 static int golioth_coap_req_reply_handler(struct golioth_coap_req *req,
 					  const struct coap_packet *response)
 {
+	struct coap_option etag;
 	uint16_t payload_len;
 	uint8_t code;
 	const uint8_t *payload;
@@ -215,7 +391,7 @@ static int golioth_coap_req_reply_handler(struct golioth_coap_req *req,
 			.err = err,
 		};
 
-		(void)req->cb(&rsp);
+		(void)golioth_coap_req_call_cb(req, &rsp);
 
 		LOG_INF("cancel and free req: %p", req);
 
@@ -224,6 +400,10 @@ static int golioth_coap_req_reply_handler(struct golioth_coap_req *req,
 
 	payload = coap_packet_get_payload(response, &payload_len);
 
+	if (coap_find_options(response, COAP_OPTION_ETAG, &etag, 1) != 1) {
+		etag.len = 0;
+	}
+
 	block2 = coap_get_option_int(response, COAP_OPTION_BLOCK2);
 	if (block2 != -ENOENT) {
 		size_t want_offset = req->block_ctx.current;
@@ -239,7 +419,7 @@ static int golioth_coap_req_reply_handler(struct golioth_coap_req *req,
 
 			LOG_ERR("Failed to parse get response: %d", err);
 
-			(void)req->cb(&rsp);
+			(void)golioth_coap_req_call_cb(req, &rsp);
 
 			err = -EBADMSG;
 			goto cancel_and_free;
@@ -264,7 +444,7 @@ static int golioth_coap_req_reply_handler(struct golioth_coap_req *req,
 
 			LOG_ERR("Failed to move to next block: %zu", new_offset);
 
-			(void)req->cb(&rsp);
+			(void)golioth_coap_req_call_cb(req, &rsp);
 
 			err = -EBADMSG;
 			goto cancel_and_free;
@@ -280,11 +460,14 @@ static int golioth_coap_req_reply_handler(struct golioth_coap_req *req,
 				.get_next_data = NULL,
 
 				.user_data = req->user_data,
+
+				.etag = etag.value,
+				.etag_len = etag.len,
 			};
 
 			LOG_DBG("Blockwise transfer is finished!");
 
-			(void)req->cb(&rsp);
+			(void)golioth_coap_req_call_cb(req, &rsp);
 
 			goto cancel_and_free;
 		} else {
@@ -300,10 +483,13 @@ static int golioth_coap_req_reply_handler(struct golioth_coap_req *req,
 
 				.user_data = req->user_data,
 
+				.etag = etag.value,
+				.etag_len = etag.len,
+
 				.err = req->is_observe ? -EMSGSIZE : 0,
 			};
 
-			err = req->cb(&rsp);
+			err = golioth_coap_req_call_cb(req, &rsp);
 			if (err) {
 				LOG_WRN("Received error (%d) from callback, cancelling", err);
 				goto cancel_and_free;
@@ -330,9 +516,14 @@ static int golioth_coap_req_reply_handler(struct golioth_coap_req *req,
 			.get_next_data = NULL,
 
 			.user_data = req->user_data,
+
+			.etag = etag.value,
+			.etag_len = etag.len,
+
+			.valid = (code == COAP_RESPONSE_CODE_VALID),
 		};
 
-		(void)req->cb(&rsp);
+		(void)golioth_coap_req_call_cb(req, &rsp);
 
 		goto cancel_and_free;
 	}
@@ -359,6 +550,8 @@ void golioth_coap_req_process_rx(struct golioth_client *client, const struct coa
 
 	k_mutex_lock(&client->coap_reqs_lock, K_FOREVER);
 
+	golioth_coap_reqs_drain_submitted(client);
+
 	SYS_DLIST_FOR_EACH_CONTAINER(&client->coap_reqs, req, node) {
 		uint16_t req_id = coap_header_get_id(&req->request);
 		uint8_t req_token[COAP_TOKEN_MAX_LEN];
@@ -378,6 +571,14 @@ void golioth_coap_req_process_rx(struct golioth_client *client, const struct coa
 			continue;
 		}
 
+		GOLIOTH_TRACE_REQ_MATCH(req, coap_header_get_code(rx));
+
+		golioth_metrics_rsp(client, coap_header_get_code(rx));
+
+		if (!req->is_observe || req->is_pending) {
+			golioth_metrics_rtt(client, k_uptime_get_32() - req->sent_at);
+		}
+
 		observe_seq = coap_get_option_int(rx, COAP_OPTION_OBSERVE);
 
 		if (observe_seq == -ENOENT) {
@@ -417,8 +618,12 @@ static int golioth_coap_req_init(struct golioth_coap_req *req,
 	}
 
 	req->client = client;
+	do {
+		req->handle = atomic_inc(&client->coap_reqs_next_handle) + 1;
+	} while (req->handle == GOLIOTH_REQ_HANDLE_INVALID);
 	req->cb = (cb ? cb : golioth_req_rsp_default_handler);
 	req->user_data = user_data;
+	req->priority = GOLIOTH_REQ_PRIORITY_INTERACTIVE;
 	req->request_wo_block2.offset = 0;
 	req->reply.seq = 0;
 	req->reply.ts = -COAP_OBSERVE_TS_DIFF_NEWER;
@@ -433,7 +638,9 @@ int golioth_coap_req_schedule(struct golioth_coap_req *req)
 	struct golioth_client *client = req->client;
 	int err;
 
-	golioth_coap_pending_init(&req->pending, 3);
+	golioth_coap_req_pending_init(req);
+
+	GOLIOTH_TRACE_REQ_SCHEDULE(req);
 
 	err = golioth_coap_req_submit(req);
 	if (err) {
@@ -478,6 +685,10 @@ int golioth_coap_req_new(struct golioth_coap_req **req,
 		goto free_buffer;
 	}
 
+	golioth_metrics_heap_alloc(client, sizeof(**req) + buffer_len);
+
+	GOLIOTH_TRACE_REQ_ALLOC(*req, buffer_len);
+
 	return 0;
 
 free_buffer:
@@ -491,22 +702,33 @@ free_req:
 
 void golioth_coap_req_free(struct golioth_coap_req *req)
 {
+	GOLIOTH_TRACE_REQ_FREE(req);
+
+	golioth_metrics_heap_free(req->client, sizeof(*req) + req->request.max_len);
+
 	free(req->request.data); /* buffer */
 	free(req);
 }
 
-int golioth_coap_req_cb(struct golioth_client *client,
-			enum coap_method method,
-			const uint8_t **pathv,
-			enum golioth_content_format format,
-			const uint8_t *data, size_t data_len,
-			golioth_req_cb_t cb, void *user_data,
-			int flags)
+int golioth_coap_req_params_cb(struct golioth_client *client,
+			       enum coap_method method,
+			       const uint8_t **pathv,
+			       enum golioth_content_format format,
+			       const uint8_t *data, size_t data_len,
+			       golioth_req_cb_t cb, void *user_data,
+			       int flags,
+			       const struct golioth_coap_req_params *params)
 {
 	size_t path_len = coap_pathv_estimate_alloc_len(pathv);
 	struct golioth_coap_req *req;
+	uint32_t handle;
 	int err;
 
+	if (params && params->ack_timeout_ms > GOLIOTH_REQ_ACK_TIMEOUT_MAX_MS) {
+		LOG_ERR("Invalid ACK timeout: %u", (unsigned int)params->ack_timeout_ms);
+		return -EINVAL;
+	}
+
 	err = golioth_coap_req_new(&req, client, method, COAP_TYPE_CON,
 				   GOLIOTH_COAP_MAX_NON_PAYLOAD_LEN + path_len + data_len,
 				   cb, user_data);
@@ -515,9 +737,41 @@ int golioth_coap_req_cb(struct golioth_client *client,
 		return err;
 	}
 
+	if (params && params->priority != GOLIOTH_REQ_PRIORITY_DEFAULT &&
+	    params->priority < ARRAY_SIZE(golioth_coap_req_classes)) {
+		req->priority = params->priority;
+	}
+
+	if (params) {
+		req->max_retries = params->max_retries;
+		req->ack_timeout = params->ack_timeout_ms;
+
+		if (params->deadline_ms && !(flags & GOLIOTH_COAP_REQ_OBSERVE)) {
+			req->deadline = k_uptime_get() + params->deadline_ms;
+		}
+	}
+
+	if (method == COAP_METHOD_GET && params && params->etag_len) {
+		err = coap_packet_append_option(&req->request, COAP_OPTION_ETAG,
+						params->etag, params->etag_len);
+		if (err) {
+			LOG_ERR("Unable add etag to packet");
+			goto free_req;
+		}
+	}
+
 	if (method == COAP_METHOD_GET && (flags & GOLIOTH_COAP_REQ_OBSERVE)) {
 		req->is_observe = true;
 		req->is_pending = true;
+		req->observe_offset = req->request.offset;
+
+		if (params && params->app_cb) {
+			req->app_cb = params->app_cb;
+			req->app_user_data = params->app_user_data;
+		} else {
+			req->app_cb = req->cb;
+			req->app_user_data = user_data;
+		}
 
 		err = coap_append_option_int(&req->request, COAP_OPTION_OBSERVE, 0 /* register */);
 		if (err) {
@@ -562,12 +816,25 @@ int golioth_coap_req_cb(struct golioth_client *client,
 		}
 	}
 
+	/* Request might be already freed when golioth_coap_req_schedule() returns */
+	handle = req->handle;
+
 	err = golioth_coap_req_schedule(req);
-	if (err) {
+	if (err == -EALREADY) {
+		LOG_DBG("Identical observation already exists");
+
+		/* Report handle of existing observation */
+		handle = req->handle;
+		golioth_coap_req_free(req);
+	} else if (err) {
 		goto free_req;
 	}
 
-	return 0;
+	if (params && params->handle) {
+		*params->handle = handle;
+	}
+
+	return err;
 
 free_req:
 	golioth_coap_req_free(req);
@@ -575,6 +842,28 @@ free_req:
 	return err;
 }
 
+int golioth_coap_req_cb(struct golioth_client *client,
+			enum coap_method method,
+			const uint8_t **pathv,
+			enum golioth_content_format format,
+			const uint8_t *data, size_t data_len,
+			golioth_req_cb_t cb, void *user_data,
+			int flags)
+{
+	int err;
+
+	err = golioth_coap_req_params_cb(client, method, pathv, format,
+					 data, data_len,
+					 cb, user_data,
+					 flags, NULL);
+	if (err == -EALREADY) {
+		/* Observation is already established, which is not an error for caller */
+		return 0;
+	}
+
+	return err;
+}
+
 struct golioth_req_sync_data {
 	struct k_sem sem;
 	int err;
@@ -613,32 +902,60 @@ finish_sync_call:
 	return err;
 }
 
-int golioth_coap_req_sync(struct golioth_client *client,
-			  enum coap_method method,
-			  const uint8_t **pathv,
-			  enum golioth_content_format format,
-			  const uint8_t *data, size_t data_len,
-			  golioth_req_cb_t cb, void *user_data,
-			  int flags)
+int golioth_coap_req_params_sync(struct golioth_client *client,
+				 enum coap_method method,
+				 const uint8_t **pathv,
+				 enum golioth_content_format format,
+				 const uint8_t *data, size_t data_len,
+				 golioth_req_cb_t cb, void *user_data,
+				 int flags,
+				 const struct golioth_coap_req_params *params)
 {
 	struct golioth_req_sync_data sync_data = {
 		.cb = cb,
 		.user_data = user_data,
 	};
+	struct golioth_coap_req_params sync_params = {};
+	k_timeout_t timeout = K_FOREVER;
+	uint32_t handle;
 	int err;
 
+	if (params) {
+		sync_params = *params;
+
+		if (params->timeout_ms > 0) {
+			timeout = K_MSEC(params->timeout_ms);
+		}
+	}
+
+	sync_params.handle = &handle;
+
 	k_sem_init(&sync_data.sem, 0, 1);
 
-	err = golioth_coap_req_cb(client, method, pathv, format,
-				  data, data_len,
-				  golioth_req_sync_cb, &sync_data,
-				  flags);
+	err = golioth_coap_req_params_cb(client, method, pathv, format,
+					 data, data_len,
+					 golioth_req_sync_cb, &sync_data,
+					 flags, &sync_params);
 	if (err) {
 		LOG_WRN("Failed to make CoAP request: %d", err);
 		return err;
 	}
 
-	k_sem_take(&sync_data.sem, K_FOREVER);
+	if (params && params->handle) {
+		*params->handle = handle;
+	}
+
+	err = k_sem_take(&sync_data.sem, timeout);
+	if (err) {
+		/*
+		 * Callback is invoked (and semaphore is given) by cancellation. If request was
+		 * completed in the meantime, then semaphore was given as well. In both cases
+		 * request is not referenced anymore, so sync_data can be safely released.
+		 */
+		(void)golioth_coap_req_cancel_handle(client, handle, -ETIMEDOUT);
+
+		k_sem_take(&sync_data.sem, K_FOREVER);
+	}
 
 	if (sync_data.err) {
 		LOG_WRN("req_sync finished with error %d", sync_data.err);
@@ -649,12 +966,30 @@ int golioth_coap_req_sync(struct golioth_client *client,
 	return 0;
 }
 
-static uint32_t init_ack_timeout(void)
+int golioth_coap_req_sync(struct golioth_client *client,
+			  enum coap_method method,
+			  const uint8_t **pathv,
+			  enum golioth_content_format format,
+			  const uint8_t *data, size_t data_len,
+			  golioth_req_cb_t cb, void *user_data,
+			  int flags)
+{
+	return golioth_coap_req_params_sync(client, method, pathv, format,
+					    data, data_len,
+					    cb, user_data,
+					    flags, NULL);
+}
+
+static uint32_t init_ack_timeout(uint32_t ack_timeout)
 {
 #if defined(CONFIG_COAP_RANDOMIZE_ACK_TIMEOUT)
-	const uint32_t max_ack = CONFIG_COAP_INIT_ACK_TIMEOUT_MS *
-				 CONFIG_COAP_ACK_RANDOM_PERCENT / 100;
-	const uint32_t min_ack = CONFIG_COAP_INIT_ACK_TIMEOUT_MS;
+	const uint32_t max_ack = ack_timeout * CONFIG_COAP_ACK_RANDOM_PERCENT / 100;
+	const uint32_t min_ack = ack_timeout;
+
+	/* Too short to be randomized */
+	if (max_ack <= min_ack) {
+		return ack_timeout;
+	}
 
 	/* Randomly generated initial ACK timeout
 	 * ACK_TIMEOUT < INIT_ACK_TIMEOUT < ACK_TIMEOUT * ACK_RANDOM_FACTOR
@@ -662,7 +997,7 @@ static uint32_t init_ack_timeout(void)
 	 */
 	return min_ack + (sys_rand32_get() % (max_ack - min_ack));
 #else
-	return CONFIG_COAP_INIT_ACK_TIMEOUT_MS;
+	return ack_timeout;
 #endif /* defined(CONFIG_COAP_RANDOMIZE_ACK_TIMEOUT) */
 }
 
@@ -670,7 +1005,7 @@ static bool golioth_coap_pending_cycle(struct golioth_coap_pending *pending)
 {
 	if (pending->timeout == 0) {
 		/* Initial transmission. */
-		pending->timeout = init_ack_timeout();
+		pending->timeout = init_ack_timeout(pending->ack_timeout);
 
 		return true;
 	}
@@ -686,6 +1021,20 @@ static bool golioth_coap_pending_cycle(struct golioth_coap_pending *pending)
 	return true;
 }
 
+static void golioth_coap_req_timed_out(struct golioth_coap_req *req)
+{
+	struct golioth_req_rsp rsp = {
+		.user_data = req->user_data,
+		.err = -ETIMEDOUT,
+	};
+
+	golioth_metrics_req_timeout(req->client);
+
+	(void)golioth_coap_req_call_cb(req, &rsp);
+
+	golioth_coap_req_cancel_and_free(req);
+}
+
 static int64_t golioth_coap_req_poll_prepare(struct golioth_coap_req *req, uint32_t now)
 {
 	int64_t timeout;
@@ -703,16 +1052,9 @@ static int64_t golioth_coap_req_poll_prepare(struct golioth_coap_req *req, uint3
 
 		send = golioth_coap_pending_cycle(&req->pending);
 		if (!send) {
-			struct golioth_req_rsp rsp = {
-				.user_data = req->user_data,
-				.err = -ETIMEDOUT,
-			};
-
 			LOG_WRN("Packet %p (reply %p) was not replied to", req, &req->reply);
 
-			(void)req->cb(&rsp);
-
-			golioth_coap_req_cancel_and_free(req);
+			golioth_coap_req_timed_out(req);
 
 			return INT64_MAX;
 		}
@@ -723,30 +1065,129 @@ static int64_t golioth_coap_req_poll_prepare(struct golioth_coap_req *req, uint3
 			LOG_WRN("Resending request %p (reply %p) (retries %d)",
 				req, &req->reply,
 				(int)req->pending.retries);
+
+			GOLIOTH_TRACE_REQ_RETRANSMIT(req);
+		} else {
+			GOLIOTH_TRACE_REQ_SEND(req, coap_header_get_id(&req->request));
 		}
 
+		req->sent_at = k_uptime_get_32();
+
 		err = golioth_coap_req_send(req);
 		if (err) {
 			LOG_ERR("Send error: %d", err);
 		}
+
+		golioth_metrics_req_sent(req->client, resend);
 	}
 
 	return timeout;
 }
 
+/* Request was transmitted and waits for response (or for retransmission) */
+static inline bool golioth_coap_req_is_in_flight(const struct golioth_coap_req *req)
+{
+	return (req->pending.timeout != 0) && !(req->is_observe && !req->is_pending);
+}
+
 static int64_t __golioth_coap_reqs_poll_prepare(struct golioth_client *client, int64_t now)
 {
 	struct golioth_coap_req *req, *next;
 	int64_t min_timeout = INT64_MAX;
 
-	SYS_DLIST_FOR_EACH_CONTAINER_SAFE(&client->coap_reqs, req, next, node) {
-		if (req->is_observe && !req->is_pending) {
-			continue;
+	const int max_in_flight = CONFIG_GOLIOTH_COAP_REQ_MAX_IN_FLIGHT;
+	int in_flight = 0;
+	bool window_full = false;
+
+	golioth_coap_reqs_drain_submitted(client);
+
+	if (max_in_flight > 0) {
+		SYS_DLIST_FOR_EACH_CONTAINER(&client->coap_reqs, req, node) {
+			if (golioth_coap_req_is_in_flight(req)) {
+				in_flight++;
+			}
 		}
+	}
 
-		int64_t req_timeout = golioth_coap_req_poll_prepare(req, now);
+	for (size_t i = 0; i < ARRAY_SIZE(golioth_coap_req_sched_order); i++) {
+		enum golioth_req_priority priority = golioth_coap_req_sched_order[i];
 
-		min_timeout = MIN(min_timeout, req_timeout);
+		SYS_DLIST_FOR_EACH_CONTAINER_SAFE(&client->coap_reqs, req, next, node) {
+			if (req->priority != priority) {
+				continue;
+			}
+
+			if (req->is_observe && !req->is_pending) {
+				continue;
+			}
+
+			bool was_in_flight = golioth_coap_req_is_in_flight(req);
+			bool admitted = false;
+			int64_t deadline = req->deadline;
+
+			if (deadline && deadline <= now) {
+				LOG_WRN("Request %p (reply %p) missed its deadline", req, &req->reply);
+
+				golioth_coap_req_timed_out(req);
+
+				/* Freed request makes space for waiting ones */
+				if (was_in_flight) {
+					in_flight--;
+				}
+
+				continue;
+			}
+
+			int64_t req_timeout = INT64_MAX;
+
+			if (deadline) {
+				req_timeout = deadline - now;
+			}
+
+			/*
+			 * Requests waiting for initial transmission are sent only if there is
+			 * space in the in-flight window. Otherwise they wait until some response
+			 * is received, which makes this function to be called again.
+			 */
+			if (max_in_flight > 0 && !was_in_flight &&
+			    (int32_t)(req->pending.t0 - (uint32_t)now) <= 0) {
+				if (in_flight >= max_in_flight) {
+					min_timeout = MIN(min_timeout, req_timeout);
+					window_full = true;
+					continue;
+				}
+
+				/*
+				 * Retransmission timeouts start with actual transmission, not with
+				 * submission, otherwise retries would be used up by waiting.
+				 */
+				req->pending.t0 = (uint32_t)now;
+				req->pending.timeout = 0;
+
+				in_flight++;
+				admitted = true;
+			}
+
+			int64_t pending_timeout = golioth_coap_req_poll_prepare(req, now);
+
+			/* Request was freed after last retransmission timed out */
+			if (pending_timeout == INT64_MAX && (was_in_flight || admitted)) {
+				in_flight--;
+				continue;
+			}
+
+			req_timeout = MIN(req_timeout, pending_timeout);
+
+			min_timeout = MIN(min_timeout, req_timeout);
+		}
+	}
+
+	/*
+	 * Space freed by timed out requests of later classes is used on next call, so that
+	 * scheduling order of classes is kept.
+	 */
+	if (window_full && in_flight < max_in_flight) {
+		min_timeout = 0;
 	}
 
 	return min_timeout;
@@ -769,39 +1210,336 @@ static void golioth_coap_reqs_cancel_all_with_reason(struct golioth_client *clie
 	struct golioth_coap_req *req, *next;
 
 	SYS_DLIST_FOR_EACH_CONTAINER_SAFE(&client->coap_reqs, req, next, node) {
+		if (req->is_suspended) {
+			continue;
+		}
+
+		struct golioth_req_rsp rsp = {
+			.user_data = req->user_data,
+			.err = reason,
+		};
+
+		(void)golioth_coap_req_call_cb(req, &rsp);
+
+		golioth_coap_req_cancel_and_free(req);
+	}
+}
+
+static void golioth_coap_reqs_suspend_observations(struct golioth_client *client)
+{
+	struct golioth_coap_req *req;
+
+	SYS_DLIST_FOR_EACH_CONTAINER(&client->coap_reqs, req, node) {
+		if (req->is_observe) {
+			req->is_pending = false;
+			req->is_suspended = true;
+		}
+	}
+}
+
+/*
+ * Remove ETag option from observe registration. Cached value, which it refers to, might have been
+ * evicted or replaced meanwhile, so server needs to send current representation. ETag is the only
+ * option preceding Observe, so packet is shifted down to header and delta of Observe option
+ * (which is encoded in single byte with register value) is updated.
+ */
+static int golioth_coap_req_drop_etag(struct golioth_coap_req *req)
+{
+	struct coap_packet *pkt = &req->request;
+	uint16_t max_len = pkt->max_len;
+	uint16_t hdr_len = pkt->hdr_len;
+	uint16_t etag_len = req->observe_offset - hdr_len;
+	int err;
+
+	if (!etag_len) {
+		return 0;
+	}
+
+	memmove(&pkt->data[hdr_len], &pkt->data[req->observe_offset],
+		pkt->offset - req->observe_offset);
+	pkt->data[hdr_len] = (COAP_OPTION_OBSERVE << 4) | (pkt->data[hdr_len] & 0x0f);
+
+	err = coap_packet_parse(pkt, pkt->data, pkt->offset - etag_len, NULL, 0);
+	if (err) {
+		LOG_ERR("Failed to parse observe request: %d", err);
+		return err;
+	}
+
+	pkt->max_len = max_len;
+	req->observe_offset = hdr_len;
+
+	return 0;
+}
+
+/*
+ * Observations are not retained by server after reconnecting, so register them again. This is
+ * spread over time, to avoid burst of requests right after establishing connection.
+ */
+static bool golioth_coap_reqs_resume_observations(struct golioth_client *client)
+{
+	struct golioth_coap_req *req;
+	uint32_t t0 = k_uptime_get_32();
+	bool resumed = false;
+
+	SYS_DLIST_FOR_EACH_CONTAINER(&client->coap_reqs, req, node) {
+		if (!req->is_suspended) {
+			continue;
+		}
+
+		/* Register from scratch, without Block2 of last (blockwise) notification */
+		if (req->request_wo_block2.offset) {
+			req->request = req->request_wo_block2;
+			req->request_wo_block2.offset = 0;
+		}
+
+		coap_block_transfer_init(&req->block_ctx,
+					 golioth_estimated_coap_block_size(client), 0);
+
+		(void)golioth_coap_req_drop_etag(req);
+
+		coap_packet_set_id(&req->request, coap_next_id());
+		req->reply.seq = 0;
+		req->reply.ts = -COAP_OBSERVE_TS_DIFF_NEWER;
+
+		golioth_coap_req_pending_init(req);
+		req->pending.t0 = t0;
+		t0 += CONFIG_GOLIOTH_COAP_OBSERVE_RESUME_INTERVAL_MS;
+
+		req->is_pending = true;
+		req->is_suspended = false;
+		resumed = true;
+	}
+
+	return resumed;
+}
+
+static struct golioth_coap_req *golioth_coap_req_find(struct golioth_client *client,
+						      uint32_t handle)
+{
+	struct golioth_coap_req *req;
+
+	golioth_coap_reqs_drain_submitted(client);
+
+	SYS_DLIST_FOR_EACH_CONTAINER(&client->coap_reqs, req, node) {
+		if (req->handle == handle) {
+			return req;
+		}
+	}
+
+	return NULL;
+}
+
+int golioth_coap_req_cancel_handle(struct golioth_client *client, uint32_t handle, int reason)
+{
+	struct golioth_coap_req *req;
+	int err = -ENOENT;
+
+	if (handle == GOLIOTH_REQ_HANDLE_INVALID) {
+		return -ENOENT;
+	}
+
+	k_mutex_lock(&client->coap_reqs_lock, K_FOREVER);
+
+	req = golioth_coap_req_find(client, handle);
+	if (req) {
 		struct golioth_req_rsp rsp = {
 			.user_data = req->user_data,
 			.err = reason,
 		};
 
-		(void)req->cb(&rsp);
+		(void)golioth_coap_req_call_cb(req, &rsp);
 
 		golioth_coap_req_cancel_and_free(req);
+
+		err = 0;
+	}
+
+	k_mutex_unlock(&client->coap_reqs_lock);
+
+	return err;
+}
+
+int golioth_req_cancel(struct golioth_client *client, uint32_t handle)
+{
+	return golioth_coap_req_cancel_handle(client, handle, -ECANCELED);
+}
+
+/*
+ * Create deregistration request, which is a copy of observe request with Observe option value
+ * changed from 0 (register) to 1 (deregister). Value 0 is encoded as zero-length option, so only
+ * length in option header needs to be updated and single byte of value inserted.
+ */
+static int golioth_coap_req_deregister_new(struct golioth_coap_req **dereg,
+					   const struct golioth_coap_req *obs)
+{
+	const struct coap_packet *obs_pkt = &obs->request;
+	size_t pkt_len = obs_pkt->offset + 1;
+	size_t buffer_len = obs_pkt->max_len + 1;
+	uint16_t off = obs->observe_offset;
+	uint8_t *buffer;
+	int err;
+
+	err = golioth_coap_req_new(dereg, obs->client, COAP_METHOD_GET, COAP_TYPE_CON,
+				   buffer_len,
+				   NULL, "Observe deregistration");
+	if (err) {
+		return err;
+	}
+
+	buffer = (*dereg)->request.data;
+
+	memcpy(buffer, obs_pkt->data, off);
+	buffer[off] = obs_pkt->data[off] | 1; /* option length */
+	buffer[off + 1] = 1; /* deregister */
+	memcpy(&buffer[off + 2], &obs_pkt->data[off + 1], obs_pkt->offset - off - 1);
+
+	err = coap_packet_parse(&(*dereg)->request, buffer, pkt_len, NULL, 0);
+	if (err) {
+		LOG_ERR("Failed to parse deregistration request: %d", err);
+		golioth_coap_req_free(*dereg);
+		return err;
 	}
+
+	/* Make space for Block2 option */
+	(*dereg)->request.max_len = buffer_len;
+
+	coap_packet_set_id(&(*dereg)->request, coap_next_id());
+
+	return 0;
+}
+
+int golioth_coap_req_observe_stop(struct golioth_client *client, uint32_t handle)
+{
+	struct golioth_coap_req *dereg = NULL;
+	struct golioth_coap_req *req;
+	int err = 0;
+
+	if (handle == GOLIOTH_REQ_HANDLE_INVALID) {
+		return -ENOENT;
+	}
+
+	k_mutex_lock(&client->coap_reqs_lock, K_FOREVER);
+
+	req = golioth_coap_req_find(client, handle);
+	if (!req) {
+		err = -ENOENT;
+		goto unlock;
+	}
+
+	if (!req->is_observe) {
+		err = -EINVAL;
+		goto unlock;
+	}
+
+	/*
+	 * Failure to deregister is not fatal, as server stops sending notifications once they
+	 * are not acknowledged.
+	 */
+	if (golioth_coap_req_deregister_new(&dereg, req)) {
+		LOG_WRN("Failed to create deregistration request");
+		dereg = NULL;
+	}
+
+	struct golioth_req_rsp rsp = {
+		.user_data = req->user_data,
+		.err = -ECANCELED,
+	};
+
+	(void)golioth_coap_req_call_cb(req, &rsp);
+
+	golioth_coap_req_cancel_and_free(req);
+
+	if (dereg) {
+		golioth_coap_req_pending_init(dereg);
+
+		if (__golioth_coap_req_submit(dereg)) {
+			golioth_coap_req_free(dereg);
+			dereg = NULL;
+		}
+	}
+
+unlock:
+	k_mutex_unlock(&client->coap_reqs_lock);
+
+	if (dereg && client->wakeup) {
+		client->wakeup(client);
+	}
+
+	return err;
+}
+
+int golioth_observe_stop(struct golioth_client *client, uint32_t handle)
+{
+	return golioth_coap_req_observe_stop(client, handle);
+}
+
+void golioth_observe_cancel_all(struct golioth_client *client)
+{
+	struct golioth_coap_req *req, *next;
+
+	k_mutex_lock(&client->coap_reqs_lock, K_FOREVER);
+
+	/* Fail requests pushed after disconnecting, e.g. when client is stopped */
+	golioth_coap_reqs_drain_submitted(client);
+
+	SYS_DLIST_FOR_EACH_CONTAINER_SAFE(&client->coap_reqs, req, next, node) {
+		if (!req->is_observe) {
+			continue;
+		}
+
+		struct golioth_req_rsp rsp = {
+			.user_data = req->user_data,
+			.err = -ECANCELED,
+		};
+
+		(void)golioth_coap_req_call_cb(req, &rsp);
+
+		golioth_coap_req_cancel_and_free(req);
+	}
+
+	k_mutex_unlock(&client->coap_reqs_lock);
 }
 
 void golioth_coap_reqs_on_connect(struct golioth_client *client)
 {
+	bool resumed;
+
 	k_mutex_lock(&client->coap_reqs_lock, K_FOREVER);
 
 	/*
-	 * client->sock is protected by client->lock, so submitting new coap_req
+	 * Requests pushed by threads, which saw previous connection just before it was lost, are
+	 * failed (still disconnected here) instead of being sent over the new connection.
+	 */
+	golioth_coap_reqs_drain_submitted(client);
+
+	/*
+	 * client->sock is protected by client->{rx,tx}_lock, so submitting new coap_req
 	 * requests would potentially block on other thread currently receiving
 	 * or sending data using golioth_{recv,send} APIs.
 	 *
 	 * Hence use another client->coap_reqs_connected to save information
 	 * whether we are connected or not.
 	 */
-	client->coap_reqs_connected = true;
+	atomic_set(&client->coap_reqs_connected, true);
+
+	resumed = golioth_coap_reqs_resume_observations(client);
 
 	k_mutex_unlock(&client->coap_reqs_lock);
+
+	if (resumed && client->wakeup) {
+		client->wakeup(client);
+	}
 }
 
 void golioth_coap_reqs_on_disconnect(struct golioth_client *client)
 {
 	k_mutex_lock(&client->coap_reqs_lock, K_FOREVER);
 
-	client->coap_reqs_connected = false;
+	/* Requests submitted so far are cancelled together with all others */
+	golioth_coap_reqs_drain_submitted(client);
+
+	atomic_clear(&client->coap_reqs_connected);
+	golioth_coap_reqs_suspend_observations(client);
 	golioth_coap_reqs_cancel_all_with_reason(client, -ESHUTDOWN);
 
 	k_mutex_unlock(&client->coap_reqs_lock);
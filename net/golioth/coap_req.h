@@ -22,6 +22,65 @@
 
 /** @} */
 
+/** Maximum length of ETag option (RFC 7252 section 5.10.6) */
+#define GOLIOTH_COAP_ETAG_MAX_LEN		8
+
+/**
+ * @brief Additional (optional) parameters of CoAP request
+ */
+struct golioth_coap_req_params {
+	/** ETag of locally cached representation, to be validated by server (GET only) */
+	const uint8_t *etag;
+	/** Length of @a etag (0 if none) */
+	size_t etag_len;
+
+	/** Timeout of synchronous request in milliseconds (0 means no timeout) */
+	int32_t timeout_ms;
+
+	/** Handle of scheduled request is stored here (if not NULL) */
+	uint32_t *handle;
+
+	/** Priority class, determining retransmission parameters and scheduling order */
+	enum golioth_req_priority priority;
+
+	/** Max retransmissions (0 means class default, <0 means none) */
+	int8_t max_retries;
+
+	/** Initial ACK timeout in milliseconds (0 means class default) */
+	uint32_t ack_timeout_ms;
+
+	/** Deadline of request in milliseconds (0 means none) */
+	uint32_t deadline_ms;
+
+	/**
+	 * Application callback and its user data, used to detect duplicated observations. Needed
+	 * only if @a cb passed with request wraps application callback.
+	 */
+	golioth_req_cb_t app_cb;
+	void *app_user_data;
+};
+
+/**
+ * @brief Convert user request options to CoAP request parameters
+ *
+ * @param[out] params CoAP request parameters
+ * @param[in] opts User request options (can be NULL)
+ */
+static inline void golioth_coap_req_params_from_opts(struct golioth_coap_req_params *params,
+						     const struct golioth_req_opts *opts)
+{
+	if (opts) {
+		params->timeout_ms = opts->timeout_ms;
+		params->handle = opts->handle;
+		if (opts->priority != GOLIOTH_REQ_PRIORITY_DEFAULT) {
+			params->priority = opts->priority;
+		}
+		params->max_retries = opts->max_retries;
+		params->ack_timeout_ms = opts->ack_timeout_ms;
+		params->deadline_ms = opts->deadline_ms;
+	}
+}
+
 /**
  * @brief Information about a request awaiting for an acknowledgment (ACK).
  *
@@ -30,6 +89,7 @@
 struct golioth_coap_pending {
 	uint32_t t0;
 	uint32_t timeout;
+	uint32_t ack_timeout;
 	uint8_t retries;
 };
 
@@ -48,19 +108,40 @@ struct golioth_coap_reply {
  */
 struct golioth_coap_req {
 	sys_dnode_t node;
+	/* Next request in client->coap_reqs_submitted */
+	struct golioth_coap_req *submitted_next;
 	struct coap_packet request;
 	struct coap_packet request_wo_block2;
 	struct coap_block_context block_ctx;
 	struct golioth_coap_reply reply;
 
 	struct golioth_coap_pending pending;
+	/* Uptime (ms) of last (re)transmission, used to measure round-trip time */
+	uint32_t sent_at;
 	bool is_observe;
 	bool is_pending;
+	/* Observation waits for (re-)registration after connecting */
+	bool is_suspended;
+
+	/* Offset of Observe option within request packet, needed for deregistration */
+	uint16_t observe_offset;
 
 	struct golioth_client *client;
+	uint32_t handle;
+	/* enum golioth_req_priority */
+	uint8_t priority;
+	/* Overrides of priority class (see golioth_coap_req_params) */
+	int8_t max_retries;
+	uint32_t ack_timeout;
+	/* Uptime (ms) at which request is abandoned, 0 if none */
+	int64_t deadline;
 
 	golioth_req_cb_t cb;
 	void *user_data;
+
+	/* Identity of observation, see golioth_coap_req_params */
+	golioth_req_cb_t app_cb;
+	void *app_user_data;
 };
 
 /**
@@ -144,6 +225,40 @@ int golioth_coap_req_cb(struct golioth_client *client,
 			golioth_req_cb_t cb, void *user_data,
 			int flags);
 
+/**
+ * @brief Create and schedule CoAP request for sending, with additional parameters
+ *
+ * Same as golioth_coap_req_cb(), but additionally accepts @p params.
+ *
+ * Observations survive disconnects and are (re-)registered after connecting. They can be
+ * scheduled also when client is not connected. Scheduling observation identical to already
+ * existing one (same options and application callback) is rejected with -EALREADY, with handle
+ * of existing observation reported.
+ *
+ * @param[in] client Client instance
+ * @param[in] method CoAP request method
+ * @param[in] pathv Array of CoAP path components
+ * @param[in] format Content type
+ * @param[in] data CoAP request payload (NULL if no payload should be appended)
+ * @param[in] data_len Length of CoAP request payload
+ * @param[in] cb Callback executed on response received, timeout or error. Can be NULL.
+ * @param[in] user_data User data passed to @p cb
+ * @param[in] flags Flags (@sa golioth_coap_req_flags)
+ * @param[in] params Additional request parameters (can be NULL)
+ *
+ * @retval 0 On success
+ * @retval -EALREADY Identical observation already exists
+ * @retval <0 On failure
+ */
+int golioth_coap_req_params_cb(struct golioth_client *client,
+			       enum coap_method method,
+			       const uint8_t **pathv,
+			       enum golioth_content_format format,
+			       const uint8_t *data, size_t data_len,
+			       golioth_req_cb_t cb, void *user_data,
+			       int flags,
+			       const struct golioth_coap_req_params *params);
+
 /**
  * @brief Schedule CoAP request and synchronously wait for response
  *
@@ -171,6 +286,34 @@ int golioth_coap_req_sync(struct golioth_client *client,
 			  golioth_req_cb_t cb, void *user_data,
 			  int flags);
 
+/**
+ * @brief Schedule CoAP request and synchronously wait for response, with additional parameters
+ *
+ * Same as golioth_coap_req_sync(), but additionally accepts @p params.
+ *
+ * @param[in] client Client instance
+ * @param[in] method CoAP request method
+ * @param[in] pathv Array of CoAP path components
+ * @param[in] format Content type
+ * @param[in] data CoAP request payload (NULL if no payload should be appended)
+ * @param[in] data_len Length of CoAP request payload
+ * @param[in] cb Callback executed on response received, timeout or error
+ * @param[in] user_data User data passed to @p cb
+ * @param[in] flags Flags (@sa golioth_coap_req_flags)
+ * @param[in] params Additional request parameters (can be NULL)
+ *
+ * @retval 0 On success
+ * @retval <0 On failure
+ */
+int golioth_coap_req_params_sync(struct golioth_client *client,
+				 enum coap_method method,
+				 const uint8_t **pathv,
+				 enum golioth_content_format format,
+				 const uint8_t *data, size_t data_len,
+				 golioth_req_cb_t cb, void *user_data,
+				 int flags,
+				 const struct golioth_coap_req_params *params);
+
 /**
  * @brief Handle CoAP packets (re)transmission and timeout
  *
@@ -190,6 +333,35 @@ int golioth_coap_req_sync(struct golioth_client *client,
  */
 int64_t golioth_coap_reqs_poll_prepare(struct golioth_client *client, int64_t now);
 
+/**
+ * @brief Cancel scheduled CoAP request
+ *
+ * Cancels request identified by @p handle, invoking its callback with @p reason error.
+ *
+ * @param[in] client Client instance
+ * @param[in] handle Handle of request (@sa golioth_coap_req_params)
+ * @param[in] reason Error passed to request callback
+ *
+ * @retval 0 On success
+ * @retval -ENOENT There is no such request (e.g. it is already completed)
+ */
+int golioth_coap_req_cancel_handle(struct golioth_client *client, uint32_t handle, int reason);
+
+/**
+ * @brief Stop observation
+ *
+ * Cancels observation identified by @p handle (invoking its callback with -ECANCELED error) and
+ * schedules deregistration GET request (Observe option set to 1) with the same token and options.
+ *
+ * @param[in] client Client instance
+ * @param[in] handle Handle of observation
+ *
+ * @retval 0 On success
+ * @retval -ENOENT There is no such observation
+ * @retval -EINVAL Request identified by @p handle is not an observation
+ */
+int golioth_coap_req_observe_stop(struct golioth_client *client, uint32_t handle);
+
 /**
  * @brief Process received CoAP packet
  *
@@ -12,6 +12,8 @@
 
 #include <zephyr/net/coap.h>
 
+#define COAP_RESPONSE_CODE_CLASS(code)	((code) >> 5)
+
 /**
  * Check CoAP packet type based on raw data received.
  *
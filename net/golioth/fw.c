@@ -236,6 +236,9 @@ int golioth_fw_report_state_cb(struct golioth_client *client,
 			       enum golioth_dfu_result result,
 			       golioth_req_cb_t cb, void *user_data)
 {
+	struct golioth_coap_req_params params = {
+		.priority = GOLIOTH_REQ_PRIORITY_CONTROL,
+	};
 	uint8_t encode_buf[64];
 	ZCBOR_STATE_E(zse, 1, encode_buf, sizeof(encode_buf), 1);
 	int err;
@@ -246,21 +249,26 @@ int golioth_fw_report_state_cb(struct golioth_client *client,
 		return err;
 	}
 
-	return golioth_coap_req_cb(client, COAP_METHOD_POST,
-				     PATHV(GOLIOTH_FW_REPORT_STATE, package_name),
-				     GOLIOTH_CONTENT_FORMAT_APP_CBOR,
-				     encode_buf, zse->payload - encode_buf,
-				     cb, user_data,
-				     0);
+	return golioth_coap_req_params_cb(client, COAP_METHOD_POST,
+					  PATHV(GOLIOTH_FW_REPORT_STATE, package_name),
+					  GOLIOTH_CONTENT_FORMAT_APP_CBOR,
+					  encode_buf, zse->payload - encode_buf,
+					  cb, user_data,
+					  0,
+					  &params);
 }
 
-int golioth_fw_report_state(struct golioth_client *client,
-			    const char *package_name,
-			    const char *current_version,
-			    const char *target_version,
-			    enum golioth_fw_state state,
-			    enum golioth_dfu_result result)
+int golioth_fw_report_state_opts(struct golioth_client *client,
+				 const char *package_name,
+				 const char *current_version,
+				 const char *target_version,
+				 enum golioth_fw_state state,
+				 enum golioth_dfu_result result,
+				 const struct golioth_req_opts *opts)
 {
+	struct golioth_coap_req_params params = {
+		.priority = GOLIOTH_REQ_PRIORITY_CONTROL,
+	};
 	uint8_t encode_buf[64];
 	ZCBOR_STATE_E(zse, 1, encode_buf, sizeof(encode_buf), 1);
 	int err;
@@ -271,10 +279,24 @@ int golioth_fw_report_state(struct golioth_client *client,
 		return err;
 	}
 
-	return golioth_coap_req_sync(client, COAP_METHOD_POST,
-				     PATHV(GOLIOTH_FW_REPORT_STATE, package_name),
-				     GOLIOTH_CONTENT_FORMAT_APP_CBOR,
-				     encode_buf, zse->payload - encode_buf,
-				     NULL, NULL,
-				     0);
+	golioth_coap_req_params_from_opts(&params, opts);
+
+	return golioth_coap_req_params_sync(client, COAP_METHOD_POST,
+					    PATHV(GOLIOTH_FW_REPORT_STATE, package_name),
+					    GOLIOTH_CONTENT_FORMAT_APP_CBOR,
+					    encode_buf, zse->payload - encode_buf,
+					    NULL, NULL,
+					    0,
+					    &params);
+}
+
+int golioth_fw_report_state(struct golioth_client *client,
+			    const char *package_name,
+			    const char *current_version,
+			    const char *target_version,
+			    enum golioth_fw_state state,
+			    enum golioth_dfu_result result)
+{
+	return golioth_fw_report_state_opts(client, package_name, current_version, target_version,
+					    state, result, NULL);
 }
@@ -15,7 +15,11 @@
 
 #include "coap_req.h"
 #include "coap_utils.h"
+#include "golioth_metrics.h"
+#include "golioth_trace.h"
 #include "golioth_utils.h"
+#include "lightdb_cache.h"
+#include "rx_buf.h"
 
 #include <zephyr/logging/log.h>
 LOG_MODULE_REGISTER(golioth, CONFIG_GOLIOTH_LOG_LEVEL);
@@ -34,20 +38,22 @@ void golioth_init(struct golioth_client *client)
 	memset(client, 0, sizeof(*client));
 
 	k_mutex_init(&client->lock);
+	k_mutex_init(&client->rx_lock);
+	k_mutex_init(&client->tx_lock);
 	client->sock = -1;
 
 	golioth_coap_reqs_init(client);
+	golioth_lightdb_cache_init(client);
 }
 
 bool golioth_is_connected(struct golioth_client *client)
 {
-	bool is_connected;
-
-	k_mutex_lock(&client->lock, K_FOREVER);
-	is_connected = (client->sock >= 0);
-	k_mutex_unlock(&client->lock);
-
-	return is_connected;
+	/*
+	 * Only sign of descriptor is checked (single word read), which does not need to be
+	 * consistent with concurrent connect or close. Descriptor is never used here, so there is
+	 * no need to wait for sender or receiver holding rx_lock or tx_lock.
+	 */
+	return (client->sock >= 0);
 }
 
 static int golioth_setsockopt_dtls(struct golioth_client *client, int sock,
@@ -55,6 +61,10 @@ static int golioth_setsockopt_dtls(struct golioth_client *client, int sock,
 {
 	int ret;
 
+	if (IS_ENABLED(CONFIG_GOLIOTH_PROTO_COAP_UDP) && client->proto == IPPROTO_UDP) {
+		return 0;
+	}
+
 	if (client->tls.sec_tag_list && client->tls.sec_tag_count) {
 		ret = zsock_setsockopt(sock, SOL_TLS, TLS_SEC_TAG_LIST,
 				client->tls.sec_tag_list,
@@ -90,6 +100,25 @@ static int golioth_setsockopt_dtls(struct golioth_client *client, int sock,
 		}
 	}
 
+#ifdef CONFIG_GOLIOTH_TLS_SESSION_CACHE
+	int session_cache = TLS_SESSION_CACHE_ENABLED;
+
+	/*
+	 * Keep DTLS session in RAM after socket is closed, so that next connection to the same
+	 * server performs abbreviated handshake (session resumption) instead of full one.
+	 */
+	ret = zsock_setsockopt(sock, SOL_TLS, TLS_SESSION_CACHE,
+			       &session_cache, sizeof(session_cache));
+	if (ret < 0) {
+		if (errno != ENOPROTOOPT) {
+			return -errno;
+		}
+
+		/* Session resumption is an optimization, so connect without it */
+		LOG_WRN("TLS session cache not supported");
+	}
+#endif /* CONFIG_GOLIOTH_TLS_SESSION_CACHE */
+
 	/* If Connection IDs are enabled, set socket option to send CIDs, but not require that the
 	 * server sends one in return.
 	 */
@@ -133,11 +162,18 @@ static int __golioth_send(struct golioth_client *client, uint8_t *data,
 
 	sent = zsock_send(client->sock, data, len, flags);
 	if (sent < 0) {
-		return -errno;
+		sent = -errno;
+	}
+
+	GOLIOTH_TRACE_SOCK_SEND(client->sock, sent);
+	if (sent < 0) {
+		return sent;
 	} else if (sent < len) {
 		return -EIO;
 	}
 
+	golioth_metrics_tx(client, sent);
+
 	return 0;
 }
 
@@ -161,6 +197,8 @@ static int __golioth_send_empty_coap(struct golioth_client *client)
 static int golioth_connect_sockaddr(struct golioth_client *client, const char *host,
 				    struct sockaddr *addr, socklen_t addrlen)
 {
+	int64_t handshake_start;
+	uint32_t handshake_ms;
 	int sock;
 	int ret;
 	int err = 0;
@@ -175,24 +213,36 @@ static int golioth_connect_sockaddr(struct golioth_client *client, const char *h
 		goto close_sock;
 	}
 
+	handshake_start = k_uptime_get();
+
 	ret = zsock_connect(sock, addr, addrlen);
 	if (ret < 0) {
 		err = -errno;
+		golioth_metrics_handshake_failed(client);
 		goto close_sock;
 	}
 
-	golioth_lock(client);
+	golioth_sock_lock(client);
 	client->sock = sock;
 
 	/* Send empty packet to start TLS handshake */
 	err = __golioth_send_empty_coap(client);
 	if (err) {
 		client->sock = -1;
-		goto unlock;
 	}
 
-unlock:
-	golioth_unlock(client);
+	golioth_sock_unlock(client);
+
+	if (err) {
+		golioth_metrics_handshake_failed(client);
+		goto close_sock;
+	}
+
+	handshake_ms = k_uptime_get() - handshake_start;
+
+	golioth_metrics_handshake(client, handshake_ms);
+
+	LOG_DBG("Handshake took %u ms", (unsigned int)handshake_ms);
 
 close_sock:
 	if (err) {
@@ -221,6 +271,148 @@ close_sock:
 #define LOG_SOCKADDR(fmt, addr)
 #endif
 
+#ifdef CONFIG_GOLIOTH_DNS_CACHE
+
+#define DNS_CACHE_TTL	(CONFIG_GOLIOTH_DNS_CACHE_TTL_SEC * MSEC_PER_SEC)
+
+static int golioth_dns_cache_update(struct golioth_dns_cache *cache,
+				    const char *host, uint16_t port)
+{
+	struct zsock_addrinfo hints = {
+		.ai_family = AF_UNSPEC,
+		.ai_socktype = SOCK_DGRAM,
+		.ai_protocol = IPPROTO_UDP,
+	};
+	struct zsock_addrinfo *addrs, *addr;
+	char port_str[8];
+	int ret;
+
+	if (cache->count > 0 && cache->port == port && !strcmp(cache->host, host) &&
+	    cache->expiry > k_uptime_get()) {
+		LOG_DBG("Using cached addresses of %s", host);
+		return 0;
+	}
+
+	cache->count = 0;
+	cache->good = -1;
+
+	snprintf(port_str, sizeof(port_str), "%" PRIu16, port);
+
+	ret = zsock_getaddrinfo(host, port_str, &hints, &addrs);
+	if (ret < 0) {
+		LOG_ERR("Fail to get address (%s %s) %d", host, port_str, ret);
+		return -EAGAIN;
+	}
+
+	for (addr = addrs;
+	     addr != NULL && cache->count < ARRAY_SIZE(cache->addrs);
+	     addr = addr->ai_next) {
+		if (addr->ai_addrlen > sizeof(cache->addrs[0])) {
+			continue;
+		}
+
+		memcpy(&cache->addrs[cache->count], addr->ai_addr, addr->ai_addrlen);
+		cache->addrlens[cache->count] = addr->ai_addrlen;
+		cache->count++;
+	}
+
+	zsock_freeaddrinfo(addrs);
+
+	if (strlen(host) < sizeof(cache->host)) {
+		strcpy(cache->host, host);
+		cache->port = port;
+		cache->expiry = k_uptime_get() + DNS_CACHE_TTL;
+	} else {
+		/* Host name does not fit, so use addresses only for this connection attempt */
+		cache->host[0] = '\0';
+		cache->expiry = 0;
+	}
+
+	return 0;
+}
+
+/*
+ * Order in which cached addresses are tried: last known good address first, then remaining
+ * addresses interleaving address families, so that broken IPv6 (or IPv4) connectivity does not
+ * need to time out on all addresses of that family before the other one is tried.
+ */
+static size_t golioth_dns_cache_order(const struct golioth_dns_cache *cache, uint8_t *order)
+{
+	bool used[ARRAY_SIZE(cache->addrs)] = {};
+	sa_family_t prev_family = AF_UNSPEC;
+	size_t n = 0;
+
+	if (cache->good >= 0 && cache->good < cache->count) {
+		order[n++] = cache->good;
+		used[cache->good] = true;
+		prev_family = cache->addrs[cache->good].sa_family;
+	}
+
+	while (n < cache->count) {
+		int next = -1;
+
+		for (int i = 0; i < cache->count; i++) {
+			if (used[i]) {
+				continue;
+			}
+
+			if (next < 0) {
+				next = i;
+			}
+
+			if (cache->addrs[i].sa_family != prev_family) {
+				next = i;
+				break;
+			}
+		}
+
+		order[n++] = next;
+		used[next] = true;
+		prev_family = cache->addrs[next].sa_family;
+	}
+
+	return n;
+}
+
+static int __golioth_connect(struct golioth_client *client,
+			     const char *host, uint16_t port)
+{
+	struct golioth_dns_cache *cache = &client->dns_cache;
+	uint8_t order[ARRAY_SIZE(cache->addrs)];
+	size_t num_addrs;
+	int err;
+
+	err = golioth_dns_cache_update(cache, host, port);
+	if (err) {
+		return err;
+	}
+
+	err = -ENOENT;
+
+	num_addrs = golioth_dns_cache_order(cache, order);
+
+	for (size_t i = 0; i < num_addrs; i++) {
+		struct sockaddr *addr = &cache->addrs[order[i]];
+
+		LOG_SOCKADDR("Trying addr '%s'", addr);
+
+		err = golioth_connect_sockaddr(client, host, addr, cache->addrlens[order[i]]);
+		if (!err) {
+			/* Ready to go */
+			cache->good = order[i];
+			return 0;
+		}
+	}
+
+	/* Resolve again on next attempt, as addresses might have changed */
+	cache->count = 0;
+	cache->good = -1;
+
+	return err;
+}
+
+#else /* CONFIG_GOLIOTH_DNS_CACHE */
+
 static int __golioth_connect(struct golioth_client *client,
 			     const char *host, uint16_t port)
 {
@@ -257,6 +449,8 @@ static int __golioth_connect(struct golioth_client *client,
 	return err;
 }
 
+#endif /* CONFIG_GOLIOTH_DNS_CACHE */
+
 int golioth_connect(struct golioth_client *client, const char *host,
 		    uint16_t port)
 {
@@ -282,14 +476,38 @@ static int golioth_close(struct golioth_client *client)
 {
 	int ret;
 
-	golioth_lock(client);
+	golioth_sock_lock(client);
 	ret = __golioth_close(client->sock);
 	client->sock = -1;
-	golioth_unlock(client);
+	golioth_sock_unlock(client);
 
 	return ret;
 }
 
+bool golioth_connection_id_is_active(struct golioth_client *client)
+{
+#ifdef CONFIG_GOLIOTH_USE_CONNECTION_ID
+	int status = TLS_DTLS_CID_STATUS_DISABLED;
+	socklen_t len = sizeof(status);
+	int ret = -1;
+
+	k_mutex_lock(&client->tx_lock, K_FOREVER);
+	if (client->sock >= 0) {
+		ret = zsock_getsockopt(client->sock, SOL_TLS, TLS_DTLS_CID_STATUS, &status, &len);
+	}
+	k_mutex_unlock(&client->tx_lock);
+
+	if (ret < 0) {
+		return false;
+	}
+
+	return (status == TLS_DTLS_CID_STATUS_UPLINK ||
+		status == TLS_DTLS_CID_STATUS_BIDIRECTIONAL);
+#else
+	return false;
+#endif
+}
+
 int golioth_disconnect(struct golioth_client *client)
 {
 	golioth_coap_reqs_on_disconnect(client);
@@ -312,14 +530,25 @@ int golioth_set_proto_coap_dtls(struct golioth_client *client,
 	return 0;
 }
 
+#ifdef CONFIG_GOLIOTH_PROTO_COAP_UDP
+int golioth_set_proto_coap_udp(struct golioth_client *client)
+{
+	client->proto = IPPROTO_UDP;
+	client->tls.sec_tag_list = NULL;
+	client->tls.sec_tag_count = 0;
+
+	return 0;
+}
+#endif /* CONFIG_GOLIOTH_PROTO_COAP_UDP */
+
 static int golioth_send(struct golioth_client *client, uint8_t *data,
 			size_t len, int flags)
 {
 	int ret;
 
-	golioth_lock(client);
+	k_mutex_lock(&client->tx_lock, K_FOREVER);
 	ret = __golioth_send(client, data, len, flags);
-	golioth_unlock(client);
+	k_mutex_unlock(&client->tx_lock);
 
 	return ret;
 }
@@ -364,9 +593,9 @@ static int golioth_sendmsg(struct golioth_client *client,
 		return -ENOMEM;
 	}
 
-	golioth_lock(client);
+	k_mutex_lock(&client->tx_lock, K_FOREVER);
 	ret = __golioth_send(client, data, len, flags);
-	golioth_unlock(client);
+	k_mutex_unlock(&client->tx_lock);
 
 	free(data);
 
@@ -519,11 +748,18 @@ static int __golioth_recv(struct golioth_client *client, uint8_t *data,
 
 	rcvd = zsock_recv(client->sock, data, len, flags);
 	if (rcvd < 0) {
-		return -errno;
+		rcvd = -errno;
+	}
+
+	GOLIOTH_TRACE_SOCK_RECV(client->sock, rcvd);
+	if (rcvd < 0) {
+		return rcvd;
 	} else if (rcvd == 0) {
 		return -ENOTCONN;
 	}
 
+	golioth_metrics_rx(client, rcvd);
+
 	return rcvd;
 }
 
@@ -532,14 +768,21 @@ static int golioth_recv(struct golioth_client *client, uint8_t *data,
 {
 	int ret;
 
-	golioth_lock(client);
+	k_mutex_lock(&client->rx_lock, K_FOREVER);
 	ret = __golioth_recv(client, data, len, flags);
-	golioth_unlock(client);
+	k_mutex_unlock(&client->rx_lock);
 
 	return ret;
 }
 
-int golioth_process_rx(struct golioth_client *client)
+/**
+ * @brief Receive and process single datagram
+ *
+ * @retval 1 Datagram was processed
+ * @retval 0 No pending datagram
+ * @retval <0 On failure
+ */
+static int golioth_process_rx_one(struct golioth_client *client)
 {
 	int flags = ZSOCK_MSG_DONTWAIT |
 		(IS_ENABLED(CONFIG_GOLIOTH_RECV_USE_MSG_TRUNC) ? ZSOCK_MSG_TRUNC : 0);
@@ -566,12 +809,38 @@ int golioth_process_rx(struct golioth_client *client)
 	err = coap_data_check_rx_packet_type(client->rx_buffer, ret);
 	if (err == -ENOMSG) {
 		/* ping */
-		return golioth_process_rx_ping(client, client->rx_buffer, ret);
-	} else if (err) {
+		err = golioth_process_rx_ping(client, client->rx_buffer, ret);
+	} else if (!err) {
+		err = golioth_process_rx_data(client, client->rx_buffer, ret);
+
+		/* Use fresh buffer for next datagram, if current one was claimed by user */
+		golioth_rx_buf_swap(client);
+	}
+
+	if (err) {
 		return err;
 	}
 
-	return golioth_process_rx_data(client, client->rx_buffer, ret);
+	return 1;
+}
+
+int golioth_process_rx(struct golioth_client *client)
+{
+	int ret;
+
+	/*
+	 * Process datagrams queued on socket (e.g. burst of observe notifications or pipelined
+	 * blocks), so that each of them does not cost full iteration of caller's poll loop. Number
+	 * of datagrams is bounded, so that timeouts are still handled in time under heavy traffic.
+	 */
+	for (int i = 0; i < CONFIG_GOLIOTH_RX_DRAIN_MAX; i++) {
+		ret = golioth_process_rx_one(client);
+		if (ret <= 0) {
+			return ret;
+		}
+	}
+
+	return 0;
 }
 
 void golioth_poll_prepare(struct golioth_client *client, int64_t now,
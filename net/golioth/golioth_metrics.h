@@ -0,0 +1,114 @@
+/*
+ * Copyright (c) 2023 Golioth, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef GOLIOTH_NET_GOLIOTH_GOLIOTH_METRICS_H_
+#define GOLIOTH_NET_GOLIOTH_GOLIOTH_METRICS_H_
+
+#include <net/golioth.h>
+#include <zephyr/sys/atomic.h>
+
+/*
+ * Hooks updating client metrics. They compile to nothing when CONFIG_GOLIOTH_METRICS is
+ * disabled, so can be called unconditionally from hot paths.
+ */
+
+#ifdef CONFIG_GOLIOTH_METRICS
+
+static inline void golioth_metrics_max(atomic_t *max, atomic_val_t value)
+{
+	atomic_val_t old;
+
+	do {
+		old = atomic_get(max);
+		if (value <= old) {
+			return;
+		}
+	} while (!atomic_cas(max, old, value));
+}
+
+static inline void golioth_metrics_req_sent(struct golioth_client *client, bool retransmit)
+{
+	atomic_inc(retransmit ? &client->metrics.retransmits : &client->metrics.reqs_sent);
+}
+
+static inline void golioth_metrics_req_timeout(struct golioth_client *client)
+{
+	atomic_inc(&client->metrics.timeouts);
+}
+
+void golioth_metrics_rsp(struct golioth_client *client, uint8_t code);
+
+void golioth_metrics_rtt(struct golioth_client *client, uint32_t rtt_ms);
+
+static inline void golioth_metrics_pending_inc(struct golioth_client *client)
+{
+	golioth_metrics_max(&client->metrics.pending_max,
+			    atomic_inc(&client->metrics.pending) + 1);
+}
+
+static inline void golioth_metrics_pending_dec(struct golioth_client *client)
+{
+	atomic_dec(&client->metrics.pending);
+}
+
+static inline void golioth_metrics_heap_alloc(struct golioth_client *client, size_t len)
+{
+	golioth_metrics_max(&client->metrics.heap_used_max,
+			    atomic_add(&client->metrics.heap_used, len) + len);
+}
+
+static inline void golioth_metrics_heap_free(struct golioth_client *client, size_t len)
+{
+	atomic_sub(&client->metrics.heap_used, len);
+}
+
+static inline void golioth_metrics_tx(struct golioth_client *client, size_t len)
+{
+	atomic_add(&client->metrics.bytes_tx, len);
+}
+
+static inline void golioth_metrics_rx(struct golioth_client *client, size_t len)
+{
+	atomic_add(&client->metrics.bytes_rx, len);
+}
+
+static inline void golioth_metrics_reconnect(struct golioth_client *client)
+{
+	atomic_inc(&client->metrics.reconnects);
+}
+
+static inline void golioth_metrics_handshake(struct golioth_client *client, uint32_t ms)
+{
+	atomic_inc(&client->metrics.handshakes);
+	atomic_set(&client->metrics.handshake_last_ms, ms);
+	golioth_metrics_max(&client->metrics.handshake_max_ms, ms);
+	atomic_add(&client->metrics.handshake_total_ms, ms);
+}
+
+static inline void golioth_metrics_handshake_failed(struct golioth_client *client)
+{
+	atomic_inc(&client->metrics.handshake_failures);
+}
+
+#else /* CONFIG_GOLIOTH_METRICS */
+
+static inline void golioth_metrics_req_sent(struct golioth_client *client, bool retransmit) {}
+static inline void golioth_metrics_req_timeout(struct golioth_client *client) {}
+static inline void golioth_metrics_rsp(struct golioth_client *client, uint8_t code) {}
+static inline void golioth_metrics_rtt(struct golioth_client *client, uint32_t rtt_ms) {}
+static inline void golioth_metrics_pending_inc(struct golioth_client *client) {}
+static inline void golioth_metrics_pending_dec(struct golioth_client *client) {}
+static inline void golioth_metrics_heap_alloc(struct golioth_client *client, size_t len) {}
+static inline void golioth_metrics_heap_free(struct golioth_client *client, size_t len) {}
+static inline void golioth_metrics_tx(struct golioth_client *client, size_t len) {}
+static inline void golioth_metrics_rx(struct golioth_client *client, size_t len) {}
+static inline void golioth_metrics_reconnect(struct golioth_client *client) {}
+static inline void golioth_metrics_handshake(struct golioth_client *client, uint32_t ms) {}
+static inline void golioth_metrics_handshake_failed(struct golioth_client *client) {}
+
+#endif /* CONFIG_GOLIOTH_METRICS */
+
+#endif /* GOLIOTH_NET_GOLIOTH_GOLIOTH_METRICS_H_ */
@@ -0,0 +1,56 @@
+/*
+ * Copyright (c) 2023 Golioth, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef GOLIOTH_NET_GOLIOTH_GOLIOTH_TRACE_H_
+#define GOLIOTH_NET_GOLIOTH_GOLIOTH_TRACE_H_
+
+/*
+ * Tracepoints of request and socket hot paths.
+ *
+ * Events are routed to Zephyr tracing subsystem as named events, so they show up in any tracing
+ * backend implementing sys_trace_named_event() (e.g. SEGGER SystemView or CTF). Each event carries
+ * two 32-bit arguments, typically request handle and event specific value.
+ *
+ * Tracepoints compile to nothing unless CONFIG_GOLIOTH_TRACING is enabled.
+ */
+
+#ifdef CONFIG_GOLIOTH_TRACING
+
+#include <zephyr/tracing/tracing.h>
+
+#define GOLIOTH_TRACE(event, arg0, arg1)					\
+	sys_trace_named_event("golioth_" #event, (uint32_t)(arg0), (uint32_t)(arg1))
+
+#else /* CONFIG_GOLIOTH_TRACING */
+
+#define GOLIOTH_TRACE(event, arg0, arg1)	do { } while (false)
+
+#endif /* CONFIG_GOLIOTH_TRACING */
+
+/* Request allocated (handle, buffer length) */
+#define GOLIOTH_TRACE_REQ_ALLOC(req, len)	GOLIOTH_TRACE(req_alloc, (req)->handle, len)
+/* Request scheduled (handle, priority class) */
+#define GOLIOTH_TRACE_REQ_SCHEDULE(req)		GOLIOTH_TRACE(req_schedule, (req)->handle, (req)->priority)
+/* Request transmitted for the first time (handle, message ID) */
+#define GOLIOTH_TRACE_REQ_SEND(req, id)		GOLIOTH_TRACE(req_send, (req)->handle, id)
+/* Request retransmitted (handle, retransmissions left) */
+#define GOLIOTH_TRACE_REQ_RETRANSMIT(req)	GOLIOTH_TRACE(req_retransmit, (req)->handle, \
+							      (req)->pending.retries)
+/* Received response matched request (handle, response code) */
+#define GOLIOTH_TRACE_REQ_MATCH(req, code)	GOLIOTH_TRACE(req_match, (req)->handle, code)
+/* Entering request callback (handle, error passed to callback) */
+#define GOLIOTH_TRACE_REQ_CB_ENTER(req, err)	GOLIOTH_TRACE(req_cb_enter, (req)->handle, err)
+/* Returned from request callback (handle, value returned by callback) */
+#define GOLIOTH_TRACE_REQ_CB_EXIT(req, ret)	GOLIOTH_TRACE(req_cb_exit, (req)->handle, ret)
+/* Request freed (handle, 0) */
+#define GOLIOTH_TRACE_REQ_FREE(req)		GOLIOTH_TRACE(req_free, (req)->handle, 0)
+
+/* Datagram sent to socket (socket, length or negative error) */
+#define GOLIOTH_TRACE_SOCK_SEND(sock, ret)	GOLIOTH_TRACE(sock_send, sock, ret)
+/* Datagram received from socket (socket, length or negative error) */
+#define GOLIOTH_TRACE_SOCK_RECV(sock, ret)	GOLIOTH_TRACE(sock_recv, sock, ret)
+
+#endif /* GOLIOTH_NET_GOLIOTH_GOLIOTH_TRACE_H_ */
@@ -8,6 +8,7 @@
 
 #include "coap_req.h"
 #include "coap_utils.h"
+#include "lightdb_cache.h"
 #include "pathv.h"
 
 #include <zephyr/logging/log.h>
@@ -21,12 +22,18 @@ static inline int golioth_coap_req_lightdb_cb(struct golioth_client *client,
 					      enum golioth_content_format format,
 					      const uint8_t *data, size_t data_len,
 					      golioth_req_cb_t cb, void *user_data,
-					      int flags)
+					      int flags,
+					      const struct golioth_req_opts *opts)
 {
-	return golioth_coap_req_cb(client, method, PATHV(LIGHTDB_PATH, path), format,
-				   data, data_len,
-				   cb, user_data,
-				   flags);
+	struct golioth_coap_req_params params = {};
+
+	golioth_coap_req_params_from_opts(&params, opts);
+
+	return golioth_coap_req_params_cb(client, method, PATHV(LIGHTDB_PATH, path), format,
+					  data, data_len,
+					  cb, user_data,
+					  flags,
+					  &params);
 }
 
 static inline int golioth_coap_req_lightdb_sync(struct golioth_client *client,
@@ -35,28 +42,49 @@ static inline int golioth_coap_req_lightdb_sync(struct golioth_client *client,
 						enum golioth_content_format format,
 						const uint8_t *data, size_t data_len,
 						golioth_req_cb_t cb, void *user_data,
-						int flags)
+						int flags,
+						const struct golioth_req_opts *opts)
 {
-	return golioth_coap_req_sync(client, method, PATHV(LIGHTDB_PATH, path), format,
-				     data, data_len,
-				     cb, user_data,
-				     flags);
+	struct golioth_coap_req_params params = {};
+
+	golioth_coap_req_params_from_opts(&params, opts);
+
+	return golioth_coap_req_params_sync(client, method, PATHV(LIGHTDB_PATH, path), format,
+					    data, data_len,
+					    cb, user_data,
+					    flags,
+					    &params);
 }
 
-int golioth_lightdb_get_cb(struct golioth_client *client, const uint8_t *path,
-			   enum golioth_content_format format,
-			   golioth_req_cb_t cb, void *user_data)
+int golioth_lightdb_get_cb_opts(struct golioth_client *client, const uint8_t *path,
+				enum golioth_content_format format,
+				golioth_req_cb_t cb, void *user_data,
+				const struct golioth_req_opts *opts)
 {
+	if (IS_ENABLED(CONFIG_GOLIOTH_LIGHTDB_CACHE)) {
+		return golioth_lightdb_cache_req_cb(client, PATHV(LIGHTDB_PATH, path), path,
+						    format, cb, user_data, 0, opts);
+	}
+
 	return golioth_coap_req_lightdb_cb(client, COAP_METHOD_GET, path, format,
 					   NULL, 0,
 					   cb, user_data,
-					   0);
+					   0,
+					   opts);
+}
+
+int golioth_lightdb_get_cb(struct golioth_client *client, const uint8_t *path,
+			   enum golioth_content_format format,
+			   golioth_req_cb_t cb, void *user_data)
+{
+	return golioth_lightdb_get_cb_opts(client, path, format, cb, user_data, NULL);
 }
 
 struct golioth_lightdb_get_prealloc_data {
 	uint8_t *data;
 	size_t capacity;
 	size_t len;
+	int err;
 };
 
 static int golioth_lightdb_get_prealloc_cb(struct golioth_req_rsp *rsp)
@@ -76,6 +104,7 @@ static int golioth_lightdb_get_prealloc_cb(struct golioth_req_rsp *rsp)
 	if (prealloc_data->capacity < total) {
 		LOG_WRN("Not enough capacity in buffer (%zu < %zu)",
 			prealloc_data->capacity, total);
+		prealloc_data->err = -ENOSPC;
 		return -ENOSPC;
 	}
 
@@ -86,9 +115,10 @@ static int golioth_lightdb_get_prealloc_cb(struct golioth_req_rsp *rsp)
 	return 0;
 }
 
-int golioth_lightdb_get(struct golioth_client *client, const uint8_t *path,
-			enum golioth_content_format format,
-			uint8_t *data, size_t *len)
+int golioth_lightdb_get_opts(struct golioth_client *client, const uint8_t *path,
+			     enum golioth_content_format format,
+			     uint8_t *data, size_t *len,
+			     const struct golioth_req_opts *opts)
 {
 	struct golioth_lightdb_get_prealloc_data prealloc_data = {
 		.data = data,
@@ -96,66 +126,145 @@ int golioth_lightdb_get(struct golioth_client *client, const uint8_t *path,
 	};
 	int err;
 
-	err = golioth_coap_req_lightdb_sync(client, COAP_METHOD_GET, path, format,
-					    NULL, 0,
-					    golioth_lightdb_get_prealloc_cb,
-					    &prealloc_data,
-					    0);
+	if (IS_ENABLED(CONFIG_GOLIOTH_LIGHTDB_CACHE)) {
+		err = golioth_lightdb_cache_req_sync(client, PATHV(LIGHTDB_PATH, path), path,
+						     format,
+						     golioth_lightdb_get_prealloc_cb,
+						     &prealloc_data,
+						     opts);
+	} else {
+		err = golioth_coap_req_lightdb_sync(client, COAP_METHOD_GET, path, format,
+						    NULL, 0,
+						    golioth_lightdb_get_prealloc_cb,
+						    &prealloc_data,
+						    0,
+						    opts);
+	}
 	if (err) {
 		return err;
 	}
 
+	if (prealloc_data.err) {
+		return prealloc_data.err;
+	}
+
 	*len = prealloc_data.len;
 
 	return 0;
 }
 
+int golioth_lightdb_get(struct golioth_client *client, const uint8_t *path,
+			enum golioth_content_format format,
+			uint8_t *data, size_t *len)
+{
+	return golioth_lightdb_get_opts(client, path, format, data, len, NULL);
+}
+
+int golioth_lightdb_set_cb_opts(struct golioth_client *client, const uint8_t *path,
+				enum golioth_content_format format,
+				const uint8_t *data, size_t data_len,
+				golioth_req_cb_t cb, void *user_data,
+				const struct golioth_req_opts *opts)
+{
+	return golioth_coap_req_lightdb_cb(client, COAP_METHOD_POST, path, format,
+					   data, data_len,
+					   cb, user_data,
+					   GOLIOTH_COAP_REQ_NO_RESP_BODY,
+					   opts);
+}
+
 int golioth_lightdb_set_cb(struct golioth_client *client, const uint8_t *path,
 			   enum golioth_content_format format,
 			   const uint8_t *data, size_t data_len,
 			   golioth_req_cb_t cb, void *user_data)
 {
-	return golioth_coap_req_lightdb_cb(client, COAP_METHOD_POST, path, format,
-					   data, data_len,
-					   cb, user_data,
-					   GOLIOTH_COAP_REQ_NO_RESP_BODY);
+	return golioth_lightdb_set_cb_opts(client, path, format, data, data_len, cb, user_data,
+					   NULL);
 }
 
-int golioth_lightdb_set(struct golioth_client *client, const uint8_t *path,
-			enum golioth_content_format format,
-			const uint8_t *data, size_t data_len)
+int golioth_lightdb_set_opts(struct golioth_client *client, const uint8_t *path,
+			     enum golioth_content_format format,
+			     const uint8_t *data, size_t data_len,
+			     const struct golioth_req_opts *opts)
 {
 	return golioth_coap_req_lightdb_sync(client, COAP_METHOD_POST, path, format,
 					     data, data_len,
 					     NULL, NULL,
-					     GOLIOTH_COAP_REQ_NO_RESP_BODY);
+					     GOLIOTH_COAP_REQ_NO_RESP_BODY,
+					     opts);
+}
+
+int golioth_lightdb_set(struct golioth_client *client, const uint8_t *path,
+			enum golioth_content_format format,
+			const uint8_t *data, size_t data_len)
+{
+	return golioth_lightdb_set_opts(client, path, format, data, data_len, NULL);
+}
+
+int golioth_lightdb_observe_cb_opts(struct golioth_client *client, const uint8_t *path,
+				    enum golioth_content_format format,
+				    golioth_req_cb_t cb, void *user_data,
+				    const struct golioth_req_opts *opts)
+{
+	int err;
+
+	if (IS_ENABLED(CONFIG_GOLIOTH_LIGHTDB_CACHE)) {
+		err = golioth_lightdb_cache_req_cb(client, PATHV(LIGHTDB_PATH, path), path,
+						   format, cb, user_data,
+						   GOLIOTH_COAP_REQ_OBSERVE, opts);
+	} else {
+		err = golioth_coap_req_lightdb_cb(client, COAP_METHOD_GET, path, format,
+						  NULL, 0,
+						  cb, user_data,
+						  GOLIOTH_COAP_REQ_OBSERVE,
+						  opts);
+	}
+
+	if (err == -EALREADY) {
+		/* Observation is already established (e.g. before reconnecting) */
+		return 0;
+	}
+
+	return err;
 }
 
 int golioth_lightdb_observe_cb(struct golioth_client *client, const uint8_t *path,
 			       enum golioth_content_format format,
 			       golioth_req_cb_t cb, void *user_data)
 {
-	return golioth_coap_req_lightdb_cb(client, COAP_METHOD_GET, path, format,
-					   NULL, 0,
-					   cb, user_data,
-					   GOLIOTH_COAP_REQ_OBSERVE);
+	return golioth_lightdb_observe_cb_opts(client, path, format, cb, user_data, NULL);
 }
 
-int golioth_lightdb_delete_cb(struct golioth_client *client, const uint8_t *path,
-			      golioth_req_cb_t cb, void *user_data)
+int golioth_lightdb_delete_cb_opts(struct golioth_client *client, const uint8_t *path,
+				   golioth_req_cb_t cb, void *user_data,
+				   const struct golioth_req_opts *opts)
 {
 	return golioth_coap_req_lightdb_cb(client, COAP_METHOD_DELETE, path,
 					   GOLIOTH_CONTENT_FORMAT_APP_OCTET_STREAM /* not used */,
 					   NULL, 0,
 					   cb, user_data,
-					   GOLIOTH_COAP_REQ_NO_RESP_BODY);
+					   GOLIOTH_COAP_REQ_NO_RESP_BODY,
+					   opts);
 }
 
-int golioth_lightdb_delete(struct golioth_client *client, const uint8_t *path)
+int golioth_lightdb_delete_cb(struct golioth_client *client, const uint8_t *path,
+			      golioth_req_cb_t cb, void *user_data)
+{
+	return golioth_lightdb_delete_cb_opts(client, path, cb, user_data, NULL);
+}
+
+int golioth_lightdb_delete_opts(struct golioth_client *client, const uint8_t *path,
+				const struct golioth_req_opts *opts)
 {
 	return golioth_coap_req_lightdb_sync(client, COAP_METHOD_DELETE, path,
 					     GOLIOTH_CONTENT_FORMAT_APP_OCTET_STREAM /* not used */,
 					     NULL, 0,
 					     NULL, NULL,
-					     GOLIOTH_COAP_REQ_NO_RESP_BODY);
+					     GOLIOTH_COAP_REQ_NO_RESP_BODY,
+					     opts);
+}
+
+int golioth_lightdb_delete(struct golioth_client *client, const uint8_t *path)
+{
+	return golioth_lightdb_delete_opts(client, path, NULL);
 }
@@ -0,0 +1,507 @@
+/*
+ * Copyright (c) 2023 Golioth, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <net/golioth.h>
+#include <stdlib.h>
+#include <string.h>
+#include <zcbor_decode.h>
+#include <zcbor_encode.h>
+
+#include "coap_req.h"
+#include "pathv.h"
+#include "zcbor_any_skip_fixed.h"
+#include "zcbor_utils.h"
+
+#include <zephyr/logging/log.h>
+LOG_MODULE_DECLARE(lightdb, CONFIG_GOLIOTH_LOG_LEVEL);
+
+#define LIGHTDB_PATH		".d"
+#define BATCH_MAX_LEN		CONFIG_GOLIOTH_LIGHTDB_BATCH_MAX_LEN
+
+BUILD_ASSERT(offsetof(struct golioth_lightdb_set_item, path) == 0);
+BUILD_ASSERT(offsetof(struct golioth_lightdb_get_item, path) == 0);
+
+/* Path of i-th item, for both set and get items */
+#define ITEM_PATH(_items, _item_size, _i)					\
+	(*(const char *const *)((const uint8_t *)(_items) + (_i) * (_item_size)))
+
+static size_t path_common_parent_len(const char *parent, size_t parent_len, const char *path)
+{
+	size_t common_len = 0;
+	size_t i;
+
+	for (i = 0; i < parent_len && parent[i] == path[i]; i++) {
+		if (parent[i] == '/') {
+			common_len = i;
+		}
+	}
+
+	if (i == parent_len && path[i] == '/') {
+		return parent_len;
+	}
+
+	return common_len;
+}
+
+static inline const char *path_key(const char *path, size_t parent_len)
+{
+	return parent_len ? &path[parent_len + 1] : path;
+}
+
+/**
+ * @brief Find common parent path of all items and validate keys relative to it
+ *
+ * @retval 0 On success, length of common parent path stored in @p parent_len
+ * @retval -EINVAL Item is not direct child of common parent or is duplicated
+ */
+static int batch_parent_len(const void *items, size_t item_size, size_t num_items,
+			    size_t *parent_len)
+{
+	const char *first;
+	const char *sep;
+	size_t len;
+
+	if (!num_items) {
+		return -EINVAL;
+	}
+
+	first = ITEM_PATH(items, item_size, 0);
+	sep = strrchr(first, '/');
+	len = (sep ? sep - first : 0);
+
+	for (size_t i = 1; i < num_items; i++) {
+		len = path_common_parent_len(first, len, ITEM_PATH(items, item_size, i));
+	}
+
+	for (size_t i = 0; i < num_items; i++) {
+		const char *key = path_key(ITEM_PATH(items, item_size, i), len);
+
+		if (key[0] == '\0' || strchr(key, '/')) {
+			LOG_WRN("Path %s is not direct child of common parent",
+				ITEM_PATH(items, item_size, i));
+			return -EINVAL;
+		}
+
+		for (size_t j = 0; j < i; j++) {
+			if (strcmp(key, path_key(ITEM_PATH(items, item_size, j), len)) == 0) {
+				LOG_WRN("Duplicated path %s", ITEM_PATH(items, item_size, i));
+				return -EINVAL;
+			}
+		}
+	}
+
+	*parent_len = len;
+
+	return 0;
+}
+
+static int batch_set_encode(zcbor_state_t *zse,
+			    const struct golioth_lightdb_set_item *items, size_t num_items,
+			    size_t parent_len)
+{
+	bool ok;
+
+	ok = zcbor_map_start_encode(zse, num_items);
+	if (!ok) {
+		return -ENOMEM;
+	}
+
+	for (size_t i = 0; i < num_items; i++) {
+		const struct golioth_lightdb_set_item *item = &items[i];
+		const char *key = path_key(item->path, parent_len);
+
+		ok = zcbor_tstr_encode_ptr(zse, key, strlen(key));
+		if (!ok) {
+			return -ENOMEM;
+		}
+
+		switch (item->type) {
+		case GOLIOTH_LIGHTDB_VALUE_INT:
+			ok = zcbor_int64_put(zse, item->i64);
+			break;
+		case GOLIOTH_LIGHTDB_VALUE_FLOAT:
+			ok = zcbor_float64_put(zse, item->f);
+			break;
+		case GOLIOTH_LIGHTDB_VALUE_BOOL:
+			ok = zcbor_bool_put(zse, item->b);
+			break;
+		case GOLIOTH_LIGHTDB_VALUE_STRING:
+			ok = zcbor_tstr_encode_ptr(zse, item->str, strlen(item->str));
+			break;
+		default:
+			LOG_WRN("Invalid type %d of %s", (int) item->type, item->path);
+			return -EINVAL;
+		}
+
+		if (!ok) {
+			return -ENOMEM;
+		}
+	}
+
+	ok = zcbor_map_end_encode(zse, num_items);
+	if (!ok) {
+		return -ENOMEM;
+	}
+
+	return 0;
+}
+
+/**
+ * @brief Encode batch set request
+ *
+ * Allocates single buffer with NULL-terminated parent path, followed by encoded CBOR map.
+ */
+static int batch_set_prepare(const struct golioth_lightdb_set_item *items, size_t num_items,
+			     uint8_t **buf, size_t *payload_len)
+{
+	size_t parent_len;
+	uint8_t *payload;
+	int err;
+
+	err = batch_parent_len(items, sizeof(*items), num_items, &parent_len);
+	if (err) {
+		return err;
+	}
+
+	*buf = malloc(parent_len + 1 + BATCH_MAX_LEN);
+	if (!*buf) {
+		return -ENOMEM;
+	}
+
+	memcpy(*buf, items[0].path, parent_len);
+	(*buf)[parent_len] = '\0';
+
+	payload = &(*buf)[parent_len + 1];
+
+	ZCBOR_STATE_E(zse, 1, payload, BATCH_MAX_LEN, 1);
+
+	err = batch_set_encode(zse, items, num_items, parent_len);
+	if (err) {
+		free(*buf);
+		return err;
+	}
+
+	*payload_len = zse->payload - payload;
+
+	return 0;
+}
+
+int golioth_lightdb_set_batch_cb(struct golioth_client *client,
+				 const struct golioth_lightdb_set_item *items, size_t num_items,
+				 golioth_req_cb_t cb, void *user_data)
+{
+	size_t payload_len;
+	uint8_t *buf;
+	int err;
+
+	err = batch_set_prepare(items, num_items, &buf, &payload_len);
+	if (err) {
+		return err;
+	}
+
+	err = golioth_coap_req_cb(client, COAP_METHOD_POST, PATHV(LIGHTDB_PATH, buf),
+				  GOLIOTH_CONTENT_FORMAT_APP_CBOR,
+				  &buf[strlen(buf) + 1], payload_len,
+				  cb, user_data,
+				  GOLIOTH_COAP_REQ_NO_RESP_BODY);
+
+	free(buf);
+
+	return err;
+}
+
+int golioth_lightdb_set_batch(struct golioth_client *client,
+			      const struct golioth_lightdb_set_item *items, size_t num_items)
+{
+	size_t payload_len;
+	uint8_t *buf;
+	int err;
+
+	err = batch_set_prepare(items, num_items, &buf, &payload_len);
+	if (err) {
+		return err;
+	}
+
+	err = golioth_coap_req_sync(client, COAP_METHOD_POST, PATHV(LIGHTDB_PATH, buf),
+				    GOLIOTH_CONTENT_FORMAT_APP_CBOR,
+				    &buf[strlen(buf) + 1], payload_len,
+				    NULL, NULL,
+				    GOLIOTH_COAP_REQ_NO_RESP_BODY);
+
+	free(buf);
+
+	return err;
+}
+
+struct batch_get_item {
+	const char *key;
+	golioth_req_cb_t cb;
+	void *user_data;
+	bool done;
+};
+
+struct batch_get {
+	/* Received CBOR map of common parent */
+	uint8_t *data;
+	size_t len;
+
+	/* Error of synchronous request, which is not returned by golioth_coap_req_sync() */
+	int err;
+
+	size_t num_items;
+	struct batch_get_item items[];
+};
+
+static void batch_get_item_done(struct batch_get_item *item, const uint8_t *data, size_t len,
+				int err)
+{
+	struct golioth_req_rsp rsp = {
+		.data = data,
+		.len = len,
+		.total = len,
+		.user_data = item->user_data,
+		.err = err,
+	};
+
+	item->done = true;
+
+	if (item->cb) {
+		(void)item->cb(&rsp);
+	}
+}
+
+static int batch_get_decode(struct batch_get *ctx)
+{
+	ZCBOR_STATE_D(zsd, 2, ctx->data, ctx->len, 1);
+	struct zcbor_string key;
+	const uint8_t *value;
+	bool ok;
+
+	if (zcbor_nil_expect(zsd, NULL)) {
+		/* No value at parent path, so none of items exists */
+		return 0;
+	}
+
+	ok = zcbor_map_start_decode(zsd);
+	if (!ok) {
+		LOG_WRN("Did not start CBOR map correctly");
+		return -EBADMSG;
+	}
+
+	while (!zcbor_list_or_map_end(zsd)) {
+		ok = zcbor_tstr_decode(zsd, &key);
+		if (!ok) {
+			LOG_WRN("Failed to get key");
+			return -EBADMSG;
+		}
+
+		value = zsd->payload;
+
+		ok = zcbor_any_skip(zsd, NULL);
+		if (!ok) {
+			LOG_WRN("Failed to skip value");
+			return -EBADMSG;
+		}
+
+		for (size_t i = 0; i < ctx->num_items; i++) {
+			struct batch_get_item *item = &ctx->items[i];
+
+			if (!item->done &&
+			    strlen(item->key) == key.len &&
+			    memcmp(item->key, key.value, key.len) == 0) {
+				batch_get_item_done(item, value, zsd->payload - value, 0);
+				break;
+			}
+		}
+	}
+
+	ok = zcbor_map_end_decode(zsd);
+	if (!ok) {
+		LOG_WRN("Failed to close CBOR map");
+		return -EBADMSG;
+	}
+
+	return 0;
+}
+
+/**
+ * @brief Invoke callbacks of all items, either with decoded value or with error
+ */
+static void batch_get_finish(struct batch_get *ctx, int err)
+{
+	if (!err) {
+		err = batch_get_decode(ctx);
+	}
+
+	for (size_t i = 0; i < ctx->num_items; i++) {
+		if (!ctx->items[i].done) {
+			batch_get_item_done(&ctx->items[i], NULL, 0, err ? err : -ENOENT);
+		}
+	}
+
+	free(ctx->data);
+	free(ctx);
+}
+
+static int batch_get_append(struct batch_get *ctx, const struct golioth_req_rsp *rsp)
+{
+	size_t len = rsp->off + rsp->len;
+	uint8_t *data;
+
+	if (len > BATCH_MAX_LEN) {
+		LOG_WRN("Batch response too long (%zu > %d)", len, BATCH_MAX_LEN);
+		return -ENOSPC;
+	}
+
+	if (len > ctx->len) {
+		data = realloc(ctx->data, len);
+		if (!data) {
+			return -ENOMEM;
+		}
+
+		ctx->data = data;
+	}
+
+	memcpy(&ctx->data[rsp->off], rsp->data, rsp->len);
+	ctx->len = len;
+
+	return 0;
+}
+
+static int batch_get_sync_cb(struct golioth_req_rsp *rsp)
+{
+	struct batch_get *ctx = rsp->user_data;
+
+	ctx->err = batch_get_append(ctx, rsp);
+
+	return ctx->err;
+}
+
+static int batch_get_async_cb(struct golioth_req_rsp *rsp)
+{
+	struct batch_get *ctx = rsp->user_data;
+	int err = rsp->err;
+
+	if (!err) {
+		err = batch_get_append(ctx, rsp);
+	}
+
+	if (!err && rsp->get_next) {
+		rsp->get_next(rsp->get_next_data, 0);
+		return 0;
+	}
+
+	batch_get_finish(ctx, err);
+
+	return err;
+}
+
+static int batch_get_alloc(const struct golioth_lightdb_get_item *items, size_t num_items,
+			   struct batch_get **ctx_ptr)
+{
+	struct batch_get *ctx;
+	size_t parent_len;
+	size_t keys_len = 0;
+	char *keys;
+	int err;
+
+	err = batch_parent_len(items, sizeof(*items), num_items, &parent_len);
+	if (err) {
+		return err;
+	}
+
+	for (size_t i = 0; i < num_items; i++) {
+		keys_len += strlen(path_key(items[i].path, parent_len)) + 1;
+	}
+
+	/* Parent path is stored right after keys */
+	ctx = calloc(1, sizeof(*ctx) + num_items * sizeof(ctx->items[0]) +
+		     keys_len + parent_len + 1);
+	if (!ctx) {
+		return -ENOMEM;
+	}
+
+	ctx->num_items = num_items;
+
+	keys = (char *)&ctx->items[num_items];
+
+	for (size_t i = 0; i < num_items; i++) {
+		const char *key = path_key(items[i].path, parent_len);
+		size_t key_len = strlen(key) + 1;
+
+		memcpy(keys, key, key_len);
+
+		ctx->items[i].key = keys;
+		ctx->items[i].cb = items[i].cb;
+		ctx->items[i].user_data = items[i].user_data;
+
+		keys += key_len;
+	}
+
+	memcpy(keys, items[0].path, parent_len);
+	keys[parent_len] = '\0';
+
+	*ctx_ptr = ctx;
+
+	return 0;
+}
+
+static inline const char *batch_get_parent(struct batch_get *ctx)
+{
+	const struct batch_get_item *last = &ctx->items[ctx->num_items - 1];
+
+	return last->key + strlen(last->key) + 1;
+}
+
+int golioth_lightdb_get_batch_cb(struct golioth_client *client,
+				 const struct golioth_lightdb_get_item *items, size_t num_items)
+{
+	struct batch_get *ctx;
+	int err;
+
+	err = batch_get_alloc(items, num_items, &ctx);
+	if (err) {
+		return err;
+	}
+
+	err = golioth_coap_req_cb(client, COAP_METHOD_GET,
+				  PATHV(LIGHTDB_PATH, batch_get_parent(ctx)),
+				  GOLIOTH_CONTENT_FORMAT_APP_CBOR,
+				  NULL, 0,
+				  batch_get_async_cb, ctx,
+				  0);
+	if (err) {
+		free(ctx);
+	}
+
+	return err;
+}
+
+int golioth_lightdb_get_batch(struct golioth_client *client,
+			      const struct golioth_lightdb_get_item *items, size_t num_items)
+{
+	struct batch_get *ctx;
+	int err;
+
+	err = batch_get_alloc(items, num_items, &ctx);
+	if (err) {
+		return err;
+	}
+
+	err = golioth_coap_req_sync(client, COAP_METHOD_GET,
+				    PATHV(LIGHTDB_PATH, batch_get_parent(ctx)),
+				    GOLIOTH_CONTENT_FORMAT_APP_CBOR,
+				    NULL, 0,
+				    batch_get_sync_cb, ctx,
+				    0);
+	if (!err) {
+		err = ctx->err;
+	}
+
+	batch_get_finish(ctx, err);
+
+	return err;
+}
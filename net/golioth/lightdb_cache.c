@@ -0,0 +1,414 @@
+/*
+ * Copyright (c) 2023 Golioth, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "coap_req.h"
+#include "golioth_utils.h"
+#include "lightdb_cache.h"
+
+#include <zephyr/logging/log.h>
+LOG_MODULE_DECLARE(lightdb, CONFIG_GOLIOTH_LOG_LEVEL);
+
+#define CACHE_MAX_VALUE_LEN	CONFIG_GOLIOTH_LIGHTDB_CACHE_MAX_VALUE_LEN
+
+BUILD_ASSERT(sizeof(((struct golioth_lightdb_cache_entry *)0)->etag) ==
+	     GOLIOTH_COAP_ETAG_MAX_LEN);
+
+/**
+ * @brief State of single LightDB request going through cache
+ */
+struct cache_req {
+	struct golioth_client *client;
+	enum golioth_content_format format;
+	bool observe;
+	bool allocated;
+
+	golioth_req_cb_t cb;
+	void *user_data;
+
+	/* ETag of cached value (when sending request) or of staged value (when receiving) */
+	uint8_t etag[GOLIOTH_COAP_ETAG_MAX_LEN];
+	size_t etag_len;
+
+	/*
+	 * Received value is staged in a buffer prefixed with NULL-terminated path, so that it can
+	 * be handed over to cache entry without copying.
+	 */
+	uint8_t *staging;
+	size_t staging_cap;
+	size_t staging_len;
+	bool uncacheable;
+
+	/* Error of synchronous request, which is not returned by golioth_coap_req_sync() */
+	int err;
+
+	size_t path_len;
+	const uint8_t *path;
+	uint8_t path_buf[];
+};
+
+void golioth_lightdb_cache_init(struct golioth_client *client)
+{
+	k_mutex_init(&client->lightdb_cache.lock);
+}
+
+static struct golioth_lightdb_cache_entry *cache_entry_find(struct golioth_lightdb_cache *cache,
+							   const uint8_t *path,
+							   enum golioth_content_format format)
+{
+	for (size_t i = 0; i < ARRAY_SIZE(cache->entries); i++) {
+		struct golioth_lightdb_cache_entry *entry = &cache->entries[i];
+
+		if (entry->path && entry->format == format && strcmp(entry->path, path) == 0) {
+			return entry;
+		}
+	}
+
+	return NULL;
+}
+
+static void cache_entry_free(struct golioth_lightdb_cache_entry *entry)
+{
+	free(entry->path);
+	memset(entry, 0, sizeof(*entry));
+}
+
+static struct golioth_lightdb_cache_entry *cache_entry_evict(struct golioth_lightdb_cache *cache)
+{
+	struct golioth_lightdb_cache_entry *lru = &cache->entries[0];
+
+	for (size_t i = 0; i < ARRAY_SIZE(cache->entries); i++) {
+		struct golioth_lightdb_cache_entry *entry = &cache->entries[i];
+
+		if (!entry->path) {
+			return entry;
+		}
+
+		if (entry->last_used < lru->last_used) {
+			lru = entry;
+		}
+	}
+
+	LOG_DBG("Evicting %s from cache", lru->path);
+
+	cache_entry_free(lru);
+
+	return lru;
+}
+
+static void cache_req_etag_load(struct cache_req *ctx)
+{
+	struct golioth_lightdb_cache *cache = &ctx->client->lightdb_cache;
+	struct golioth_lightdb_cache_entry *entry;
+
+	k_mutex_lock(&cache->lock, K_FOREVER);
+
+	entry = cache_entry_find(cache, ctx->path, ctx->format);
+	if (entry) {
+		memcpy(ctx->etag, entry->etag, entry->etag_len);
+		ctx->etag_len = entry->etag_len;
+	}
+
+	k_mutex_unlock(&cache->lock);
+}
+
+static void cache_req_unstage(struct cache_req *ctx)
+{
+	free(ctx->staging);
+	ctx->staging = NULL;
+	ctx->staging_cap = 0;
+	ctx->staging_len = 0;
+}
+
+static void cache_req_release(struct cache_req *ctx)
+{
+	cache_req_unstage(ctx);
+
+	if (ctx->allocated) {
+		free(ctx);
+	}
+}
+
+static void cache_req_stage(struct cache_req *ctx, const struct golioth_req_rsp *rsp)
+{
+	size_t needed = MAX(rsp->total, rsp->off + rsp->len);
+	uint8_t *staging;
+
+	if (rsp->off == 0) {
+		/* Beginning of new value (e.g. next observe notification) */
+		cache_req_unstage(ctx);
+		ctx->uncacheable = false;
+	}
+
+	if (ctx->uncacheable) {
+		return;
+	}
+
+	if (rsp->etag_len == 0 || rsp->etag_len > sizeof(ctx->etag) ||
+	    needed > CACHE_MAX_VALUE_LEN) {
+		goto uncacheable;
+	}
+
+	if (needed > ctx->staging_cap) {
+		staging = realloc(ctx->staging, ctx->path_len + needed);
+		if (!staging) {
+			LOG_WRN("Failed to allocate %zu bytes for cached value", needed);
+			goto uncacheable;
+		}
+
+		if (!ctx->staging) {
+			memcpy(staging, ctx->path, ctx->path_len);
+		}
+
+		ctx->staging = staging;
+		ctx->staging_cap = needed;
+	}
+
+	memcpy(&ctx->staging[ctx->path_len + rsp->off], rsp->data, rsp->len);
+	ctx->staging_len = rsp->off + rsp->len;
+
+	memcpy(ctx->etag, rsp->etag, rsp->etag_len);
+	ctx->etag_len = rsp->etag_len;
+
+	return;
+
+uncacheable:
+	cache_req_unstage(ctx);
+	ctx->uncacheable = true;
+}
+
+static void cache_req_commit(struct cache_req *ctx)
+{
+	struct golioth_lightdb_cache *cache = &ctx->client->lightdb_cache;
+	struct golioth_lightdb_cache_entry *entry;
+
+	if (!ctx->staging) {
+		return;
+	}
+
+	k_mutex_lock(&cache->lock, K_FOREVER);
+
+	entry = cache_entry_find(cache, ctx->path, ctx->format);
+	if (entry) {
+		cache_entry_free(entry);
+	} else {
+		entry = cache_entry_evict(cache);
+	}
+
+	entry->path = ctx->staging;
+	entry->value = &ctx->staging[ctx->path_len];
+	entry->value_len = ctx->staging_len;
+	entry->format = ctx->format;
+	memcpy(entry->etag, ctx->etag, ctx->etag_len);
+	entry->etag_len = ctx->etag_len;
+	entry->last_used = k_uptime_get();
+
+	k_mutex_unlock(&cache->lock);
+
+	/* Ownership was passed to cache entry */
+	ctx->staging = NULL;
+	ctx->staging_cap = 0;
+	ctx->staging_len = 0;
+}
+
+static int cache_req_serve_cached(struct cache_req *ctx, struct golioth_req_rsp *rsp)
+{
+	struct golioth_lightdb_cache *cache = &ctx->client->lightdb_cache;
+	struct golioth_lightdb_cache_entry *entry;
+	uint8_t *value = NULL;
+	size_t value_len = 0;
+	int err = 0;
+
+	k_mutex_lock(&cache->lock, K_FOREVER);
+
+	entry = cache_entry_find(cache, ctx->path, ctx->format);
+	if (entry && rsp->etag_len &&
+	    (rsp->etag_len != entry->etag_len ||
+	     memcmp(rsp->etag, entry->etag, entry->etag_len) != 0)) {
+		/* Validated representation is different than the one cached right now */
+		entry = NULL;
+	}
+
+	if (!entry) {
+		LOG_WRN("Cached value of %s was evicted", ctx->path);
+		err = -ENODATA;
+	} else {
+		/*
+		 * Copy value, so that callback is invoked without cache lock held. Otherwise
+		 * callback making another LightDB request (or just taking long) would block all
+		 * other users of cache.
+		 */
+		value = malloc(MAX(entry->value_len, 1));
+		if (value) {
+			memcpy(value, entry->value, entry->value_len);
+			value_len = entry->value_len;
+			memcpy(ctx->etag, entry->etag, entry->etag_len);
+			ctx->etag_len = entry->etag_len;
+			entry->last_used = k_uptime_get();
+		} else {
+			LOG_WRN("Failed to allocate %zu bytes for cached value", entry->value_len);
+			err = -ENOMEM;
+		}
+	}
+
+	k_mutex_unlock(&cache->lock);
+
+	if (err) {
+		/* Synchronous callers get error as return value instead */
+		if (ctx->allocated) {
+			rsp->err = err;
+			(void)ctx->cb(rsp);
+		} else {
+			ctx->err = err;
+		}
+
+		return err;
+	}
+
+	LOG_DBG("Serving %s from cache", ctx->path);
+
+	rsp->data = value;
+	rsp->len = value_len;
+	rsp->off = 0;
+	rsp->total = value_len;
+	rsp->etag = ctx->etag;
+	rsp->etag_len = ctx->etag_len;
+
+	err = ctx->cb(rsp);
+
+	free(value);
+
+	return err;
+}
+
+static int cache_req_rsp_cb(struct golioth_req_rsp *rsp)
+{
+	struct cache_req *ctx = rsp->user_data;
+	bool last;
+	int err;
+
+	rsp->user_data = ctx->user_data;
+
+	if (rsp->err) {
+		/* Request is freed right after reporting error, so there is no next block */
+		rsp->get_next = NULL;
+
+		err = ctx->cb(rsp);
+
+		cache_req_release(ctx);
+
+		return err;
+	}
+
+	last = (rsp->get_next == NULL);
+
+	if (rsp->valid) {
+		err = cache_req_serve_cached(ctx, rsp);
+	} else {
+		cache_req_stage(ctx, rsp);
+
+		err = ctx->cb(rsp);
+
+		if (last && !err) {
+			cache_req_commit(ctx);
+		}
+	}
+
+	/*
+	 * Request is freed after the last response (unless it is an observation) or after
+	 * non-zero value was returned in the middle of blockwise transfer.
+	 */
+	if ((last && !ctx->observe) || (!last && err)) {
+		cache_req_release(ctx);
+	}
+
+	return err;
+}
+
+int golioth_lightdb_cache_req_cb(struct golioth_client *client,
+				 const uint8_t **pathv, const uint8_t *path,
+				 enum golioth_content_format format,
+				 golioth_req_cb_t cb, void *user_data,
+				 int flags,
+				 const struct golioth_req_opts *opts)
+{
+	struct golioth_coap_req_params params = {};
+	size_t path_len = strlen(path) + 1;
+	struct cache_req *ctx;
+	int err;
+
+	ctx = calloc(1, sizeof(*ctx) + path_len);
+	if (!ctx) {
+		return -ENOMEM;
+	}
+
+	memcpy(ctx->path_buf, path, path_len);
+
+	ctx->client = client;
+	ctx->format = format;
+	ctx->observe = (flags & GOLIOTH_COAP_REQ_OBSERVE);
+	ctx->allocated = true;
+	ctx->cb = (cb ? cb : golioth_req_rsp_default_handler);
+	ctx->user_data = user_data;
+	ctx->path = ctx->path_buf;
+	ctx->path_len = path_len;
+
+	cache_req_etag_load(ctx);
+
+	params.etag = ctx->etag;
+	params.etag_len = ctx->etag_len;
+	params.app_cb = cb;
+	params.app_user_data = user_data;
+	golioth_coap_req_params_from_opts(&params, opts);
+
+	err = golioth_coap_req_params_cb(client, COAP_METHOD_GET, pathv, format,
+					 NULL, 0,
+					 cache_req_rsp_cb, ctx,
+					 flags,
+					 &params);
+	if (err) {
+		free(ctx);
+	}
+
+	return err;
+}
+
+int golioth_lightdb_cache_req_sync(struct golioth_client *client,
+				   const uint8_t **pathv, const uint8_t *path,
+				   enum golioth_content_format format,
+				   golioth_req_cb_t cb, void *user_data,
+				   const struct golioth_req_opts *opts)
+{
+	struct cache_req ctx = {
+		.client = client,
+		.format = format,
+		.cb = cb,
+		.user_data = user_data,
+		.path = path,
+		.path_len = strlen(path) + 1,
+	};
+	struct golioth_coap_req_params params = {};
+	int err;
+
+	cache_req_etag_load(&ctx);
+
+	params.etag = ctx.etag;
+	params.etag_len = ctx.etag_len;
+	golioth_coap_req_params_from_opts(&params, opts);
+
+	err = golioth_coap_req_params_sync(client, COAP_METHOD_GET, pathv, format,
+					   NULL, 0,
+					   cache_req_rsp_cb, &ctx,
+					   0,
+					   &params);
+
+	/* Release value staged before error or cancellation */
+	cache_req_release(&ctx);
+
+	return err ? err : ctx.err;
+}
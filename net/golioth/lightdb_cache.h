@@ -0,0 +1,93 @@
+/*
+ * Copyright (c) 2023 Golioth, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef __NET_GOLIOTH_LIGHTDB_CACHE_H__
+#define __NET_GOLIOTH_LIGHTDB_CACHE_H__
+
+#include <net/golioth.h>
+
+#if defined(CONFIG_GOLIOTH_LIGHTDB_CACHE)
+
+/**
+ * @brief Initialize LightDB cache of client instance
+ *
+ * @param[inout] client Client instance
+ */
+void golioth_lightdb_cache_init(struct golioth_client *client);
+
+/**
+ * @brief Request (get or observe) LightDB value, validating cached copy with ETag
+ *
+ * Sends ETag of cached value (if any) along with GET request, stores received values with their
+ * ETags in cache and serves cached value to @p cb when server responds with 2.03 Valid.
+ *
+ * @param[in] client Client instance
+ * @param[in] pathv Array of CoAP path components
+ * @param[in] path LightDB path (key in cache)
+ * @param[in] format Requested format of payload
+ * @param[in] cb Callback executed on response received, timeout or error
+ * @param[in] user_data User data passed to @p cb
+ * @param[in] flags Flags (@sa golioth_coap_req_flags)
+ * @param[in] opts Request options (can be NULL)
+ *
+ * @retval 0 On success
+ * @retval <0 On failure
+ */
+int golioth_lightdb_cache_req_cb(struct golioth_client *client,
+				 const uint8_t **pathv, const uint8_t *path,
+				 enum golioth_content_format format,
+				 golioth_req_cb_t cb, void *user_data,
+				 int flags,
+				 const struct golioth_req_opts *opts);
+
+/**
+ * @brief Get LightDB value synchronously, validating cached copy with ETag
+ *
+ * Synchronous version of golioth_lightdb_cache_req_cb().
+ *
+ * @param[in] client Client instance
+ * @param[in] pathv Array of CoAP path components
+ * @param[in] path LightDB path (key in cache)
+ * @param[in] format Requested format of payload
+ * @param[in] cb Callback executed on response received
+ * @param[in] user_data User data passed to @p cb
+ * @param[in] opts Request options (can be NULL)
+ *
+ * @retval 0 On success
+ * @retval <0 On failure
+ */
+int golioth_lightdb_cache_req_sync(struct golioth_client *client,
+				   const uint8_t **pathv, const uint8_t *path,
+				   enum golioth_content_format format,
+				   golioth_req_cb_t cb, void *user_data,
+				   const struct golioth_req_opts *opts);
+
+#else
+
+static inline void golioth_lightdb_cache_init(struct golioth_client *client) {}
+
+static inline int golioth_lightdb_cache_req_cb(struct golioth_client *client,
+					       const uint8_t **pathv, const uint8_t *path,
+					       enum golioth_content_format format,
+					       golioth_req_cb_t cb, void *user_data,
+					       int flags,
+					       const struct golioth_req_opts *opts)
+{
+	return -ENOTSUP;
+}
+
+static inline int golioth_lightdb_cache_req_sync(struct golioth_client *client,
+						 const uint8_t **pathv, const uint8_t *path,
+						 enum golioth_content_format format,
+						 golioth_req_cb_t cb, void *user_data,
+						 const struct golioth_req_opts *opts)
+{
+	return -ENOTSUP;
+}
+
+#endif /* CONFIG_GOLIOTH_LIGHTDB_CACHE */
+
+#endif /* __NET_GOLIOTH_LIGHTDB_CACHE_H__ */
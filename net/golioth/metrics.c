@@ -0,0 +1,256 @@
+/*
+ * Copyright (c) 2023 Golioth, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <net/golioth.h>
+#include <net/golioth/metrics.h>
+#include <net/golioth/system_client.h>
+#include <zephyr/init.h>
+#include <zephyr/kernel.h>
+#include <zephyr/net/coap.h>
+#include <zephyr/shell/shell.h>
+
+#include "coap_utils.h"
+#include "golioth_metrics.h"
+
+#include <zephyr/logging/log.h>
+LOG_MODULE_DECLARE(golioth);
+
+static const uint32_t rtt_bounds_ms[] = GOLIOTH_METRICS_RTT_BUCKET_BOUNDS_MS;
+
+BUILD_ASSERT(ARRAY_SIZE(rtt_bounds_ms) + 1 == GOLIOTH_METRICS_RTT_BUCKETS,
+	     "RTT bucket bounds do not match number of buckets");
+
+void golioth_metrics_rsp(struct golioth_client *client, uint8_t code)
+{
+	enum golioth_metrics_rsp_class class;
+
+	switch (COAP_RESPONSE_CODE_CLASS(code)) {
+	case 2:
+		class = GOLIOTH_METRICS_RSP_SUCCESS;
+		break;
+	case 4:
+		class = GOLIOTH_METRICS_RSP_CLIENT_ERROR;
+		break;
+	case 5:
+		class = GOLIOTH_METRICS_RSP_SERVER_ERROR;
+		break;
+	default:
+		class = GOLIOTH_METRICS_RSP_OTHER;
+		break;
+	}
+
+	atomic_inc(&client->metrics.responses[class]);
+}
+
+void golioth_metrics_rtt(struct golioth_client *client, uint32_t rtt_ms)
+{
+	size_t i;
+
+	for (i = 0; i < ARRAY_SIZE(rtt_bounds_ms); i++) {
+		if (rtt_ms <= rtt_bounds_ms[i]) {
+			break;
+		}
+	}
+
+	atomic_inc(&client->metrics.rtt_hist[i]);
+}
+
+void golioth_metrics_log_dropped(struct golioth_client *client, uint32_t cnt)
+{
+	atomic_add(&client->metrics.log_drops, cnt);
+}
+
+void golioth_metrics_get(struct golioth_client *client, struct golioth_metrics *metrics)
+{
+	struct golioth_metrics_counters *c = &client->metrics;
+
+	metrics->reqs_sent = atomic_get(&c->reqs_sent);
+	metrics->retransmits = atomic_get(&c->retransmits);
+	metrics->timeouts = atomic_get(&c->timeouts);
+
+	for (size_t i = 0; i < GOLIOTH_METRICS_RSP_CLASSES; i++) {
+		metrics->responses[i] = atomic_get(&c->responses[i]);
+	}
+
+	for (size_t i = 0; i < GOLIOTH_METRICS_RTT_BUCKETS; i++) {
+		metrics->rtt_hist[i] = atomic_get(&c->rtt_hist[i]);
+	}
+
+	metrics->pending = atomic_get(&c->pending);
+	metrics->pending_max = atomic_get(&c->pending_max);
+	metrics->bytes_tx = atomic_get(&c->bytes_tx);
+	metrics->bytes_rx = atomic_get(&c->bytes_rx);
+	metrics->log_drops = atomic_get(&c->log_drops);
+	metrics->heap_used = atomic_get(&c->heap_used);
+	metrics->heap_used_max = atomic_get(&c->heap_used_max);
+
+	metrics->handshake.count = atomic_get(&c->handshakes);
+	metrics->handshake.failures = atomic_get(&c->handshake_failures);
+	metrics->handshake.last_ms = atomic_get(&c->handshake_last_ms);
+	metrics->handshake.max_ms = atomic_get(&c->handshake_max_ms);
+	metrics->handshake.total_ms = atomic_get(&c->handshake_total_ms);
+	metrics->reconnects = atomic_get(&c->reconnects);
+}
+
+void golioth_metrics_reset(struct golioth_client *client)
+{
+	struct golioth_metrics_counters *c = &client->metrics;
+
+	atomic_clear(&c->reqs_sent);
+	atomic_clear(&c->retransmits);
+	atomic_clear(&c->timeouts);
+
+	for (size_t i = 0; i < GOLIOTH_METRICS_RSP_CLASSES; i++) {
+		atomic_clear(&c->responses[i]);
+	}
+
+	for (size_t i = 0; i < GOLIOTH_METRICS_RTT_BUCKETS; i++) {
+		atomic_clear(&c->rtt_hist[i]);
+	}
+
+	atomic_set(&c->pending_max, atomic_get(&c->pending));
+	atomic_clear(&c->bytes_tx);
+	atomic_clear(&c->bytes_rx);
+	atomic_clear(&c->reconnects);
+	atomic_clear(&c->handshakes);
+	atomic_clear(&c->handshake_failures);
+	atomic_clear(&c->handshake_last_ms);
+	atomic_clear(&c->handshake_max_ms);
+	atomic_clear(&c->handshake_total_ms);
+	atomic_clear(&c->log_drops);
+	atomic_set(&c->heap_used_max, atomic_get(&c->heap_used));
+}
+
+#ifdef CONFIG_GOLIOTH_METRICS_REPORT
+
+int golioth_metrics_report(struct golioth_client *client)
+{
+	struct golioth_metrics m;
+	char buf[384];
+	int len;
+
+	golioth_metrics_get(client, &m);
+
+	len = snprintk(buf, sizeof(buf),
+		       "{\"sent\":%u,\"retx\":%u,\"timeouts\":%u,"
+		       "\"rsp\":[%u,%u,%u,%u],"
+		       "\"rtt\":[%u,%u,%u,%u,%u,%u,%u,%u],"
+		       "\"pending_max\":%u,\"tx\":%u,\"rx\":%u,\"reconnects\":%u,"
+		       "\"hs_last_ms\":%u,\"hs_max_ms\":%u,\"hs_fail\":%u,"
+		       "\"log_drops\":%u,\"heap_max\":%u}",
+		       m.reqs_sent, m.retransmits, m.timeouts,
+		       m.responses[0], m.responses[1], m.responses[2], m.responses[3],
+		       m.rtt_hist[0], m.rtt_hist[1], m.rtt_hist[2], m.rtt_hist[3],
+		       m.rtt_hist[4], m.rtt_hist[5], m.rtt_hist[6], m.rtt_hist[7],
+		       m.pending_max, m.bytes_tx, m.bytes_rx, m.reconnects,
+		       m.handshake.last_ms, m.handshake.max_ms, m.handshake.failures,
+		       m.log_drops, m.heap_used_max);
+	if (len < 0 || len >= sizeof(buf)) {
+		return -ENOMEM;
+	}
+
+	return golioth_stream_push_cb(client, CONFIG_GOLIOTH_METRICS_REPORT_PATH,
+				      GOLIOTH_CONTENT_FORMAT_APP_JSON,
+				      buf, len,
+				      NULL, NULL);
+}
+
+static void metrics_report_handler(struct k_work *work);
+
+static K_WORK_DELAYABLE_DEFINE(metrics_report_work, metrics_report_handler);
+
+/* Only the default system client instance is reported periodically */
+static void metrics_report_handler(struct k_work *work)
+{
+	struct golioth_client *client = GOLIOTH_SYSTEM_CLIENT_GET();
+	int err;
+
+	if (golioth_is_connected(client)) {
+		err = golioth_metrics_report(client);
+		if (err) {
+			LOG_WRN("Failed to report metrics: %d", err);
+		}
+	}
+
+	k_work_reschedule(&metrics_report_work,
+			  K_SECONDS(CONFIG_GOLIOTH_METRICS_REPORT_INTERVAL_SEC));
+}
+
+static int golioth_metrics_report_init(void)
+{
+	k_work_schedule(&metrics_report_work,
+			K_SECONDS(CONFIG_GOLIOTH_METRICS_REPORT_INTERVAL_SEC));
+
+	return 0;
+}
+
+SYS_INIT(golioth_metrics_report_init, APPLICATION, CONFIG_APPLICATION_INIT_PRIORITY);
+
+#else /* CONFIG_GOLIOTH_METRICS_REPORT */
+
+int golioth_metrics_report(struct golioth_client *client)
+{
+	return -ENOTSUP;
+}
+
+#endif /* CONFIG_GOLIOTH_METRICS_REPORT */
+
+#ifdef CONFIG_GOLIOTH_METRICS_SHELL
+
+static int cmd_metrics_show(const struct shell *sh, size_t argc, char **argv)
+{
+	struct golioth_metrics m;
+	uint32_t handshake_avg_ms;
+
+	golioth_metrics_get(GOLIOTH_SYSTEM_CLIENT_GET(), &m);
+
+	handshake_avg_ms = m.handshake.count ? m.handshake.total_ms / m.handshake.count : 0;
+
+	shell_print(sh, "requests:   sent %u, retransmits %u, timeouts %u",
+		    m.reqs_sent, m.retransmits, m.timeouts);
+	shell_print(sh, "responses:  2.xx %u, 4.xx %u, 5.xx %u, other %u",
+		    m.responses[GOLIOTH_METRICS_RSP_SUCCESS],
+		    m.responses[GOLIOTH_METRICS_RSP_CLIENT_ERROR],
+		    m.responses[GOLIOTH_METRICS_RSP_SERVER_ERROR],
+		    m.responses[GOLIOTH_METRICS_RSP_OTHER]);
+
+	for (size_t i = 0; i < GOLIOTH_METRICS_RTT_BUCKETS; i++) {
+		if (i < ARRAY_SIZE(rtt_bounds_ms)) {
+			shell_print(sh, "rtt <= %5u ms: %u", rtt_bounds_ms[i], m.rtt_hist[i]);
+		} else {
+			shell_print(sh, "rtt >  %5u ms: %u", rtt_bounds_ms[i - 1], m.rtt_hist[i]);
+		}
+	}
+
+	shell_print(sh, "pending:    %u (max %u)", m.pending, m.pending_max);
+	shell_print(sh, "bytes:      tx %u, rx %u", m.bytes_tx, m.bytes_rx);
+	shell_print(sh, "reconnects: %u", m.reconnects);
+	shell_print(sh, "handshakes: %u (failed %u), last %u ms, avg %u ms, max %u ms",
+		    m.handshake.count, m.handshake.failures, m.handshake.last_ms,
+		    handshake_avg_ms, m.handshake.max_ms);
+	shell_print(sh, "log drops:  %u", m.log_drops);
+	shell_print(sh, "heap:       %u B (max %u B)", m.heap_used, m.heap_used_max);
+
+	return 0;
+}
+
+static int cmd_metrics_reset(const struct shell *sh, size_t argc, char **argv)
+{
+	golioth_metrics_reset(GOLIOTH_SYSTEM_CLIENT_GET());
+
+	return 0;
+}
+
+SHELL_STATIC_SUBCMD_SET_CREATE(
+	golioth_metrics_commands,
+	SHELL_CMD_ARG(show, NULL, "Show metrics of system client", cmd_metrics_show, 1, 0),
+	SHELL_CMD_ARG(reset, NULL, "Reset metrics of system client", cmd_metrics_reset, 1, 0),
+	SHELL_SUBCMD_SET_END
+);
+
+SHELL_CMD_REGISTER(golioth_metrics, &golioth_metrics_commands, "Golioth client metrics", NULL);
+
+#endif /* CONFIG_GOLIOTH_METRICS_SHELL */
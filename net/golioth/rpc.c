@@ -43,11 +43,17 @@ LOG_MODULE_DECLARE(golioth);
 static int send_response(struct golioth_client *client,
 			 uint8_t *coap_payload, size_t coap_payload_len)
 {
-	return golioth_coap_req_cb(client, COAP_METHOD_POST, PATHV(GOLIOTH_RPC_STATUS_PATH),
-				   GOLIOTH_CONTENT_FORMAT_APP_CBOR,
-				   coap_payload, coap_payload_len,
-				   golioth_req_rsp_default_handler, "RPC response ACK",
-				   GOLIOTH_COAP_REQ_NO_RESP_BODY);
+	struct golioth_coap_req_params params = {
+		.priority = GOLIOTH_REQ_PRIORITY_CONTROL,
+	};
+
+	return golioth_coap_req_params_cb(client, COAP_METHOD_POST,
+					  PATHV(GOLIOTH_RPC_STATUS_PATH),
+					  GOLIOTH_CONTENT_FORMAT_APP_CBOR,
+					  coap_payload, coap_payload_len,
+					  golioth_req_rsp_default_handler, "RPC response ACK",
+					  GOLIOTH_COAP_REQ_NO_RESP_BODY,
+					  &params);
 }
 
 static int params_decode(zcbor_state_t *zsd, void *value)
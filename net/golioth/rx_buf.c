@@ -0,0 +1,101 @@
+/*
+ * Copyright (c) 2023 Golioth, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <net/golioth.h>
+#include <zephyr/init.h>
+#include <zephyr/kernel.h>
+
+#include "rx_buf.h"
+
+#include <zephyr/logging/log.h>
+LOG_MODULE_DECLARE(golioth);
+
+#define RX_BUF_SIZE	CONFIG_GOLIOTH_RX_BUF_POOL_BLOCK_SIZE
+#define RX_BUF_COUNT	CONFIG_GOLIOTH_RX_BUF_POOL_COUNT
+
+static uint8_t __aligned(4) rx_bufs[RX_BUF_COUNT][RX_BUF_SIZE];
+static struct k_mem_slab rx_buf_slab;
+
+static bool is_pool_buf(const uint8_t *buf)
+{
+	return (buf >= &rx_bufs[0][0] && buf < &rx_bufs[RX_BUF_COUNT][0]);
+}
+
+uint8_t *golioth_rx_buf_claim(struct golioth_client *client, const uint8_t *data)
+{
+	uint8_t *claimed = NULL;
+	uint8_t *next;
+	int err;
+
+	if (data < client->rx_buffer || data >= &client->rx_buffer[client->rx_buffer_len]) {
+		/* Not received data (e.g. value served from cache) */
+		return NULL;
+	}
+
+	golioth_lock(client);
+
+	if (client->rx_buffer_next) {
+		/* Already claimed */
+		goto unlock;
+	}
+
+	next = client->rx_buffer_spare;
+	client->rx_buffer_spare = NULL;
+
+	if (!next) {
+		if (client->rx_buffer_len > RX_BUF_SIZE) {
+			LOG_WRN("RX buffer pool block too small (%zu < %zu)",
+				(size_t)RX_BUF_SIZE, client->rx_buffer_len);
+			goto unlock;
+		}
+
+		err = k_mem_slab_alloc(&rx_buf_slab, (void **)&next, K_NO_WAIT);
+		if (err) {
+			LOG_DBG("No free RX buffer: %d", err);
+			goto unlock;
+		}
+	}
+
+	client->rx_buffer_next = next;
+	claimed = client->rx_buffer;
+
+unlock:
+	golioth_unlock(client);
+
+	return claimed;
+}
+
+void golioth_rx_buf_release(struct golioth_client *client, uint8_t *buf)
+{
+	if (is_pool_buf(buf)) {
+		k_mem_slab_free(&rx_buf_slab, buf);
+		return;
+	}
+
+	/* Buffer provided by client owner, keep it for next claim */
+	golioth_lock(client);
+	client->rx_buffer_spare = buf;
+	golioth_unlock(client);
+}
+
+void golioth_rx_buf_swap(struct golioth_client *client)
+{
+	golioth_lock(client);
+
+	if (client->rx_buffer_next) {
+		client->rx_buffer = client->rx_buffer_next;
+		client->rx_buffer_next = NULL;
+	}
+
+	golioth_unlock(client);
+}
+
+static int golioth_rx_buf_init(void)
+{
+	return k_mem_slab_init(&rx_buf_slab, rx_bufs, RX_BUF_SIZE, RX_BUF_COUNT);
+}
+
+SYS_INIT(golioth_rx_buf_init, POST_KERNEL, CONFIG_KERNEL_INIT_PRIORITY_DEFAULT);
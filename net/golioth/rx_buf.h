@@ -0,0 +1,31 @@
+/*
+ * Copyright (c) 2023 Golioth, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef __NET_GOLIOTH_RX_BUF_H__
+#define __NET_GOLIOTH_RX_BUF_H__
+
+#include <net/golioth.h>
+
+#if defined(CONFIG_GOLIOTH_RX_BUF_POOL)
+
+/**
+ * @brief Replace RX buffer of client, if it was claimed during processing of received data
+ *
+ * Must be called after received datagram was processed and before next recv().
+ *
+ * @param[inout] client Client instance
+ */
+void golioth_rx_buf_swap(struct golioth_client *client);
+
+#else /* CONFIG_GOLIOTH_RX_BUF_POOL */
+
+static inline void golioth_rx_buf_swap(struct golioth_client *client)
+{
+}
+
+#endif /* CONFIG_GOLIOTH_RX_BUF_POOL */
+
+#endif /* __NET_GOLIOTH_RX_BUF_H__ */
@@ -60,11 +60,17 @@ static int send_coap_response(struct golioth_client *client,
 			      uint8_t *coap_payload,
 			      size_t coap_payload_len)
 {
-	return golioth_coap_req_cb(client, COAP_METHOD_POST, PATHV(GOLIOTH_SETTINGS_STATUS_PATH),
-				   GOLIOTH_CONTENT_FORMAT_APP_CBOR,
-				   coap_payload, coap_payload_len,
-				   golioth_req_rsp_default_handler, "Settings response ACK",
-				   GOLIOTH_COAP_REQ_NO_RESP_BODY);
+	struct golioth_coap_req_params params = {
+		.priority = GOLIOTH_REQ_PRIORITY_CONTROL,
+	};
+
+	return golioth_coap_req_params_cb(client, COAP_METHOD_POST,
+					  PATHV(GOLIOTH_SETTINGS_STATUS_PATH),
+					  GOLIOTH_CONTENT_FORMAT_APP_CBOR,
+					  coap_payload, coap_payload_len,
+					  golioth_req_rsp_default_handler, "Settings response ACK",
+					  GOLIOTH_COAP_REQ_NO_RESP_BODY,
+					  &params);
 }
 
 static void response_init(struct settings_response *response, struct golioth_client *client)
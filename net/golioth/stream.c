@@ -15,25 +15,53 @@ LOG_MODULE_REGISTER(stream, CONFIG_GOLIOTH_LOG_LEVEL);
 
 #define STREAM_PATH		".s"
 
+int golioth_stream_push_cb_opts(struct golioth_client *client, const uint8_t *path,
+				enum golioth_content_format format,
+				const uint8_t *data, size_t data_len,
+				golioth_req_cb_t cb, void *user_data,
+				const struct golioth_req_opts *opts)
+{
+	struct golioth_coap_req_params params = {};
+
+	golioth_coap_req_params_from_opts(&params, opts);
+
+	return golioth_coap_req_params_cb(client, COAP_METHOD_POST,
+					  PATHV(STREAM_PATH, path), format,
+					  data, data_len,
+					  cb, user_data,
+					  GOLIOTH_COAP_REQ_NO_RESP_BODY,
+					  &params);
+}
+
 int golioth_stream_push_cb(struct golioth_client *client, const uint8_t *path,
 			   enum golioth_content_format format,
 			   const uint8_t *data, size_t data_len,
 			   golioth_req_cb_t cb, void *user_data)
 {
-	return golioth_coap_req_cb(client, COAP_METHOD_POST,
-				   PATHV(STREAM_PATH, path), format,
-				   data, data_len,
-				   cb, user_data,
-				   GOLIOTH_COAP_REQ_NO_RESP_BODY);
+	return golioth_stream_push_cb_opts(client, path, format, data, data_len, cb, user_data,
+					   NULL);
+}
+
+int golioth_stream_push_opts(struct golioth_client *client, const uint8_t *path,
+			     enum golioth_content_format format,
+			     const uint8_t *data, size_t data_len,
+			     const struct golioth_req_opts *opts)
+{
+	struct golioth_coap_req_params params = {};
+
+	golioth_coap_req_params_from_opts(&params, opts);
+
+	return golioth_coap_req_params_sync(client, COAP_METHOD_POST,
+					    PATHV(STREAM_PATH, path), format,
+					    data, data_len,
+					    NULL, NULL,
+					    GOLIOTH_COAP_REQ_NO_RESP_BODY,
+					    &params);
 }
 
 int golioth_stream_push(struct golioth_client *client, const uint8_t *path,
 			enum golioth_content_format format,
 			const uint8_t *data, size_t data_len)
 {
-	return golioth_coap_req_sync(client, COAP_METHOD_POST,
-				     PATHV(STREAM_PATH, path), format,
-				     data, data_len,
-				     NULL, NULL,
-				     GOLIOTH_COAP_REQ_NO_RESP_BODY);
+	return golioth_stream_push_opts(client, path, format, data, data_len, NULL);
 }
@@ -0,0 +1,131 @@
+/*
+ * Copyright (c) 2023 Golioth, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <net/golioth.h>
+#include <zcbor_encode.h>
+
+#include <zephyr/logging/log.h>
+LOG_MODULE_DECLARE(stream, CONFIG_GOLIOTH_LOG_LEVEL);
+
+void golioth_stream_cbor_reset(struct golioth_stream_cbor *ctx)
+{
+	zcbor_new_encode_state(ctx->zse, ARRAY_SIZE(ctx->zse),
+			       ctx->buf, ctx->buf_len, 1);
+
+	/*
+	 * Number of fields is not known upfront. Map header is finalized (or terminated, in case of
+	 * indefinite length encoding) in golioth_stream_cbor_finish().
+	 */
+	zcbor_map_start_encode(ctx->zse, SIZE_MAX);
+}
+
+void golioth_stream_cbor_init(struct golioth_stream_cbor *ctx,
+			      struct golioth_client *client, const uint8_t *path,
+			      uint8_t *buf, size_t buf_len)
+{
+	ctx->client = client;
+	ctx->path = path;
+	ctx->buf = buf;
+	ctx->buf_len = buf_len;
+
+	golioth_stream_cbor_reset(ctx);
+}
+
+int golioth_stream_cbor_add_int(struct golioth_stream_cbor *ctx,
+				const char *name, int64_t value)
+{
+	bool ok;
+
+	ok = zcbor_tstr_put_term(ctx->zse, name) &&
+	     zcbor_int64_put(ctx->zse, value);
+	if (!ok) {
+		LOG_WRN("Failed to encode '%s'", name);
+		return -ENOMEM;
+	}
+
+	return 0;
+}
+
+int golioth_stream_cbor_add_float(struct golioth_stream_cbor *ctx,
+				  const char *name, float value)
+{
+	bool ok;
+
+	ok = zcbor_tstr_put_term(ctx->zse, name) &&
+	     zcbor_float32_put(ctx->zse, value);
+	if (!ok) {
+		LOG_WRN("Failed to encode '%s'", name);
+		return -ENOMEM;
+	}
+
+	return 0;
+}
+
+int golioth_stream_cbor_add_bool(struct golioth_stream_cbor *ctx,
+				 const char *name, bool value)
+{
+	bool ok;
+
+	ok = zcbor_tstr_put_term(ctx->zse, name) &&
+	     zcbor_bool_put(ctx->zse, value);
+	if (!ok) {
+		LOG_WRN("Failed to encode '%s'", name);
+		return -ENOMEM;
+	}
+
+	return 0;
+}
+
+static int golioth_stream_cbor_finish(struct golioth_stream_cbor *ctx, size_t *len)
+{
+	bool ok;
+
+	ok = zcbor_map_end_encode(ctx->zse, SIZE_MAX);
+	if (!ok) {
+		LOG_WRN("Did not end CBOR map correctly");
+		return -ENOMEM;
+	}
+
+	*len = ctx->zse->payload - ctx->buf;
+
+	return 0;
+}
+
+int golioth_stream_cbor_push_cb(struct golioth_stream_cbor *ctx,
+				golioth_req_cb_t cb, void *user_data)
+{
+	size_t len;
+	int err;
+
+	err = golioth_stream_cbor_finish(ctx, &len);
+	if (!err) {
+		err = golioth_stream_push_cb(ctx->client, ctx->path,
+					     GOLIOTH_CONTENT_FORMAT_APP_CBOR,
+					     ctx->buf, len,
+					     cb, user_data);
+	}
+
+	golioth_stream_cbor_reset(ctx);
+
+	return err;
+}
+
+int golioth_stream_cbor_push(struct golioth_stream_cbor *ctx)
+{
+	size_t len;
+	int err;
+
+	err = golioth_stream_cbor_finish(ctx, &len);
+	if (!err) {
+		err = golioth_stream_push(ctx->client, ctx->path,
+					  GOLIOTH_CONTENT_FORMAT_APP_CBOR,
+					  ctx->buf, len);
+	}
+
+	golioth_stream_cbor_reset(ctx);
+
+	return err;
+}
@@ -8,21 +8,22 @@
 LOG_MODULE_REGISTER(golioth_system, CONFIG_GOLIOTH_SYSTEM_CLIENT_LOG_LEVEL);
 
 #include <errno.h>
+#include <string.h>
 #include <logging/golioth.h>
 #include <net/golioth/system_client.h>
 #include <net/golioth/rpc.h>
 #include <zephyr/net/socket.h>
 #include <zephyr/net/tls_credentials.h>
 #include <zephyr/posix/sys/eventfd.h>
+#include <zephyr/random/random.h>
 #include <zephyr/sys/atomic.h>
 #include <zephyr/sys/util.h>
 
+#include "golioth_metrics.h"
 #include "ot_dns.h"
 
 #define RX_BUFFER_SIZE		CONFIG_GOLIOTH_SYSTEM_CLIENT_RX_BUF_SIZE
 
-static char golioth_system_server_host[40] = CONFIG_GOLIOTH_SYSTEM_SERVER_HOST;
-
 static const uint8_t tls_ca_crt[] = {
 #if defined(CONFIG_GOLIOTH_SYSTEM_CLIENT_CA_PATH)
 #include "golioth-systemclient-ca.inc"
@@ -31,6 +32,28 @@ static const uint8_t tls_ca_crt[] = {
 
 #define PING_INTERVAL		(CONFIG_GOLIOTH_SYSTEM_CLIENT_PING_INTERVAL_SEC * 1000)
 #define RECV_TIMEOUT		(CONFIG_GOLIOTH_SYSTEM_CLIENT_RX_TIMEOUT_SEC * 1000)
+#define RECONNECT_DELAY_MIN	CONFIG_GOLIOTH_SYSTEM_CLIENT_RECONNECT_DELAY_MIN_MS
+#define RECONNECT_DELAY_MAX	(CONFIG_GOLIOTH_SYSTEM_CLIENT_RECONNECT_DELAY_MAX_SEC * 1000)
+#define RECONNECT_JITTER_MIN	(RECONNECT_DELAY_MIN / 2)
+
+#if defined(CONFIG_GOLIOTH_USE_CONNECTION_ID)
+#define CID_PROBE_TIMEOUT	(CONFIG_GOLIOTH_SYSTEM_CLIENT_CID_PROBE_TIMEOUT_SEC * 1000)
+#else
+#define CID_PROBE_TIMEOUT	0
+#endif
+
+/* Time given to server to respond after keepalive interval expires */
+#define KEEPALIVE_SLACK		MAX(RECV_TIMEOUT - PING_INTERVAL, PING_INTERVAL)
+
+#if defined(CONFIG_GOLIOTH_SYSTEM_CLIENT_ADAPTIVE_KEEPALIVE)
+#define KEEPALIVE_MAX		(CONFIG_GOLIOTH_SYSTEM_CLIENT_KEEPALIVE_MAX_SEC * 1000)
+#define KEEPALIVE_STEP		(CONFIG_GOLIOTH_SYSTEM_CLIENT_KEEPALIVE_STEP_SEC * 1000)
+#define KEEPALIVE_REPROBE	CONFIG_GOLIOTH_SYSTEM_CLIENT_KEEPALIVE_REPROBE_COUNT
+#else
+#define KEEPALIVE_MAX		PING_INTERVAL
+#define KEEPALIVE_STEP		0
+#define KEEPALIVE_REPROBE	0
+#endif
 
 enum pollfd_type {
 	POLLFD_EVENT,
@@ -38,41 +61,39 @@ enum pollfd_type {
 	NUM_POLLFDS,
 };
 
-/* Golioth instance */
-struct golioth_client _golioth_system_client;
+BUILD_ASSERT(ARRAY_SIZE(((struct golioth_system_client *)0)->fds) == NUM_POLLFDS);
 
-static uint8_t rx_buffer[RX_BUFFER_SIZE];
+/* Default Golioth instance */
+struct golioth_system_client _golioth_system_client;
 
-static struct zsock_pollfd fds[NUM_POLLFDS];
+static uint8_t rx_buffer[RX_BUFFER_SIZE];
 
-static sec_tag_t sec_tag_list[] = {
-	CONFIG_GOLIOTH_SYSTEM_CLIENT_CREDENTIALS_TAG,
-};
+static K_THREAD_STACK_DEFINE(system_client_stack, CONFIG_GOLIOTH_SYSTEM_CLIENT_STACK_SIZE);
+static struct k_thread system_client_thread;
 
 enum {
+	FLAG_STARTED,
 	FLAG_RECONNECT,
 	FLAG_STOP_CLIENT,
+	FLAG_RESET_BACKOFF,
+	FLAG_NETWORK_CHANGED,
 };
 
-static atomic_t flags;
-
-static inline void client_notify_timeout(void)
+static inline struct golioth_system_client *to_system_client(struct golioth_client *client)
 {
-	eventfd_write(fds[POLLFD_EVENT].fd, 1);
+	return CONTAINER_OF(client, struct golioth_system_client, client);
 }
 
-static void golioth_system_client_wakeup(struct golioth_client *client)
+static inline void system_client_notify(struct golioth_system_client *sc)
 {
-	eventfd_write(fds[POLLFD_EVENT].fd, 1);
+	eventfd_write(sc->fds[POLLFD_EVENT].fd, 1);
 }
 
-static void eventfd_timeout_handle(struct k_work *work)
+static void golioth_system_client_wakeup(struct golioth_client *client)
 {
-	client_notify_timeout();
+	system_client_notify(to_system_client(client));
 }
 
-static K_WORK_DELAYABLE_DEFINE(eventfd_timeout, eventfd_timeout_handle);
-
 static bool contains_char(const uint8_t *str, size_t str_len, uint8_t c)
 {
 	for (const uint8_t *p = str; p < &str[str_len]; p++) {
@@ -94,14 +115,14 @@ static bool golioth_psk_is_valid(const uint8_t *psk, size_t psk_len)
 	return (psk_len > 0);
 }
 
-static int golioth_check_psk_credentials(void)
+static int golioth_check_psk_credentials(sec_tag_t sec_tag)
 {
 	int err = 0;
 	uint8_t credential[MAX(CONFIG_GOLIOTH_SYSTEM_CLIENT_PSK_MAX_LEN,
 			       CONFIG_GOLIOTH_SYSTEM_CLIENT_PSK_ID_MAX_LEN)];
 	size_t cred_len = CONFIG_GOLIOTH_SYSTEM_CLIENT_PSK_ID_MAX_LEN;
 
-	err = tls_credential_get(CONFIG_GOLIOTH_SYSTEM_CLIENT_CREDENTIALS_TAG,
+	err = tls_credential_get(sec_tag,
 				 TLS_CREDENTIAL_PSK_ID,
 				 credential, &cred_len);
 	if (err < 0) {
@@ -116,7 +137,7 @@ static int golioth_check_psk_credentials(void)
 	}
 
 	cred_len = CONFIG_GOLIOTH_SYSTEM_CLIENT_PSK_MAX_LEN;
-	err = tls_credential_get(CONFIG_GOLIOTH_SYSTEM_CLIENT_CREDENTIALS_TAG,
+	err = tls_credential_get(sec_tag,
 				 TLS_CREDENTIAL_PSK,
 				 credential, &cred_len);
 	if (err < 0) {
@@ -139,17 +160,17 @@ finish:
 	return err;
 }
 
-static int golioth_check_cert_credentials(void)
+static int golioth_check_cert_credentials(sec_tag_t sec_tag)
 {
 	size_t cred_len = 0;
-	int err = tls_credential_get(CONFIG_GOLIOTH_SYSTEM_CLIENT_CREDENTIALS_TAG,
+	int err = tls_credential_get(sec_tag,
 				     TLS_CREDENTIAL_SERVER_CERTIFICATE, NULL, &cred_len);
 	if (err == -ENOENT) {
 		LOG_WRN("Certificate authentication configured, but no client certificate found");
 		goto finish;
 	}
 
-	err = tls_credential_get(CONFIG_GOLIOTH_SYSTEM_CLIENT_CREDENTIALS_TAG,
+	err = tls_credential_get(sec_tag,
 				 TLS_CREDENTIAL_PRIVATE_KEY, NULL, &cred_len);
 	if (err == -ENOENT) {
 		LOG_WRN("Certificate authentication configured, but no private key found");
@@ -165,13 +186,17 @@ finish:
 	return err;
 }
 
-static int init_tls_auth_cert(void)
+/* Register CA certificate (if there is none yet) under secure tag of instance */
+static int init_tls_auth_cert(sec_tag_t sec_tag)
 {
 	int err;
 
-	err = tls_credential_add(CONFIG_GOLIOTH_SYSTEM_CLIENT_CREDENTIALS_TAG,
-				 TLS_CREDENTIAL_CA_CERTIFICATE,
+	err = tls_credential_add(sec_tag, TLS_CREDENTIAL_CA_CERTIFICATE,
 				 tls_ca_crt, ARRAY_SIZE(tls_ca_crt));
+	if (err == -EEXIST) {
+		/* Provisioned by application */
+		return 0;
+	}
 	if (err < 0) {
 		LOG_ERR("Failed to register CA cert: %d", err);
 		return err;
@@ -180,40 +205,82 @@ static int init_tls_auth_cert(void)
 	return 0;
 }
 
-static int init_tls(void)
-{
-	if (IS_ENABLED(CONFIG_GOLIOTH_AUTH_METHOD_CERT)) {
-		return init_tls_auth_cert();
-	}
+/* Number of additional instances with their own thread, for naming threads */
+static atomic_t num_threads;
 
-	return 0;
-}
+static void golioth_system_client_main(void *arg1, void *arg2, void *arg3);
 
-static int client_initialize(struct golioth_client *client)
+#if defined(CONFIG_GOLIOTH_SYSTEM_CLIENT_LOOP)
+static int system_client_loop_add(struct golioth_system_client_loop *loop,
+				  struct golioth_system_client *sc);
+#endif
+
+int golioth_system_client_init(struct golioth_system_client *sc,
+			       const struct golioth_system_client_config *config)
 {
+	struct golioth_client *client = &sc->client;
+	k_tid_t tid;
 	int err;
 
+	if (strlen(config->host) >= sizeof(sc->host)) {
+		LOG_ERR("Server host too long");
+		return -EINVAL;
+	}
+
+	if (!config->loop && (!config->thread || !config->stack)) {
+		LOG_ERR("No thread or stack for instance thread");
+		return -EINVAL;
+	}
+
 	golioth_init(client);
 
-	client->rx_buffer = rx_buffer;
-	client->rx_buffer_len = sizeof(rx_buffer);
+	client->rx_buffer = config->rx_buffer;
+	client->rx_buffer_len = config->rx_buffer_len;
 
 	client->wakeup = golioth_system_client_wakeup;
 
-	err = golioth_set_proto_coap_dtls(client, sec_tag_list,
-					  ARRAY_SIZE(sec_tag_list));
+	strcpy(sc->host, config->host);
+	sc->port = config->port;
+	sc->sec_tag_list[0] = config->sec_tag;
+	atomic_clear(&sc->flags);
+
+	sc->ping_interval = PING_INTERVAL;
+	sc->ping_interval_limit = KEEPALIVE_MAX;
+	sc->ping_interval_suspect = 0;
+	sc->ping_successes = 0;
+
+	if (IS_ENABLED(CONFIG_GOLIOTH_AUTH_METHOD_CERT)) {
+		err = init_tls_auth_cert(config->sec_tag);
+		if (err) {
+			return err;
+		}
+	}
+
+	err = golioth_set_proto_coap_dtls(client, sc->sec_tag_list,
+					  ARRAY_SIZE(sc->sec_tag_list));
 	if (err) {
 		LOG_ERR("Failed to set protocol: %d", err);
 		return err;
 	}
 
-	fds[POLLFD_EVENT].fd = eventfd(0, EFD_NONBLOCK);
-	fds[POLLFD_EVENT].events = ZSOCK_POLLIN;
-
-	if (IS_ENABLED(CONFIG_LOG_BACKEND_GOLIOTH)) {
-		log_backend_golioth_init(client);
+#if defined(CONFIG_GOLIOTH_SYSTEM_CLIENT_LOOP)
+	if (config->loop) {
+		/* Wakeups are signalled to the shared loop */
+		sc->fds[POLLFD_EVENT].fd = config->loop->fds[0].fd;
+	} else
+#endif
+	{
+		sc->fds[POLLFD_EVENT].fd = eventfd(0, EFD_NONBLOCK);
+	}
+	sc->fds[POLLFD_EVENT].events = ZSOCK_POLLIN;
+	if (sc->fds[POLLFD_EVENT].fd < 0) {
+		LOG_ERR("Failed to create eventfd: %d", errno);
+		return -errno;
 	}
 
+	sc->fds[POLLFD_SOCKET].fd = -1;
+	sc->fds[POLLFD_SOCKET].events = ZSOCK_POLLIN;
+
 	if (IS_ENABLED(CONFIG_GOLIOTH_RPC)) {
 		err = golioth_rpc_init(client);
 		if (err) {
@@ -222,23 +289,57 @@ static int client_initialize(struct golioth_client *client)
 		}
 	}
 
+#if defined(CONFIG_GOLIOTH_SYSTEM_CLIENT_LOOP)
+	if (config->loop) {
+		return system_client_loop_add(config->loop, sc);
+	}
+#endif
+
+	tid = k_thread_create(config->thread, config->stack, config->stack_size,
+			      golioth_system_client_main, sc, NULL, NULL,
+			      config->priority, 0, K_NO_WAIT);
+
+	if (sc == &_golioth_system_client) {
+		k_thread_name_set(tid, "golioth_system");
+	} else {
+		char name[sizeof("golioth_system_") + 10];
+
+		/* Additional instances are numbered from 1 */
+		snprintk(name, sizeof(name), "golioth_system_%d",
+			 (int)atomic_inc(&num_threads) + 1);
+		k_thread_name_set(tid, name);
+	}
+
 	return 0;
 }
 
 static int golioth_system_init(void)
 {
-	struct golioth_client *client = GOLIOTH_SYSTEM_CLIENT_GET();
+	struct golioth_system_client *sc = &_golioth_system_client;
+	const struct golioth_system_client_config config = {
+		.host = CONFIG_GOLIOTH_SYSTEM_SERVER_HOST,
+		.port = CONFIG_GOLIOTH_SYSTEM_SERVER_PORT,
+		.sec_tag = CONFIG_GOLIOTH_SYSTEM_CLIENT_CREDENTIALS_TAG,
+		.rx_buffer = rx_buffer,
+		.rx_buffer_len = sizeof(rx_buffer),
+		.thread = &system_client_thread,
+		.stack = system_client_stack,
+		.stack_size = K_THREAD_STACK_SIZEOF(system_client_stack),
+		.priority = CONFIG_GOLIOTH_SYSTEM_CLIENT_THREAD_PRIORITY,
+	};
 	int err;
 
 	LOG_INF("Initializing");
 
-	err = client_initialize(client);
+	err = golioth_system_client_init(sc, &config);
 	if (err) {
 		LOG_ERR("Failed to initialize client: %d", err);
 		return err;
 	}
 
-	init_tls();
+	if (IS_ENABLED(CONFIG_LOG_BACKEND_GOLIOTH)) {
+		log_backend_golioth_init(&sc->client);
+	}
 
 	return 0;
 }
@@ -246,13 +347,188 @@ static int golioth_system_init(void)
 SYS_INIT(golioth_system_init, APPLICATION,
 	 CONFIG_GOLIOTH_SYSTEM_CLIENT_INIT_PRIORITY);
 
-static int client_connect(struct golioth_client *client)
+/*
+ * Keepalive
+ *
+ * Ping is sent only after 'ping_interval' of silence, as any received data already proves that
+ * connection is alive. With adaptive keepalive the interval starts at PING_INTERVAL and is
+ * increased by KEEPALIVE_STEP each time ping response proves that connection (including NAT
+ * binding) survived the whole interval.
+ *
+ * On receive timeout the interval is decreased and the failed value is remembered as suspect.
+ * It is blamed (and the limit is lowered below it) only when the next connection receives data,
+ * i.e. when the server was reachable right after the timeout. Failed connection attempt or
+ * another receive timeout without any received data means that server or network is down, so
+ * the suspect is dropped. After KEEPALIVE_REPROBE successful pings at the limit, it is raised by
+ * KEEPALIVE_STEP again, so that conditions which improved over time are detected.
+ */
+
+static void keepalive_reset(struct golioth_system_client *sc, int64_t now)
+{
+	sc->ping_pending = false;
+	sc->cid_probe = false;
+	sc->ping_expiry = now + sc->ping_interval;
+	sc->recv_expiry = sc->ping_expiry + KEEPALIVE_SLACK;
+}
+
+static void keepalive_connected(struct golioth_system_client *sc, int64_t now)
+{
+	sc->rx_seen = false;
+
+	keepalive_reset(sc, now);
+}
+
+static void keepalive_connect_failed(struct golioth_system_client *sc)
+{
+	if (sc->ping_interval_suspect) {
+		LOG_DBG("Server unreachable, keepalive interval not blamed");
+		sc->ping_interval_suspect = 0;
+	}
+}
+
+static void keepalive_adapt(struct golioth_system_client *sc)
+{
+	if (sc->ping_interval_suspect) {
+		/* Server is reachable, so previous connection was lost on the path (e.g. NAT) */
+		sc->ping_interval_limit = MAX(sc->ping_interval_suspect - KEEPALIVE_STEP,
+					      PING_INTERVAL);
+		sc->ping_interval = MIN(sc->ping_interval, sc->ping_interval_limit);
+		sc->ping_interval_suspect = 0;
+		sc->ping_successes = 0;
+
+		LOG_INF("Keepalive interval limited to %d ms", (int)sc->ping_interval_limit);
+		return;
+	}
+
+	if (!sc->ping_pending) {
+		return;
+	}
+
+	if (sc->ping_interval < sc->ping_interval_limit) {
+		sc->ping_interval = MIN(sc->ping_interval + KEEPALIVE_STEP,
+					sc->ping_interval_limit);
+		LOG_DBG("Keepalive interval increased to %d ms", (int)sc->ping_interval);
+	} else if (sc->ping_interval_limit < KEEPALIVE_MAX &&
+		   ++sc->ping_successes >= KEEPALIVE_REPROBE) {
+		sc->ping_interval_limit = MIN(sc->ping_interval_limit + KEEPALIVE_STEP,
+					      KEEPALIVE_MAX);
+		sc->ping_successes = 0;
+
+		LOG_DBG("Keepalive interval limit raised to %d ms", (int)sc->ping_interval_limit);
+	}
+}
+
+static void keepalive_rx(struct golioth_system_client *sc, int64_t now)
 {
+	/* Response to Connection ID probe says nothing about keepalive interval */
+	if (IS_ENABLED(CONFIG_GOLIOTH_SYSTEM_CLIENT_ADAPTIVE_KEEPALIVE) && !sc->cid_probe) {
+		keepalive_adapt(sc);
+	}
+
+	sc->rx_seen = true;
+
+	keepalive_reset(sc, now);
+}
+
+static void keepalive_ping(struct golioth_system_client *sc, int64_t now)
+{
+	LOG_DBG("Sending PING");
+	(void)golioth_ping(&sc->client);
+
+	sc->ping_pending = true;
+
+	/* Retry with minimal interval until response is received or receive timeout expires */
+	sc->ping_expiry = now + PING_INTERVAL;
+}
+
+static void keepalive_timeout(struct golioth_system_client *sc)
+{
+	if (!IS_ENABLED(CONFIG_GOLIOTH_SYSTEM_CLIENT_ADAPTIVE_KEEPALIVE)) {
+		return;
+	}
+
+	if (!sc->rx_seen) {
+		/* Nothing received since connecting, so server (or network) is down */
+		keepalive_connect_failed(sc);
+		return;
+	}
+
+	if (sc->ping_interval <= PING_INTERVAL) {
+		return;
+	}
+
+	sc->ping_interval_suspect = sc->ping_interval;
+	sc->ping_interval = MAX(sc->ping_interval - KEEPALIVE_STEP, PING_INTERVAL);
+
+	LOG_INF("Keepalive interval reduced to %d ms", (int)sc->ping_interval);
+}
+
+/**
+ * @brief Calculate delay before next connection attempt
+ *
+ * Delay window grows exponentially with each failed attempt, starting at RECONNECT_DELAY_MIN and
+ * capped at RECONNECT_DELAY_MAX. With jitter enabled, actual delay is picked randomly from the
+ * whole window ("full jitter"), so that many devices do not reconnect in lockstep after an
+ * outage. Delay is never shorter than RECONNECT_JITTER_MIN, so that failing attempts are not
+ * repeated back to back.
+ */
+static int32_t reconnect_delay(struct golioth_system_client *sc)
+{
+	int32_t window = RECONNECT_DELAY_MIN;
+
+	for (uint32_t i = 0; i < sc->reconnect_attempts && window < RECONNECT_DELAY_MAX; i++) {
+		window *= 2;
+	}
+
+	window = MIN(window, RECONNECT_DELAY_MAX);
+
+	if (sc->reconnect_attempts < UINT16_MAX) {
+		sc->reconnect_attempts++;
+	}
+
+	if (IS_ENABLED(CONFIG_GOLIOTH_SYSTEM_CLIENT_RECONNECT_JITTER)) {
+		return RECONNECT_JITTER_MIN + sys_rand32_get() % (window - RECONNECT_JITTER_MIN + 1);
+	}
+
+	return window;
+}
+
+/**
+ * @brief Keep session using DTLS Connection ID after network change
+ *
+ * When server assigned Connection ID, DTLS session does not depend on device IP address and port,
+ * so it survives NAT rebinding or IP address change. In that case a ping is sent on existing
+ * session and full reconnect (with handshake) is done only if there is no response within
+ * CID_PROBE_TIMEOUT.
+ *
+ * @retval true Probe was started, connection should be kept
+ * @retval false Probe is not possible, client should reconnect
+ */
+static bool cid_probe_start(struct golioth_system_client *sc)
+{
+	if (!IS_ENABLED(CONFIG_GOLIOTH_USE_CONNECTION_ID) ||
+	    !golioth_connection_id_is_active(&sc->client)) {
+		return false;
+	}
+
+	LOG_INF("Probing session with Connection ID");
+
+	keepalive_ping(sc, k_uptime_get());
+
+	sc->cid_probe = true;
+	sc->recv_expiry = k_uptime_get() + CID_PROBE_TIMEOUT;
+
+	return true;
+}
+
+static int client_connect(struct golioth_system_client *sc)
+{
+	struct golioth_client *client = &sc->client;
 	int err = 0;
 
 #if defined(CONFIG_NET_L2_OPENTHREAD)
 
-	err = synthesize_ip6_address(golioth_system_server_host, golioth_system_server_host);
+	err = synthesize_ip6_address(sc->host, sc->host);
 	if (err) {
 		LOG_ERR("Failed to synthesize Golioth Server IPv6 address: %d", err);
 		return err;
@@ -260,188 +536,412 @@ static int client_connect(struct golioth_client *client)
 
 #endif
 
-	err = golioth_connect(client,
-			      golioth_system_server_host,
-			      CONFIG_GOLIOTH_SYSTEM_SERVER_PORT);
-
+	err = golioth_connect(client, sc->host, sc->port);
 	if (err) {
 		LOG_ERR("Failed to connect: %d", err);
 		return err;
 	}
 
-	fds[POLLFD_SOCKET].fd = client->sock;
-	fds[POLLFD_SOCKET].events = ZSOCK_POLLIN;
+	sc->fds[POLLFD_SOCKET].fd = client->sock;
 
 	return 0;
 }
 
-static void client_disconnect(struct golioth_client *client)
+static void client_disconnect(struct golioth_system_client *sc)
 {
-	struct k_work_sync sync;
+	(void)golioth_disconnect(&sc->client);
 
-	(void)golioth_disconnect(client);
-
-	k_work_cancel_delayable_sync(&eventfd_timeout, &sync);
+	sc->fds[POLLFD_SOCKET].fd = -1;
 }
 
-K_SEM_DEFINE(sys_client_started, 0, 1);
-static struct k_poll_event sys_client_poll_start =
-	K_POLL_EVENT_STATIC_INITIALIZER(K_POLL_TYPE_SEM_AVAILABLE,
-					K_POLL_MODE_NOTIFY_ONLY,
-					&sys_client_started, 0);
-
-static void wait_for_client_start(void)
+/**
+ * @brief Prepare system client instance for polling
+ *
+ * Connects (or reconnects) client when needed and calculates timeout of the next event.
+ *
+ * Socket file descriptor (sc->fds[POLLFD_SOCKET]) is set to -1 while not connected, so it is
+ * ignored by zsock_poll().
+ *
+ * @param[in] sc System client instance
+ * @param[in] now Current uptime in milliseconds
+ *
+ * @return Timeout in milliseconds (-1 for infinite) until next event of this instance
+ */
+static int system_client_poll_prepare(struct golioth_system_client *sc, int64_t now)
 {
-	k_poll(&sys_client_poll_start, 1, K_FOREVER);
-	sys_client_poll_start.state = K_POLL_STATE_NOT_READY;
+	struct golioth_client *client = &sc->client;
+	int64_t golioth_timeout;
+	int64_t timeout;
+	int err;
+
+	if (client->sock >= 0) {
+		/* Backoff reset requested while connected has nothing to reset */
+		atomic_clear_bit(&sc->flags, FLAG_RESET_BACKOFF);
+	} else {
+		/* New connection is established over current network anyway */
+		atomic_clear_bit(&sc->flags, FLAG_NETWORK_CHANGED);
+
+		if (atomic_test_and_clear_bit(&sc->flags, FLAG_STOP_CLIENT)) {
+			/* Stopped while disconnected, so observations are just suspended */
+			golioth_observe_cancel_all(client);
+			sc->connected_once = false;
+		}
+
+		if (!atomic_test_bit(&sc->flags, FLAG_STARTED)) {
+			LOG_DBG("Waiting for client to be started");
+			return -1;
+		}
+
+		if (atomic_test_and_clear_bit(&sc->flags, FLAG_RESET_BACKOFF)) {
+			LOG_DBG("Reconnect backoff reset");
+			sc->reconnect_attempts = 0;
+			sc->reconnect_expiry = 0;
+		}
+
+		if (now < sc->reconnect_expiry) {
+			return sc->reconnect_expiry - now;
+		}
+
+		/* Flush pending events */
+		atomic_clear_bit(&sc->flags, FLAG_RECONNECT);
+
+		LOG_INF("Starting connect");
+		err = client_connect(sc);
+		if (err) {
+			int32_t delay = reconnect_delay(sc);
+
+			LOG_WRN("Failed to connect: %d, retrying in %d ms", err, (int)delay);
+			keepalive_connect_failed(sc);
+			sc->reconnect_expiry = k_uptime_get() + delay;
+			return delay;
+		}
+
+		LOG_INF("Client connected!");
+
+		if (sc->connected_once) {
+			golioth_metrics_reconnect(client);
+		}
+
+		sc->connected_once = true;
+		sc->reconnect_attempts = 0;
+
+		now = k_uptime_get();
+		keepalive_connected(sc, now);
+	}
+
+	golioth_poll_prepare(client, now, NULL, &golioth_timeout);
+
+	timeout = MIN(sc->recv_expiry, sc->ping_expiry) - now;
+	timeout = MIN(timeout, golioth_timeout);
+
+	if (timeout < 0) {
+		timeout = 0;
+	}
+
+	LOG_DBG("Next timeout: %d", (int)timeout);
+
+	return timeout;
 }
 
-static void golioth_system_client_main(void *arg1, void *arg2, void *arg3)
+/**
+ * @brief Process events of system client instance after polling
+ *
+ * @param[in] sc System client instance
+ * @param[in] event_occurred Whether timeout expired or wakeup was requested
+ * @param[in] sock_revents Returned events of client socket
+ */
+static void system_client_poll_process(struct golioth_system_client *sc, bool event_occurred,
+				       short sock_revents)
 {
-	struct golioth_client *client = arg1;
-	bool event_occurred;
-	int timeout;
-	int64_t recv_expiry = 0;
-	int64_t ping_expiry = 0;
-	int64_t golioth_timeout;
-	eventfd_t eventfd_value;
+	struct golioth_client *client = &sc->client;
 	int err;
-	int ret;
 
-	while (true) {
-		if (client->sock < 0) {
-			LOG_DBG("Waiting for client to be started");
-			wait_for_client_start();
-
-			/* Flush pending events */
-			atomic_clear_bit(&flags, FLAG_RECONNECT);
-			(void)eventfd_read(fds[POLLFD_EVENT].fd, &eventfd_value);
-
-			LOG_INF("Starting connect");
-			err = client_connect(client);
-			if (err) {
-				LOG_WRN("Failed to connect: %d", err);
-				k_sleep(K_SECONDS(5));
-				continue;
-			}
+	if (client->sock < 0) {
+		/* Start request or reconnect delay expiry, handled when preparing next poll */
+		return;
+	}
 
-			LOG_INF("Client connected!");
+	if (event_occurred) {
+		bool reconnect_request = atomic_test_and_clear_bit(&sc->flags, FLAG_RECONNECT);
+		bool stop_request = atomic_test_and_clear_bit(&sc->flags, FLAG_STOP_CLIENT);
+		bool network_changed = atomic_test_and_clear_bit(&sc->flags, FLAG_NETWORK_CHANGED);
+		bool receive_timeout = (sc->recv_expiry <= k_uptime_get());
 
-			recv_expiry = k_uptime_get() + RECV_TIMEOUT;
-			ping_expiry = k_uptime_get() + PING_INTERVAL;
+		if (network_changed && !reconnect_request && !stop_request && !receive_timeout &&
+		    cid_probe_start(sc)) {
+			network_changed = false;
 		}
 
-		event_occurred = false;
+		/*
+		 * Reconnect and stop requests are handled similar to recv timeout.
+		 */
+		if (reconnect_request || receive_timeout || stop_request || network_changed) {
+			if (stop_request) {
+				LOG_INF("Stop request");
+			} else if (reconnect_request) {
+				LOG_INF("Reconnect per request");
+			} else if (network_changed) {
+				LOG_INF("Reconnect after network change");
+			} else if (sc->cid_probe) {
+				LOG_WRN("No response to Connection ID probe");
+			} else {
+				LOG_WRN("Receive timeout");
+				keepalive_timeout(sc);
+			}
 
-		golioth_poll_prepare(client, k_uptime_get(), NULL, &golioth_timeout);
+			client_disconnect(sc);
 
-		timeout = MIN(recv_expiry, ping_expiry) - k_uptime_get();
-		timeout = MIN(timeout, golioth_timeout);
+			if (stop_request) {
+				golioth_observe_cancel_all(client);
+				sc->connected_once = false;
+			}
+
+			return;
+		}
 
-		if (timeout < 0) {
-			timeout = 0;
+		if (sc->ping_expiry <= k_uptime_get()) {
+			keepalive_ping(sc, k_uptime_get());
 		}
+	}
 
-		LOG_DBG("Next timeout: %d", timeout);
+	if (sock_revents) {
+		keepalive_rx(sc, k_uptime_get());
 
-		k_work_reschedule(&eventfd_timeout, K_MSEC(timeout));
+		err = golioth_process_rx(client);
+		if (err) {
+			LOG_ERR("Failed to receive: %d", err);
+			client_disconnect(sc);
+		}
+	}
+}
+
+static void golioth_system_client_main(void *arg1, void *arg2, void *arg3)
+{
+	struct golioth_system_client *sc = arg1;
+	bool event_occurred;
+	eventfd_t eventfd_value;
+	int timeout;
+	int ret;
 
-		ret = zsock_poll(fds, ARRAY_SIZE(fds), -1);
+	while (true) {
+		timeout = system_client_poll_prepare(sc, k_uptime_get());
 
+		/*
+		 * Timeouts are handled by poll itself, so eventfd is used only for wakeups
+		 * requested by other threads (e.g. new request scheduled, reconnect, stop).
+		 */
+		ret = zsock_poll(sc->fds, ARRAY_SIZE(sc->fds), timeout);
 		if (ret < 0) {
 			LOG_ERR("Error in poll:%d", errno);
 			break;
 		}
 
+		event_occurred = false;
+
 		if (ret == 0) {
 			LOG_DBG("Timeout in poll");
 			event_occurred = true;
 		}
 
-		if (fds[POLLFD_EVENT].revents) {
-			(void)eventfd_read(fds[POLLFD_EVENT].fd,
-					   &eventfd_value);
+		if (sc->fds[POLLFD_EVENT].revents) {
+			(void)eventfd_read(sc->fds[POLLFD_EVENT].fd, &eventfd_value);
 			LOG_DBG("Event in eventfd");
 			event_occurred = true;
 		}
 
-		if (event_occurred) {
-			bool reconnect_request = atomic_test_and_clear_bit(&flags, FLAG_RECONNECT);
-			bool stop_request = atomic_test_and_clear_bit(&flags, FLAG_STOP_CLIENT);
-			bool receive_timeout = (recv_expiry <= k_uptime_get());
-
-			/*
-			 * Reconnect and stop requests are handled similar to recv timeout.
-			 */
-			if (reconnect_request || receive_timeout || stop_request) {
-				if (stop_request) {
-					LOG_INF("Stop request");
-				} else if (reconnect_request) {
-					LOG_INF("Reconnect per request");
-				} else {
-					LOG_WRN("Receive timeout");
-				}
+		system_client_poll_process(sc, event_occurred, sc->fds[POLLFD_SOCKET].revents);
+	}
+}
 
-				client_disconnect(client);
-				continue;
-			}
+#if defined(CONFIG_GOLIOTH_SYSTEM_CLIENT_LOOP)
 
-			if (ping_expiry <= k_uptime_get()) {
-				LOG_DBG("Sending PING");
-				(void)golioth_ping(client);
+static void golioth_system_client_loop_main(void *arg1, void *arg2, void *arg3)
+{
+	struct golioth_system_client_loop *loop = arg1;
+	struct golioth_system_client *sc;
+	eventfd_t eventfd_value;
+	bool wakeup;
+	int64_t now;
+	int timeout;
+	int num_clients;
+	int ret;
 
-				ping_expiry = k_uptime_get() + PING_INTERVAL;
+	while (true) {
+		k_mutex_lock(&loop->lock, K_FOREVER);
+		num_clients = loop->num_clients;
+		k_mutex_unlock(&loop->lock);
+
+		/*
+		 * Connecting (DNS resolution and DTLS handshake) is blocking, so all other clients
+		 * driven by this loop are stalled while one of them is being connected.
+		 */
+		timeout = -1;
+		for (int i = 0; i < num_clients; i++) {
+			int client_timeout;
+
+			sc = loop->clients[i];
+
+			client_timeout = system_client_poll_prepare(sc, k_uptime_get());
+			if (client_timeout < 0) {
+				loop->expiry[i] = INT64_MAX;
+			} else {
+				loop->expiry[i] = k_uptime_get() + client_timeout;
+				if (timeout < 0 || client_timeout < timeout) {
+					timeout = client_timeout;
+				}
 			}
+
+			loop->fds[1 + i].fd = sc->fds[POLLFD_SOCKET].fd;
+			loop->fds[1 + i].events = ZSOCK_POLLIN;
 		}
 
-		if (fds[POLLFD_SOCKET].revents) {
-			recv_expiry = k_uptime_get() + RECV_TIMEOUT;
-			ping_expiry = k_uptime_get() + PING_INTERVAL;
+		LOG_DBG("Next loop timeout: %d", timeout);
 
-			err = golioth_process_rx(client);
-			if (err) {
-				LOG_ERR("Failed to receive: %d", err);
-				client_disconnect(client);
-			}
+		ret = zsock_poll(loop->fds, 1 + num_clients, timeout);
+		if (ret < 0) {
+			LOG_ERR("Error in poll:%d", errno);
+			break;
+		}
+
+		wakeup = false;
+
+		if (loop->fds[0].revents) {
+			(void)eventfd_read(loop->fds[0].fd, &eventfd_value);
+			LOG_DBG("Event in eventfd");
+			wakeup = true;
+		}
+
+		now = k_uptime_get();
+
+		for (int i = 0; i < num_clients; i++) {
+			system_client_poll_process(loop->clients[i],
+						   wakeup || loop->expiry[i] <= now,
+						   loop->fds[1 + i].revents);
 		}
 	}
 }
 
-K_THREAD_DEFINE(golioth_system, CONFIG_GOLIOTH_SYSTEM_CLIENT_STACK_SIZE,
-		golioth_system_client_main,
-		GOLIOTH_SYSTEM_CLIENT_GET(), NULL, NULL,
-		CONFIG_GOLIOTH_SYSTEM_CLIENT_THREAD_PRIORITY, 0, 0);
+int golioth_system_client_loop_init(struct golioth_system_client_loop *loop,
+				    const struct golioth_system_client_loop_config *config)
+{
+	k_tid_t tid;
 
-void golioth_system_client_start(void)
+	k_mutex_init(&loop->lock);
+	loop->num_clients = 0;
+
+	loop->fds[0].fd = eventfd(0, EFD_NONBLOCK);
+	loop->fds[0].events = ZSOCK_POLLIN;
+	if (loop->fds[0].fd < 0) {
+		LOG_ERR("Failed to create eventfd: %d", errno);
+		return -errno;
+	}
+
+	tid = k_thread_create(&loop->thread, config->stack, config->stack_size,
+			      golioth_system_client_loop_main, loop, NULL, NULL,
+			      config->priority, 0, K_NO_WAIT);
+	k_thread_name_set(tid, "golioth_loop");
+
+	return 0;
+}
+
+static int system_client_loop_add(struct golioth_system_client_loop *loop,
+				  struct golioth_system_client *sc)
+{
+	int err = 0;
+
+	k_mutex_lock(&loop->lock, K_FOREVER);
+
+	if (loop->num_clients >= ARRAY_SIZE(loop->clients)) {
+		LOG_ERR("No space for more clients in loop");
+		err = -ENOMEM;
+		goto unlock;
+	}
+
+	loop->clients[loop->num_clients++] = sc;
+
+unlock:
+	k_mutex_unlock(&loop->lock);
+
+	if (!err) {
+		/* Make loop include new client in next iteration */
+		eventfd_write(loop->fds[0].fd, 1);
+	}
+
+	return err;
+}
+
+#endif /* CONFIG_GOLIOTH_SYSTEM_CLIENT_LOOP */
+
+void golioth_system_client_inst_start(struct golioth_system_client *sc)
 {
 	int err = 0;
+
 	if (IS_ENABLED(CONFIG_GOLIOTH_AUTH_METHOD_PSK)) {
-		err = golioth_check_psk_credentials();
+		err = golioth_check_psk_credentials(sc->sec_tag_list[0]);
 	} else if (IS_ENABLED(CONFIG_GOLIOTH_AUTH_METHOD_CERT)) {
-		err = golioth_check_cert_credentials();
+		err = golioth_check_cert_credentials(sc->sec_tag_list[0]);
 	}
 
 	if (err == 0) {
-		k_sem_give(&sys_client_started);
+		if (!atomic_test_and_set_bit(&sc->flags, FLAG_STARTED)) {
+			system_client_notify(sc);
+		}
 	} else {
 		LOG_WRN("Error loading TLS credentials, golioth system client was not started: %d",
 			err);
 	}
-
 }
 
-void golioth_system_client_stop(void)
+void golioth_system_client_inst_stop(struct golioth_system_client *sc)
 {
-	k_sem_take(&sys_client_started, K_NO_WAIT);
+	atomic_clear_bit(&sc->flags, FLAG_STARTED);
 
-	if (!atomic_test_and_set_bit(&flags, FLAG_STOP_CLIENT)) {
-		eventfd_write(fds[POLLFD_EVENT].fd, 1);
+	if (!atomic_test_and_set_bit(&sc->flags, FLAG_STOP_CLIENT)) {
+		system_client_notify(sc);
 	}
 }
 
-void golioth_system_client_request_reconnect(void)
+void golioth_system_client_inst_request_reconnect(struct golioth_system_client *sc)
 {
-	if (!atomic_test_and_set_bit(&flags, FLAG_RECONNECT)) {
-		eventfd_write(fds[POLLFD_EVENT].fd, 1);
+	if (!atomic_test_and_set_bit(&sc->flags, FLAG_RECONNECT)) {
+		system_client_notify(sc);
 	}
 }
+
+void golioth_system_client_inst_reset_backoff(struct golioth_system_client *sc)
+{
+	atomic_set_bit(&sc->flags, FLAG_RESET_BACKOFF);
+	system_client_notify(sc);
+}
+
+void golioth_system_client_inst_network_changed(struct golioth_system_client *sc)
+{
+	atomic_set_bit(&sc->flags, FLAG_RESET_BACKOFF);
+	atomic_set_bit(&sc->flags, FLAG_NETWORK_CHANGED);
+	system_client_notify(sc);
+}
+
+void golioth_system_client_start(void)
+{
+	golioth_system_client_inst_start(&_golioth_system_client);
+}
+
+void golioth_system_client_stop(void)
+{
+	golioth_system_client_inst_stop(&_golioth_system_client);
+}
+
+void golioth_system_client_request_reconnect(void)
+{
+	golioth_system_client_inst_request_reconnect(&_golioth_system_client);
+}
+
+void golioth_system_client_reset_backoff(void)
+{
+	golioth_system_client_inst_reset_backoff(&_golioth_system_client);
+}
+
+void golioth_system_client_network_changed(void)
+{
+	golioth_system_client_inst_network_changed(&_golioth_system_client);
+}
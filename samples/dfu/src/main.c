@@ -21,7 +21,7 @@ LOG_MODULE_REGISTER(golioth_dfu, LOG_LEVEL_DBG);
 
 K_SEM_DEFINE(sem_connected, 0, 1);
 K_SEM_DEFINE(sem_downloading, 0, 1);
-K_SEM_DEFINE(sem_downloaded, 0, 1);
+K_SEM_DEFINE(sem_block_written, 0, 1);
 
 #define REBOOT_DELAY_SEC	1
 
@@ -31,15 +31,35 @@ struct dfu_ctx {
 	struct flash_img_context flash;
 	char version[65];
 	bool downloading_started;
+	int err;
 };
 
+/*
+ * Firmware block passed from client thread to main thread, which writes it to flash. Received
+ * datagram is claimed with golioth_rx_buf_claim(), so client continues receiving next block while
+ * previous one is being written. When there is no free RX buffer, client thread waits until block
+ * is written (from the original datagram) instead.
+ */
+struct dfu_block {
+	uint8_t *buf;
+	const uint8_t *data;
+	size_t len;
+	bool last;
+};
+
+K_MSGQ_DEFINE(dfu_blocks, sizeof(struct dfu_block), CONFIG_GOLIOTH_RX_BUF_POOL_COUNT + 1, 4);
+
 static struct dfu_ctx update_ctx;
 static enum golioth_dfu_result dfu_initial_result = GOLIOTH_DFU_RESULT_INITIAL;
 
 static int data_received(struct golioth_req_rsp *rsp)
 {
 	struct dfu_ctx *dfu = rsp->user_data;
-	bool last = rsp->get_next == NULL;
+	struct dfu_block block = {
+		.data = rsp->data,
+		.len = rsp->len,
+		.last = rsp->get_next == NULL,
+	};
 	int err;
 
 	if (rsp->err) {
@@ -47,8 +67,12 @@ static int data_received(struct golioth_req_rsp *rsp)
 		return 0;
 	}
 
+	if (dfu->err) {
+		return dfu->err;
+	}
+
 	LOG_DBG("Received %zu bytes at offset %zu%s", rsp->len, rsp->off,
-		last ? " (last)" : "");
+		block.last ? " (last)" : "");
 
 	if (rsp->off == 0) {
 		err = flash_img_prepare(&dfu->flash);
@@ -57,14 +81,13 @@ static int data_received(struct golioth_req_rsp *rsp)
 		}
 	}
 
-	err = flash_img_buffered_write(&dfu->flash, rsp->data, rsp->len, last);
-	if (err) {
-		LOG_ERR("Failed to write to flash: %d", err);
-		return err;
-	}
+	block.buf = golioth_rx_buf_claim(client, rsp->data);
+
+	k_msgq_put(&dfu_blocks, &block, K_FOREVER);
 
-	if (last) {
-		k_sem_give(&sem_downloaded);
+	if (!block.buf) {
+		/* Payload is valid only until returning from this callback */
+		k_sem_take(&sem_block_written, K_FOREVER);
 	}
 
 	if (rsp->get_next) {
@@ -74,6 +97,30 @@ static int data_received(struct golioth_req_rsp *rsp)
 	return 0;
 }
 
+static int dfu_write_blocks(struct dfu_ctx *dfu)
+{
+	struct dfu_block block;
+	int err;
+
+	do {
+		k_msgq_get(&dfu_blocks, &block, K_FOREVER);
+
+		err = flash_img_buffered_write(&dfu->flash, block.data, block.len, block.last);
+		if (err) {
+			LOG_ERR("Failed to write to flash: %d", err);
+			dfu->err = err;
+		}
+
+		if (block.buf) {
+			golioth_rx_buf_release(client, block.buf);
+		} else {
+			k_sem_give(&sem_block_written);
+		}
+	} while (!block.last && !dfu->err);
+
+	return dfu->err;
+}
+
 static uint8_t *uri_strip_leading_slash(uint8_t *uri, size_t *uri_len)
 {
 	if (*uri_len > 0 && uri[0] == '/') {
@@ -209,7 +256,10 @@ int main(void)
 		LOG_ERR("Failed to update to '%s' state: %d", "downloading", err);
 	}
 
-	k_sem_take(&sem_downloaded, K_FOREVER);
+	err = dfu_write_blocks(&update_ctx);
+	if (err) {
+		return err;
+	}
 
 	err = golioth_fw_report_state(client, "main",
 				      current_version_str,
@@ -31,37 +31,31 @@ static int counter_handler(struct golioth_req_rsp *rsp)
 	return 0;
 }
 
-/*
- * In the `main` function, this function is registered to be
- * called when the device connects to the Golioth server.
- */
-static void golioth_on_connect(struct golioth_client *client)
+int main(void)
 {
 	int err;
 
+	LOG_DBG("Start LightDB observe sample");
+
+	net_connect();
+
 	/*
 	 * Observe the data stored at `/counter` in LightDB.
-	 * When that data is updated, the `on_update` callback
+	 * When that data is updated, the `counter_handler` callback
 	 * will be called.
 	 * This will get the value when first called, even if
 	 * the value doesn't change.
+	 *
+	 * Observation is registered once client connects and is
+	 * registered again automatically after each reconnect.
 	 */
 	err = golioth_lightdb_observe_cb(client, "counter",
 					 GOLIOTH_CONTENT_FORMAT_APP_JSON,
 					 counter_handler, NULL);
-
 	if (err) {
 		LOG_WRN("failed to observe lightdb path: %d", err);
 	}
-}
-
-int main(void)
-{
-	LOG_DBG("Start LightDB observe sample");
-
-	net_connect();
 
-	client->on_connect = golioth_on_connect;
 	golioth_system_client_start();
 
 	while (true) {
@@ -156,27 +156,24 @@ static int golioth_led_handle(struct golioth_req_rsp *rsp)
 	return 0;
 }
 
-static void golioth_on_connect(struct golioth_client *client)
+int main(void)
 {
 	int err;
 
+	LOG_DBG("Start LightDB LED sample");
+
+	net_connect();
+
+	golioth_led_initialize();
+
+	/* Observation is (re-)registered automatically after each connect */
 	err = golioth_lightdb_observe_cb(client, "led",
 					 GOLIOTH_CONTENT_FORMAT_APP_CBOR,
 					 golioth_led_handle, NULL);
 	if (err) {
 		LOG_WRN("failed to observe lightdb path: %d", err);
 	}
-}
-
-int main(void)
-{
-	LOG_DBG("Start LightDB LED sample");
-
-	net_connect();
-
-	golioth_led_initialize();
 
-	client->on_connect = golioth_on_connect;
 	golioth_system_client_start();
 
 	while (true) {
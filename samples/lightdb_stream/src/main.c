@@ -85,17 +85,21 @@ static int temperature_push_handler(struct golioth_req_rsp *rsp)
 	return 0;
 }
 
+static uint8_t sample_buf[32];
+static struct golioth_stream_cbor sample;
+
 static void temperature_push_async(const struct sensor_value *temp)
 {
-	char sbuf[sizeof("-4294967295.123456")];
 	int err;
 
-	snprintk(sbuf, sizeof(sbuf), "%d.%06d", temp->val1, abs(temp->val2));
+	err = golioth_stream_cbor_add_float(&sample, "temp", sensor_value_to_double(temp));
+	if (err) {
+		LOG_WRN("Failed to encode temperature: %d", err);
+		golioth_stream_cbor_reset(&sample);
+		return;
+	}
 
-	err = golioth_stream_push_cb(client, "temp",
-				     GOLIOTH_CONTENT_FORMAT_APP_JSON,
-				     sbuf, strlen(sbuf),
-				     temperature_push_handler, NULL);
+	err = golioth_stream_cbor_push_cb(&sample, temperature_push_handler, NULL);
 	if (err) {
 		LOG_WRN("Failed to push temperature: %d", err);
 		return;
@@ -104,14 +108,16 @@ static void temperature_push_async(const struct sensor_value *temp)
 
 static void temperature_push_sync(const struct sensor_value *temp)
 {
-	char sbuf[sizeof("-4294967295.123456")];
 	int err;
 
-	snprintk(sbuf, sizeof(sbuf), "%d.%06d", temp->val1, abs(temp->val2));
+	err = golioth_stream_cbor_add_float(&sample, "temp", sensor_value_to_double(temp));
+	if (err) {
+		LOG_WRN("Failed to encode temperature: %d", err);
+		golioth_stream_cbor_reset(&sample);
+		return;
+	}
 
-	err = golioth_stream_push(client, "temp",
-				  GOLIOTH_CONTENT_FORMAT_APP_JSON,
-				  sbuf, strlen(sbuf));
+	err = golioth_stream_cbor_push(&sample);
 	if (err) {
 		LOG_WRN("Failed to push temperature: %d", err);
 		return;
@@ -127,6 +133,9 @@ int main(void)
 
 	LOG_DBG("Start LightDB Stream sample");
 
+	/* Samples are pushed to root path, as {"temp": <value>} map */
+	golioth_stream_cbor_init(&sample, client, "", sample_buf, sizeof(sample_buf));
+
 	net_connect();
 
 	client->on_connect = golioth_on_connect;
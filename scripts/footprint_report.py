@@ -0,0 +1,506 @@
+#!/usr/bin/env python3
+#
+# Copyright (c) 2023 Golioth, Inc.
+#
+# SPDX-License-Identifier: Apache-2.0
+
+"""Memory footprint report of Golioth library per Kconfig feature set.
+
+Builds footprint application (tests/footprint) with west for each combination of features (RPC,
+Settings, firmware management, logging backend and system client) and reports:
+
+- flash and static RAM contributed by each object file of Golioth library (after linker garbage
+  collection, as listed in zephyr.map), together with totals of the whole image,
+- worst-case stack depth of system client thread entry and request callbacks, computed from call
+  graph with stack usage of each function (*.ci files generated with CONFIG_GOLIOTH_CALLGRAPH_INFO),
+- peak heap used by requests and measured stack usage of threads, when console output of standard
+  workload is available (see --run and --log).
+
+Stack depth is computed from static call graph. Indirect calls (e.g. request callbacks invoked by
+golioth_coap_req_call_cb() or socket operations dispatched through vtables) and calls to functions
+without call graph information (e.g. precompiled libraries) cannot be followed, so they are listed
+in the report and worst-case depth of the thread needs to be combined with depth of callbacks.
+"""
+
+import argparse
+import itertools
+import json
+import re
+import subprocess
+import sys
+from pathlib import Path
+
+from elftools.elf.constants import SH_FLAGS
+from elftools.elf.elffile import ELFFile
+
+
+GOLIOTH_BASE = Path(__file__).resolve().parents[1]
+
+FEATURES = {
+    'rpc': ['CONFIG_GOLIOTH_RPC'],
+    'settings': ['CONFIG_GOLIOTH_SETTINGS'],
+    'fw': ['CONFIG_GOLIOTH_FW'],
+    'log': ['CONFIG_LOG_BACKEND_GOLIOTH'],
+    'system_client': ['CONFIG_GOLIOTH_SYSTEM_CLIENT', 'CONFIG_GOLIOTH_SAMPLE_HARDCODED_CREDENTIALS'],
+}
+
+THREAD_ROOTS = ['golioth_system_client_main', 'golioth_system_client_loop_main']
+
+INDIRECT_CALL = '__indirect_call'
+
+
+def combination_name(combination):
+    return '+'.join(combination) if combination else 'minimal'
+
+
+def combinations(mode):
+    features = list(FEATURES)
+
+    if mode == 'all':
+        for n in range(len(features) + 1):
+            yield from itertools.combinations(features, n)
+        return
+
+    # Baseline, system client alone, each feature on top of system client and everything
+    yield ()
+    yield ('system_client',)
+    for feature in features:
+        if feature != 'system_client':
+            yield (feature, 'system_client')
+    yield tuple(features)
+
+
+def build(args, combination, build_dir):
+    cmd = ['west', 'build', '-b', args.board, '-d', str(build_dir), '-p', 'auto',
+           str(args.app), '--']
+
+    for feature, options in FEATURES.items():
+        value = 'y' if feature in combination else 'n'
+        cmd += [f'-D{option}={value}' for option in options]
+
+    cmd += args.cmake_args
+
+    print(f'Building {combination_name(combination)}: {" ".join(cmd)}', file=sys.stderr)
+    subprocess.run(cmd, check=True, stdout=None if args.verbose else subprocess.DEVNULL)
+
+
+def run(args, build_dir):
+    """Run workload on emulated board and store console output"""
+    log = build_dir / 'footprint.log'
+
+    try:
+        proc = subprocess.run(['west', 'build', '-d', str(build_dir), '-t', 'run'],
+                              capture_output=True, text=True, timeout=args.run_timeout)
+        output = proc.stdout
+    except subprocess.TimeoutExpired as e:
+        output = e.stdout.decode() if isinstance(e.stdout, bytes) else (e.stdout or '')
+
+    log.write_text(output)
+
+    return log
+
+
+def library_objects(build_dir):
+    """Paths of object files compiled from Golioth library sources"""
+    commands = json.loads((build_dir / 'compile_commands.json').read_text())
+    library_dirs = [GOLIOTH_BASE / 'net', GOLIOTH_BASE / 'logging']
+    objects = set()
+
+    for entry in commands:
+        source = (Path(entry['directory']) / entry['file']).resolve()
+        if not any(source.is_relative_to(d) for d in library_dirs):
+            continue
+
+        command = entry.get('arguments') or entry['command'].split()
+        if '-o' not in command:
+            continue
+
+        objects.add((Path(entry['directory']) / command[command.index('-o') + 1]).resolve())
+
+    return objects
+
+
+def archive_members(objects):
+    """(archive, member) pairs, under which objects show up in linker map file"""
+    members = set()
+
+    for obj in objects:
+        # CMake places objects of library target in CMakeFiles/<target>.dir/
+        target = next((part[:-len('.dir')] for part in obj.parts if part.endswith('.dir')), None)
+        members.add((f'lib{target}.a' if target else None, obj.name))
+
+    return members
+
+
+def output_sections(elf_path):
+    """Map output section name to (in flash, in RAM) tuple"""
+    sections = {}
+
+    with open(elf_path, 'rb') as f:
+        elf = ELFFile(f)
+
+        for section in elf.iter_sections():
+            flags = section['sh_flags']
+            if not flags & SH_FLAGS.SHF_ALLOC:
+                continue
+
+            if section['sh_type'] == 'SHT_NOBITS':
+                sections[section.name] = (False, True)
+            elif flags & SH_FLAGS.SHF_WRITE:
+                # Initialized data is copied from flash to RAM
+                sections[section.name] = (True, True)
+            else:
+                sections[section.name] = (True, False)
+
+    return sections
+
+
+MAP_OUTPUT_SECTION = re.compile(r'^(\S+)\s+0x([0-9a-f]+)\s+0x([0-9a-f]+)')
+MAP_INPUT_SECTION = re.compile(r'^ (\.\S+|COMMON)(?:\s+0x([0-9a-f]+)\s+0x([0-9a-f]+)\s+(\S.*))?$')
+MAP_INPUT_SECTION_CONT = re.compile(r'^\s+0x([0-9a-f]+)\s+0x([0-9a-f]+)\s+(\S.*)$')
+MAP_OBJECT = re.compile(r'\(([^()]+)\)$')
+
+
+def map_contributions(map_path):
+    """Yield (output section, object file, size) of each input section placed in image"""
+    output_section = None
+    pending_input = False
+    in_memory_map = False
+
+    with open(map_path) as f:
+        for line in f:
+            line = line.rstrip('\n')
+
+            if not in_memory_map:
+                in_memory_map = line.startswith('Linker script and memory map')
+                continue
+
+            if pending_input:
+                pending_input = False
+                m = MAP_INPUT_SECTION_CONT.match(line)
+                if m and output_section:
+                    yield output_section, m.group(3), int(m.group(2), 16)
+                    continue
+
+            m = MAP_OUTPUT_SECTION.match(line)
+            if m:
+                output_section = m.group(1)
+                continue
+
+            if re.match(r'^\S+$', line):
+                # Output section name, with address and size on next line
+                output_section = line
+                continue
+
+            m = MAP_INPUT_SECTION.match(line)
+            if m:
+                if m.group(2) is None:
+                    pending_input = True
+                elif output_section:
+                    yield output_section, m.group(4), int(m.group(3), 16)
+
+
+def object_member(path):
+    m = MAP_OBJECT.search(path)
+    if m:
+        return Path(path[:m.start()].strip()).name, m.group(1)
+
+    return None, Path(path.strip()).name
+
+
+def memory_report(build_dir, golioth_objects):
+    zephyr_dir = build_dir / 'zephyr'
+    sections = output_sections(zephyr_dir / 'zephyr.elf')
+    golioth_members = archive_members(golioth_objects)
+    objects = {}
+    image = {'flash': 0, 'ram': 0}
+
+    for output_section, path, size in map_contributions(zephyr_dir / 'zephyr.map'):
+        if size == 0 or output_section not in sections:
+            continue
+
+        in_flash, in_ram = sections[output_section]
+        archive, name = object_member(path)
+
+        image['flash'] += size if in_flash else 0
+        image['ram'] += size if in_ram else 0
+
+        if (archive, name) not in golioth_members:
+            continue
+
+        obj = objects.setdefault(name, {'flash': 0, 'ram': 0})
+        obj['flash'] += size if in_flash else 0
+        obj['ram'] += size if in_ram else 0
+
+    golioth = {
+        'flash': sum(o['flash'] for o in objects.values()),
+        'ram': sum(o['ram'] for o in objects.values()),
+    }
+
+    return {'objects': objects, 'golioth': golioth, 'image': image}
+
+
+CI_NODE = re.compile(r'node: \{ title: "([^"]+)" label: "([^"]*)"')
+CI_EDGE = re.compile(r'edge: \{ sourcename: "([^"]+)" targetname: "([^"]+)"')
+CI_STACK = re.compile(r'\\n(\d+) bytes \(([^)]+)\)')
+
+
+class CallGraph:
+    def __init__(self, build_dir):
+        # Function -> (stack usage, qualifier, object file), for functions with known stack usage
+        self.functions = {}
+        self.edges = {}
+        self.callers = {}
+        self._depth = {}
+
+        for ci in build_dir.glob('**/*.ci'):
+            self._parse(ci)
+
+    def _parse(self, path):
+        # GCC writes <object file without .obj>.ci
+        obj = path.with_suffix('.obj').resolve()
+
+        with open(path, errors='replace') as f:
+            for line in f:
+                m = CI_NODE.match(line)
+                if m:
+                    stack = CI_STACK.search(m.group(2))
+                    if stack:
+                        self.functions[m.group(1)] = (int(stack.group(1)), stack.group(2), obj)
+                    continue
+
+                m = CI_EDGE.match(line)
+                if m:
+                    self.edges.setdefault(m.group(1), []).append(m.group(2))
+                    self.callers.setdefault(m.group(2), set()).add(m.group(1))
+
+    @staticmethod
+    def name(function):
+        # Static functions are prefixed with source file name
+        return function.split(':')[-1]
+
+    def find(self, name):
+        return [f for f in self.functions if self.name(f) == name]
+
+    def entry_points(self, objects):
+        """Static functions without direct callers, i.e. thread entries and callbacks"""
+        for function, (_, _, obj) in self.functions.items():
+            if ':' in function and obj in objects and not self.callers.get(function):
+                yield function
+
+    def depth(self, function):
+        """Worst-case stack depth as (bytes, call chain, notes)"""
+        usage, chain, notes, _ = self._depth_of(function, ())
+        return usage, chain, notes
+
+    def _depth_of(self, function, visiting):
+        # Result computed with recursion cut off depends on the path from the root, so it is
+        # cached only if no cut-off happened within the whole subtree.
+        if function in self._depth:
+            return self._depth[function] + (False,)
+
+        if function == INDIRECT_CALL:
+            return 0, [], {'indirect calls'}, False
+
+        if function not in self.functions:
+            return 0, [], {f'unknown: {function}'}, False
+
+        if function in visiting:
+            return 0, [], {f'recursion: {self.name(function)}'}, True
+
+        usage, qualifier, _ = self.functions[function]
+        notes = set()
+        cut = False
+        if qualifier != 'static':
+            notes.add(f'{qualifier}: {self.name(function)}')
+
+        worst = (0, [])
+        for callee in self.edges.get(function, []):
+            callee_usage, chain, callee_notes, callee_cut = \
+                self._depth_of(callee, visiting + (function,))
+            notes |= callee_notes
+            cut |= callee_cut
+            if callee_usage > worst[0]:
+                worst = (callee_usage, chain)
+
+        result = (usage + worst[0], [self.name(function)] + worst[1], notes)
+        if not cut:
+            self._depth[function] = result
+
+        return result + (cut,)
+
+
+def stack_report(build_dir, golioth_objects):
+    graph = CallGraph(build_dir)
+    if not graph.functions:
+        return None
+
+    report = {'threads': {}, 'callbacks': {}}
+
+    for root in THREAD_ROOTS:
+        for function in graph.find(root):
+            usage, chain, notes = graph.depth(function)
+            report['threads'][root] = {'bytes': usage, 'chain': chain, 'notes': sorted(notes)}
+
+    for function in graph.entry_points(golioth_objects):
+        if graph.name(function) in THREAD_ROOTS:
+            continue
+
+        usage, chain, notes = graph.depth(function)
+        source, name = function.rsplit(':', 1)
+        report['callbacks'][f'{Path(source).name}:{name}'] = {'bytes': usage, 'chain': chain, 'notes': sorted(notes)}
+
+    return report
+
+
+LOG_HEAP = re.compile(r'footprint: heap max: (\d+) B')
+LOG_THREAD = re.compile(r'^\s*(\S+)\s*: STACK: unused (\d+) usage (\d+) / (\d+)')
+
+
+def runtime_report(log_path):
+    report = {'heap_max': None, 'threads': {}}
+
+    with open(log_path, errors='replace') as f:
+        for line in f:
+            m = LOG_HEAP.search(line)
+            if m:
+                report['heap_max'] = int(m.group(1))
+                continue
+
+            m = LOG_THREAD.match(line)
+            if m:
+                report['threads'][m.group(1)] = {'used': int(m.group(3)),
+                                                 'size': int(m.group(4))}
+
+    return report
+
+
+def kconfig_value(build_dir, option):
+    config = build_dir / 'zephyr' / '.config'
+    m = re.search(rf'^{option}=(.*)$', config.read_text(), re.MULTILINE)
+
+    return m.group(1).strip('"') if m else None
+
+
+def print_table(header, rows):
+    widths = [max(len(str(x)) for x in column) for column in zip(header, *rows)]
+
+    print('| ' + ' | '.join(str(h).ljust(w) for h, w in zip(header, widths)) + ' |')
+    print('|' + '|'.join('-' * (w + 2) for w in widths) + '|')
+    for row in rows:
+        print('| ' + ' | '.join(str(x).rjust(w) if isinstance(x, int) else str(x).ljust(w)
+                                for x, w in zip(row, widths)) + ' |')
+    print()
+
+
+def print_report(results):
+    print('# Golioth memory footprint\n')
+
+    rows = []
+    for name, result in results.items():
+        memory = result['memory']
+        stack = result.get('stack') or {}
+        thread = stack.get('threads', {}).get('golioth_system_client_main', {})
+        callbacks = [c['bytes'] for c in stack.get('callbacks', {}).values()]
+        runtime = result.get('runtime') or {}
+
+        rows.append([name,
+                     memory['golioth']['flash'], memory['golioth']['ram'],
+                     memory['image']['flash'], memory['image']['ram'],
+                     thread.get('bytes', '-'), max(callbacks, default='-'),
+                     result['stack_size'] or '-',
+                     runtime.get('heap_max') or '-'])
+
+    print_table(['features', 'golioth flash', 'golioth RAM', 'image flash', 'image RAM',
+                 'system client stack', 'max callback stack', 'configured stack',
+                 'heap max'], rows)
+
+    for name, result in results.items():
+        print(f'## {name}\n')
+
+        objects = result['memory']['objects']
+        print_table(['object', 'flash', 'RAM'],
+                    [[obj, v['flash'], v['ram']] for obj, v in sorted(objects.items())])
+
+        stack = result.get('stack')
+        if stack:
+            rows = []
+            for kind in ('threads', 'callbacks'):
+                for root, v in sorted(stack[kind].items(), key=lambda x: -x[1]['bytes']):
+                    rows.append([root, v['bytes'], ' > '.join(v['chain'][:6]),
+                                 ', '.join(n for n in v['notes'] if not n.startswith('unknown'))])
+            print_table(['function', 'worst-case stack', 'deepest chain', 'notes'], rows)
+
+        runtime = result.get('runtime')
+        if runtime:
+            print_table(['thread', 'used', 'size'],
+                        [[t, v['used'], v['size']] for t, v in sorted(runtime['threads'].items())])
+
+
+def parse_args():
+    parser = argparse.ArgumentParser(description=__doc__,
+                                     formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument('-b', '--board', default='qemu_x86',
+                        help='Board to build for (use target board for flash numbers)')
+    parser.add_argument('-d', '--build-dir', type=Path, default=Path('build-footprint'),
+                        help='Base directory for builds (one subdirectory per feature set)')
+    parser.add_argument('--app', type=Path, default=GOLIOTH_BASE / 'tests' / 'footprint',
+                        help='Application to build')
+    parser.add_argument('--combinations', choices=['common', 'all'], default='common',
+                        help="'common' builds baseline, system client alone, each feature on "
+                        "top of system client and all features; 'all' builds every combination")
+    parser.add_argument('--no-build', action='store_true',
+                        help='Report on existing builds only')
+    parser.add_argument('--run', action='store_true',
+                        help="Run workload with 'west build -t run' (emulated boards)")
+    parser.add_argument('--run-timeout', type=int, default=300)
+    parser.add_argument('--log', action='append', default=[], metavar='FEATURES=FILE',
+                        help='Console output of workload for given feature set, e.g. '
+                        'captured on hardware (can be repeated)')
+    parser.add_argument('--json', type=Path, help='Write report as JSON to this file')
+    parser.add_argument('-v', '--verbose', action='store_true')
+    parser.add_argument('cmake_args', nargs='*', help='Extra CMake arguments (after --)')
+    return parser.parse_args()
+
+
+def main():
+    # Call chains are followed recursively
+    sys.setrecursionlimit(10000)
+
+    args = parse_args()
+    logs = dict(log.split('=', 1) for log in args.log)
+    results = {}
+
+    for combination in combinations(args.combinations):
+        name = combination_name(combination)
+        build_dir = args.build_dir / name
+
+        if not args.no_build:
+            build(args, combination, build_dir)
+        elif not (build_dir / 'zephyr' / 'zephyr.elf').exists():
+            continue
+
+        golioth_objects = library_objects(build_dir)
+
+        result = {
+            'memory': memory_report(build_dir, golioth_objects),
+            'stack': stack_report(build_dir, golioth_objects),
+            'stack_size': kconfig_value(build_dir, 'CONFIG_GOLIOTH_SYSTEM_CLIENT_STACK_SIZE'),
+        }
+
+        log = logs.get(name)
+        if args.run:
+            log = run(args, build_dir)
+        if log:
+            result['runtime'] = runtime_report(log)
+
+        results[name] = result
+
+    print_report(results)
+
+    if args.json:
+        args.json.write_text(json.dumps(results, indent=2))
+
+
+if __name__ == '__main__':
+    main()
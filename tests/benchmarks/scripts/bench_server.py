@@ -0,0 +1,329 @@
+#!/usr/bin/env python3
+#
+# Copyright (c) 2023 Golioth, Inc.
+#
+# SPDX-License-Identifier: Apache-2.0
+
+"""Local stand-in of Golioth CoAP/DTLS server for benchmarks.
+
+Serves just enough of Golioth device API (LightDB State, LightDB Stream, RPC and firmware
+download) for the benchmark application. CoAP over DTLS with PSK is provided by aiocoap
+'tinydtls_server' transport.
+
+Datagrams between client and server pass through impairment proxy, which can drop and delay them
+(with seeded random generator, so runs are reproducible). Proxy works on encrypted datagrams, so it
+also affects DTLS handshake.
+"""
+
+import argparse
+import asyncio
+import logging
+import random
+import statistics
+import time
+
+import aiocoap
+import aiocoap.resource as resource
+from aiocoap.credentials import CredentialsMap
+import cbor2
+
+
+log = logging.getLogger('bench-server')
+
+
+class ImpairmentProxy:
+    """UDP proxy injecting packet loss and delay in both directions"""
+
+    class _Upstream(asyncio.DatagramProtocol):
+        def __init__(self, proxy, client_addr):
+            self.proxy = proxy
+            self.client_addr = client_addr
+            self.transport = None
+
+        def connection_made(self, transport):
+            self.transport = transport
+
+        def datagram_received(self, data, addr):
+            self.proxy.forward(data, lambda d: self.proxy.transport.sendto(d, self.client_addr))
+
+    def __init__(self, upstream_addr, loss, delay_ms, jitter_ms, seed):
+        self.upstream_addr = upstream_addr
+        self.loss = loss
+        self.delay_ms = delay_ms
+        self.jitter_ms = jitter_ms
+        self.rng = random.Random(seed)
+        self.transport = None
+        self.upstreams = {}
+        self.dropped = 0
+        self.forwarded = 0
+
+    def connection_made(self, transport):
+        self.transport = transport
+
+    def datagram_received(self, data, addr):
+        upstream = self.upstreams.get(addr)
+        if upstream is None:
+            upstream = self._Upstream(self, addr)
+            self.upstreams[addr] = upstream
+            asyncio.get_running_loop().create_task(self._connect_upstream(upstream, data))
+            return
+
+        if upstream.transport:
+            self.forward(data, upstream.transport.sendto)
+
+    async def _connect_upstream(self, upstream, first_datagram):
+        await asyncio.get_running_loop().create_datagram_endpoint(lambda: upstream,
+                                                                  remote_addr=self.upstream_addr)
+        self.forward(first_datagram, upstream.transport.sendto)
+
+    def forward(self, data, send):
+        if self.rng.random() < self.loss:
+            self.dropped += 1
+            return
+
+        self.forwarded += 1
+
+        delay_ms = self.delay_ms
+        if self.jitter_ms:
+            delay_ms += self.rng.uniform(0, self.jitter_ms)
+
+        if delay_ms > 0:
+            asyncio.get_running_loop().call_later(delay_ms / 1000, send, data)
+        else:
+            send(data)
+
+    def error_received(self, exc):
+        log.warning('Proxy error: %s', exc)
+
+    def connection_lost(self, exc):
+        pass
+
+
+class LatencyStats:
+    def __init__(self, name):
+        self.name = name
+        self.samples = []
+
+    def add(self, value_ms):
+        self.samples.append(value_ms)
+
+    def report(self):
+        if not self.samples:
+            log.info('%s: no samples', self.name)
+            return
+
+        samples = sorted(self.samples)
+        p99 = samples[min(len(samples) - 1, int(len(samples) * 0.99))]
+        log.info('%s: n=%d p50=%.1f ms p99=%.1f ms max=%.1f ms', self.name, len(samples),
+                 statistics.median(samples), p99, samples[-1])
+
+
+class StreamResource(resource.Resource):
+    def __init__(self):
+        super().__init__()
+        self.count = 0
+
+    async def render_post(self, request):
+        self.count += 1
+        return aiocoap.Message(code=aiocoap.CHANGED)
+
+
+class StateResource(resource.Resource):
+    def __init__(self):
+        super().__init__()
+        self.value = b'null'
+        self.content_format = aiocoap.numbers.media_types_rev['application/json']
+
+    async def render_get(self, request):
+        return aiocoap.Message(payload=self.value, content_format=self.content_format)
+
+    async def render_post(self, request):
+        self.value = request.payload
+        if request.opt.content_format is not None:
+            self.content_format = request.opt.content_format
+        return aiocoap.Message(code=aiocoap.CHANGED)
+
+
+class ObservedStateResource(resource.ObservableResource):
+    """LightDB path, which sends notifications as soon as it gets observed"""
+
+    def __init__(self, count, interval_ms):
+        super().__init__()
+        self.counter = 0
+        self.count = count
+        self.interval_ms = interval_ms
+        self.task = None
+
+    def update_observation_count(self, count):
+        if count and self.task is None:
+            self.task = asyncio.get_running_loop().create_task(self._notify())
+
+    async def _notify(self):
+        for _ in range(self.count):
+            await asyncio.sleep(self.interval_ms / 1000)
+            self.counter += 1
+            self.updated_state()
+
+    async def render_get(self, request):
+        return aiocoap.Message(payload=str(self.counter).encode(),
+                               content_format=aiocoap.numbers.media_types_rev['application/json'])
+
+
+class RpcResource(resource.ObservableResource):
+    """RPC service, which invokes 'bench' method as soon as client observes it"""
+
+    def __init__(self, calls, timeout):
+        super().__init__()
+        self.calls = calls
+        self.timeout = timeout
+        self.payload = cbor2.dumps('OK')
+        self.pending = {}
+        self.stats = LatencyStats('rpc round-trip')
+        self.task = None
+
+    def update_observation_count(self, count):
+        if count and self.task is None:
+            self.task = asyncio.get_running_loop().create_task(self._invoke())
+
+    async def _invoke(self):
+        loop = asyncio.get_running_loop()
+
+        # Give client time to process 'OK' response to observe registration
+        await asyncio.sleep(0.5)
+
+        for i in range(self.calls):
+            call_id = str(i)
+            future = loop.create_future()
+            self.pending[call_id] = future
+
+            self.payload = cbor2.dumps({'id': call_id, 'method': 'bench', 'params': [i]})
+            start = time.monotonic()
+            self.updated_state()
+
+            try:
+                await asyncio.wait_for(future, self.timeout)
+                self.stats.add((time.monotonic() - start) * 1000)
+            except asyncio.TimeoutError:
+                log.warning('RPC %s timed out', call_id)
+            finally:
+                del self.pending[call_id]
+
+        self.stats.report()
+
+    def status(self, payload):
+        try:
+            status = cbor2.loads(payload)
+        except Exception as e:
+            log.warning('Invalid RPC status: %s', e)
+            return
+
+        future = self.pending.get(status.get('id'))
+        if future and not future.done():
+            future.set_result(status.get('statusCode'))
+
+    async def render_get(self, request):
+        return aiocoap.Message(payload=self.payload,
+                               content_format=aiocoap.numbers.media_types_rev['application/cbor'])
+
+
+class RpcStatusResource(resource.Resource):
+    def __init__(self, rpc):
+        super().__init__()
+        self.rpc = rpc
+
+    async def render_post(self, request):
+        self.rpc.status(request.payload)
+        return aiocoap.Message(code=aiocoap.CHANGED)
+
+
+class FirmwareResource(resource.Resource):
+    """Firmware artifact, transferred with Block2 by aiocoap"""
+
+    def __init__(self, size):
+        super().__init__()
+        self.artifact = bytes(i & 0xff for i in range(size))
+
+    async def render_get(self, request):
+        return aiocoap.Message(payload=self.artifact,
+                               content_format=aiocoap.numbers.media_types_rev[
+                                   'application/octet-stream'])
+
+
+async def main(args):
+    logging.basicConfig(level=logging.INFO)
+
+    site = resource.Site()
+
+    rpc = RpcResource(args.rpc_calls, args.rpc_timeout)
+
+    site.add_resource(['.s', 'bench'], StreamResource())
+    site.add_resource(['.d', 'bench', 'value'], StateResource())
+    for i in range(args.observe_paths):
+        site.add_resource(['.d', 'bench', 'observe', str(i)],
+                          ObservedStateResource(args.notify_count, args.notify_interval_ms))
+    site.add_resource(['.rpc'], rpc)
+    site.add_resource(['.rpc', 'status'], RpcStatusResource(rpc))
+    site.add_resource(['.u', 'c', 'main@bench'], FirmwareResource(args.fw_size))
+
+    credentials = CredentialsMap()
+    credentials.load_from_dict({
+        ':client': {
+            'dtls': {
+                'psk': {'ascii': args.psk},
+                'client-identity': {'ascii': args.psk_id},
+            },
+        },
+    })
+
+    await aiocoap.Context.create_server_context(site,
+                                                bind=('127.0.0.1', args.server_port),
+                                                transports=['tinydtls_server'],
+                                                server_credentials=credentials)
+
+    proxy = ImpairmentProxy(('127.0.0.1', args.server_port), args.loss, args.delay_ms,
+                            args.jitter_ms, args.seed)
+    await asyncio.get_running_loop().create_datagram_endpoint(lambda: proxy,
+                                                              local_addr=(args.host, args.port))
+
+    log.info('Listening on %s:%d (loss %.1f%%, delay %d+%d ms, seed %d)',
+             args.host, args.port, args.loss * 100, args.delay_ms, args.jitter_ms, args.seed)
+
+    try:
+        await asyncio.get_running_loop().create_future()
+    finally:
+        log.info('Proxy: forwarded %d, dropped %d datagrams', proxy.forwarded, proxy.dropped)
+
+
+def parse_args():
+    parser = argparse.ArgumentParser(description=__doc__,
+                                     formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument('--host', default='192.0.2.2', help='Address to listen on')
+    parser.add_argument('--port', type=int, default=5684, help='Port to listen on')
+    parser.add_argument('--server-port', type=int, default=15684,
+                        help='Port of DTLS server behind impairment proxy (localhost)')
+    parser.add_argument('--psk-id', default='bench-id@bench')
+    parser.add_argument('--psk', default='bench-psk')
+    parser.add_argument('--loss', type=float, default=0.0,
+                        help='Probability of dropping each datagram (0.0 - 1.0)')
+    parser.add_argument('--delay-ms', type=int, default=0, help='Delay of each datagram')
+    parser.add_argument('--jitter-ms', type=int, default=0,
+                        help='Maximum random delay added to each datagram')
+    parser.add_argument('--seed', type=int, default=0, help='Seed of loss and jitter generator')
+    parser.add_argument('--observe-paths', type=int, default=4,
+                        help='Must match CONFIG_BENCH_OBSERVE_PATHS')
+    parser.add_argument('--notify-count', type=int, default=100,
+                        help='Must match CONFIG_BENCH_OBSERVE_NOTIFICATIONS')
+    parser.add_argument('--notify-interval-ms', type=int, default=20)
+    parser.add_argument('--rpc-calls', type=int, default=50,
+                        help='Must match CONFIG_BENCH_RPC_CALLS')
+    parser.add_argument('--rpc-timeout', type=float, default=10.0)
+    parser.add_argument('--fw-size', type=int, default=65536,
+                        help='Must match CONFIG_BENCH_FW_SIZE')
+    return parser.parse_args()
+
+
+if __name__ == '__main__':
+    try:
+        asyncio.run(main(parse_args()))
+    except KeyboardInterrupt:
+        pass
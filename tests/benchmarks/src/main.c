@@ -0,0 +1,372 @@
+/*
+ * Copyright (c) 2023 Golioth, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <zephyr/logging/log.h>
+LOG_MODULE_REGISTER(benchmarks);
+
+#include <stdlib.h>
+
+#include <zephyr/ztest.h>
+
+#include <net/golioth.h>
+#include <net/golioth/fw.h>
+#include <net/golioth/metrics.h>
+#include <net/golioth/rpc.h>
+#include <zephyr/net/socket.h>
+#include <zephyr/net/tls_credentials.h>
+
+#include "golioth_test_loop.h"
+
+/*
+ * Benchmarks of Golioth client against local stand-in server (scripts/bench_server.py).
+ *
+ * Each benchmark reports throughput, request latency percentiles, cost of processing received
+ * datagrams (matching with pending requests and running callbacks), heap used by requests and
+ * retransmissions (from client metrics) and stack high-water marks. Packet loss and delay are
+ * injected by the server script, so the same image can be measured under various conditions.
+ */
+
+#define SEC_TAG			1
+#define ITERATIONS		CONFIG_BENCH_ITERATIONS
+#define WINDOW			CONFIG_BENCH_WINDOW
+#define LOOP_STACK_SIZE		4096
+#define LOOP_PRIO		K_PRIO_PREEMPT(5)
+
+static struct golioth_client _client;
+static struct golioth_client *client = &_client;
+static uint8_t rx_buffer[CONFIG_BENCH_RX_BUFFER_SIZE];
+static sec_tag_t sec_tag_list[] = { SEC_TAG };
+
+static K_THREAD_STACK_DEFINE(loop_stack, LOOP_STACK_SIZE);
+
+/* State of currently running request benchmark */
+static uint32_t start_cycles[ITERATIONS];
+static uint32_t latency_us[ITERATIONS];
+static atomic_t completed;
+static atomic_t errors;
+static K_SEM_DEFINE(window_sem, WINDOW, WINDOW);
+static K_SEM_DEFINE(done_sem, 0, 1);
+
+static int u32_cmp(const void *a, const void *b)
+{
+	uint32_t x = *(const uint32_t *)a;
+	uint32_t y = *(const uint32_t *)b;
+
+	return (x > y) - (x < y);
+}
+
+static void bench_reset(void)
+{
+	atomic_clear(&completed);
+	atomic_clear(&errors);
+	k_sem_reset(&done_sem);
+	golioth_test_loop_stats_reset();
+	golioth_metrics_reset(client);
+}
+
+static void bench_report(const char *name, uint32_t count, uint32_t elapsed_ms, bool latency)
+{
+	struct golioth_test_loop_stats loop;
+	struct golioth_metrics m;
+	uint32_t responses = 0;
+	size_t unused = 0;
+
+	golioth_test_loop_stats_get(&loop);
+	golioth_metrics_get(client, &m);
+	k_thread_stack_space_get(golioth_test_loop_thread(), &unused);
+
+	for (size_t i = 0; i < ARRAY_SIZE(m.responses); i++) {
+		responses += m.responses[i];
+	}
+
+	TC_PRINT("[%s] count: %u, errors: %u, elapsed: %u ms, rate: %u/s\n",
+		 name, count, (unsigned int)atomic_get(&errors), elapsed_ms,
+		 elapsed_ms ? (uint32_t)((uint64_t)count * MSEC_PER_SEC / elapsed_ms) : 0);
+
+	if (latency && count) {
+		qsort(latency_us, count, sizeof(latency_us[0]), u32_cmp);
+
+		TC_PRINT("[%s] latency p50: %u us, p99: %u us, max: %u us\n",
+			 name, latency_us[count / 2], latency_us[MIN(count - 1, count * 99 / 100)],
+			 latency_us[count - 1]);
+	}
+
+	/* Single golioth_process_rx() call drains up to CONFIG_GOLIOTH_RX_DRAIN_MAX datagrams */
+	TC_PRINT("[%s] rx: %u responses in %u process_rx calls, avg: %u us/call, max: %u us/call\n",
+		 name, responses, loop.rx_calls,
+		 loop.rx_calls ? k_cyc_to_us_floor32(loop.rx_cycles / loop.rx_calls) : 0,
+		 k_cyc_to_us_floor32(loop.rx_cycles_max));
+	TC_PRINT("[%s] retransmits: %u, timeouts: %u, heap max: %u B, tx: %u B, rx: %u B\n",
+		 name, m.retransmits, m.timeouts, m.heap_used_max, m.bytes_tx, m.bytes_rx);
+	TC_PRINT("[%s] loop stack unused: %zu B\n", name, unused);
+}
+
+static int bench_rsp_cb(struct golioth_req_rsp *rsp)
+{
+	uint32_t i = POINTER_TO_UINT(rsp->user_data);
+
+	if (rsp->err) {
+		atomic_inc(&errors);
+	}
+
+	latency_us[i] = k_cyc_to_us_floor32(k_cycle_get_32() - start_cycles[i]);
+
+	if (atomic_inc(&completed) + 1 == ITERATIONS) {
+		k_sem_give(&done_sem);
+	}
+
+	k_sem_give(&window_sem);
+
+	return 0;
+}
+
+typedef int (*bench_submit_fn)(uint32_t i);
+
+/* Run ITERATIONS requests, keeping at most WINDOW of them in flight */
+static void bench_requests(const char *name, bench_submit_fn submit)
+{
+	uint32_t start_ms;
+	uint32_t elapsed_ms;
+	int err;
+
+	bench_reset();
+
+	start_ms = k_uptime_get_32();
+
+	for (uint32_t i = 0; i < ITERATIONS; i++) {
+		k_sem_take(&window_sem, K_FOREVER);
+
+		start_cycles[i] = k_cycle_get_32();
+		err = submit(i);
+		if (err) {
+			LOG_ERR("Failed to submit request %u: %d", i, err);
+			atomic_inc(&errors);
+			latency_us[i] = 0;
+			if (atomic_inc(&completed) + 1 == ITERATIONS) {
+				k_sem_give(&done_sem);
+			}
+			k_sem_give(&window_sem);
+		}
+	}
+
+	zassert_ok(k_sem_take(&done_sem, K_SECONDS(300)), "Requests did not complete");
+
+	elapsed_ms = k_uptime_get_32() - start_ms;
+
+	bench_report(name, ITERATIONS, elapsed_ms, true);
+
+	zassert_equal(atomic_get(&errors), 0, "Some requests failed");
+}
+
+static int stream_push_submit(uint32_t i)
+{
+	char buf[32];
+	int len = snprintk(buf, sizeof(buf), "{\"i\":%u}", i);
+
+	return golioth_stream_push_cb(client, "bench", GOLIOTH_CONTENT_FORMAT_APP_JSON,
+				      buf, len, bench_rsp_cb, UINT_TO_POINTER(i));
+}
+
+static int lightdb_set_submit(uint32_t i)
+{
+	char buf[16];
+	int len = snprintk(buf, sizeof(buf), "%u", i);
+
+	return golioth_lightdb_set_cb(client, "bench/value", GOLIOTH_CONTENT_FORMAT_APP_JSON,
+				      buf, len, bench_rsp_cb, UINT_TO_POINTER(i));
+}
+
+static int lightdb_get_submit(uint32_t i)
+{
+	return golioth_lightdb_get_cb(client, "bench/value", GOLIOTH_CONTENT_FORMAT_APP_JSON,
+				      bench_rsp_cb, UINT_TO_POINTER(i));
+}
+
+ZTEST(benchmarks, test_stream_push)
+{
+	bench_requests("stream_push", stream_push_submit);
+}
+
+ZTEST(benchmarks, test_lightdb_set)
+{
+	bench_requests("lightdb_set", lightdb_set_submit);
+}
+
+ZTEST(benchmarks, test_lightdb_get)
+{
+	bench_requests("lightdb_get", lightdb_get_submit);
+}
+
+#define OBSERVE_PATHS		CONFIG_BENCH_OBSERVE_PATHS
+#define OBSERVE_TOTAL		(OBSERVE_PATHS * (CONFIG_BENCH_OBSERVE_NOTIFICATIONS + 1))
+
+static int observe_cb(struct golioth_req_rsp *rsp)
+{
+	if (rsp->err) {
+		atomic_inc(&errors);
+		return 0;
+	}
+
+	if (atomic_inc(&completed) + 1 == OBSERVE_TOTAL) {
+		k_sem_give(&done_sem);
+	}
+
+	return 0;
+}
+
+ZTEST(benchmarks, test_observe_fan_in)
+{
+	uint32_t start_ms;
+	uint32_t elapsed_ms;
+	char path[32];
+	int err;
+
+	bench_reset();
+
+	start_ms = k_uptime_get_32();
+
+	for (int i = 0; i < OBSERVE_PATHS; i++) {
+		snprintk(path, sizeof(path), "bench/observe/%d", i);
+
+		err = golioth_lightdb_observe_cb(client, path, GOLIOTH_CONTENT_FORMAT_APP_JSON,
+						 observe_cb, NULL);
+		zassert_ok(err, "Failed to observe %s: %d", path, err);
+	}
+
+	/* Notifications lost on the way are not retransmitted, so do not wait forever */
+	(void)k_sem_take(&done_sem, K_SECONDS(60));
+
+	elapsed_ms = k_uptime_get_32() - start_ms;
+
+	bench_report("observe_fan_in", atomic_get(&completed), elapsed_ms, false);
+	TC_PRINT("[observe_fan_in] received %u of %u notifications\n",
+		 (unsigned int)atomic_get(&completed), OBSERVE_TOTAL);
+}
+
+static enum golioth_rpc_status on_bench(zcbor_state_t *request_params_array,
+					zcbor_state_t *response_detail_map,
+					void *callback_arg)
+{
+	if (atomic_inc(&completed) + 1 == CONFIG_BENCH_RPC_CALLS) {
+		k_sem_give(&done_sem);
+	}
+
+	return GOLIOTH_RPC_OK;
+}
+
+ZTEST(benchmarks, test_rpc_round_trip)
+{
+	uint32_t start_ms;
+	uint32_t elapsed_ms;
+	int err;
+
+	bench_reset();
+
+	start_ms = k_uptime_get_32();
+
+	/* Server invokes RPCs as soon as observation is registered and measures round-trip */
+	err = golioth_rpc_observe(client);
+	zassert_ok(err, "Failed to observe RPC: %d", err);
+
+	zassert_ok(k_sem_take(&done_sem, K_SECONDS(300)), "RPCs were not invoked");
+
+	/* Let last status reach the server */
+	k_sleep(K_MSEC(500));
+
+	elapsed_ms = k_uptime_get_32() - start_ms;
+
+	bench_report("rpc_round_trip", CONFIG_BENCH_RPC_CALLS, elapsed_ms, false);
+}
+
+static size_t fw_received;
+
+static int fw_download_cb(struct golioth_req_rsp *rsp)
+{
+	if (rsp->err) {
+		atomic_inc(&errors);
+		k_sem_give(&done_sem);
+		return rsp->err;
+	}
+
+	fw_received += rsp->len;
+	atomic_inc(&completed);
+
+	if (rsp->get_next) {
+		rsp->get_next(rsp->get_next_data, 0);
+	} else {
+		k_sem_give(&done_sem);
+	}
+
+	return 0;
+}
+
+ZTEST(benchmarks, test_fw_download)
+{
+	static const char uri[] = ".u/c/main@bench";
+	uint32_t start_ms;
+	uint32_t elapsed_ms;
+	int err;
+
+	bench_reset();
+	fw_received = 0;
+
+	start_ms = k_uptime_get_32();
+
+	err = golioth_fw_download(client, uri, sizeof(uri) - 1, fw_download_cb, NULL);
+	zassert_ok(err, "Failed to request firmware: %d", err);
+
+	zassert_ok(k_sem_take(&done_sem, K_SECONDS(300)), "Download did not complete");
+
+	elapsed_ms = k_uptime_get_32() - start_ms;
+
+	bench_report("fw_download", atomic_get(&completed), elapsed_ms, false);
+	TC_PRINT("[fw_download] %zu B, %u B/s\n", fw_received,
+		 elapsed_ms ? (uint32_t)((uint64_t)fw_received * MSEC_PER_SEC / elapsed_ms) : 0);
+
+	zassert_equal(atomic_get(&errors), 0, "Download failed");
+	zassert_equal(fw_received, CONFIG_BENCH_FW_SIZE, "Unexpected firmware size");
+}
+
+static void *benchmarks_setup(void)
+{
+	struct golioth_metrics m;
+	int err;
+
+	err = tls_credential_add(SEC_TAG, TLS_CREDENTIAL_PSK,
+				 CONFIG_BENCH_PSK, sizeof(CONFIG_BENCH_PSK) - 1);
+	zassert_ok(err, "Failed to add PSK: %d", err);
+
+	err = tls_credential_add(SEC_TAG, TLS_CREDENTIAL_PSK_ID,
+				 CONFIG_BENCH_PSK_ID, sizeof(CONFIG_BENCH_PSK_ID) - 1);
+	zassert_ok(err, "Failed to add PSK ID: %d", err);
+
+	golioth_init(client);
+	client->rx_buffer = rx_buffer;
+	client->rx_buffer_len = sizeof(rx_buffer);
+
+	err = golioth_set_proto_coap_dtls(client, sec_tag_list, ARRAY_SIZE(sec_tag_list));
+	zassert_ok(err, "Failed to set protocol: %d", err);
+
+	err = golioth_rpc_init(client);
+	zassert_ok(err, "Failed to init RPC: %d", err);
+
+	err = golioth_rpc_register(client, "bench", on_bench, NULL);
+	zassert_ok(err, "Failed to register RPC: %d", err);
+
+	err = golioth_connect(client, CONFIG_BENCH_SERVER_HOST, CONFIG_BENCH_SERVER_PORT);
+	zassert_ok(err, "Failed to connect: %d", err);
+
+	golioth_metrics_get(client, &m);
+	TC_PRINT("handshake: %u ms\n", m.handshake.last_ms);
+
+	err = golioth_test_loop_start(client, loop_stack, K_THREAD_STACK_SIZEOF(loop_stack),
+				      LOOP_PRIO);
+	zassert_ok(err, "Failed to start loop: %d", err);
+
+	return NULL;
+}
+
+ZTEST_SUITE(benchmarks, NULL, benchmarks_setup, NULL, NULL, NULL);
@@ -0,0 +1,554 @@
+/*
+ * Copyright (c) 2023 Golioth, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <zephyr/logging/log.h>
+LOG_MODULE_REGISTER(coap_impairment_test);
+
+#include <stdlib.h>
+
+#include <zephyr/ztest.h>
+
+#include <net/golioth.h>
+#include <net/golioth/lightdb.h>
+#include <zephyr/net/coap.h>
+#include <zephyr/net/socket.h>
+
+#include "coap_test_server.h"
+#include "golioth_test_loop.h"
+#include "sockets_impairment.h"
+
+/*
+ * Tests and benchmarks of CoAP request handling over impaired network.
+ *
+ * Client is connected over plain UDP (no DTLS) to a minimal CoAP server running in test thread on
+ * loopback interface. Both client and server sockets are wrapped by sockets_impairment shim, which
+ * injects seeded (so reproducible) loss, duplication and reordering of datagrams.
+ *
+ * Shim impairs datagrams of sockets created by application, so it sees CoAP messages only when
+ * client uses plain UDP. That is why this test depends on CONFIG_GOLIOTH_PROTO_COAP_UDP and
+ * golioth_set_proto_coap_udp(). With DTLS, impairments would need to be applied to the UDP socket
+ * created internally by TLS sockets layer instead.
+ */
+
+#define SERVER_PORT		5683
+#define STACK_SIZE		4096
+#define THREAD_PRIO		K_PRIO_PREEMPT(5)
+
+#define ACK_TIMEOUT_MS		100
+#define TIMING_TOLERANCE_MS	50
+
+#define SERVER_RX_MAX		16
+
+#define OBSERVE_NOTIFICATIONS	20
+#define OBSERVE_INTERVAL_MS	5
+
+#define BLOB_SIZE		1000
+#define BLOB_BLOCK_SZX		COAP_BLOCK_64
+
+static struct golioth_client _client;
+static struct golioth_client *client = &_client;
+static uint8_t rx_buffer[256];
+
+static K_THREAD_STACK_DEFINE(server_stack, STACK_SIZE);
+static K_THREAD_STACK_DEFINE(loop_stack, STACK_SIZE);
+
+/* Uptime of requests received by server */
+static uint32_t server_rx_ms[SERVER_RX_MAX];
+static atomic_t server_rx_count;
+
+/* Token of observation registered by client */
+static uint8_t observe_token[COAP_TOKEN_MAX_LEN];
+static uint8_t observe_tkl;
+static K_SEM_DEFINE(observe_registered_sem, 0, 1);
+
+static uint8_t blob[BLOB_SIZE];
+
+/* Results collected by request callbacks */
+static K_SEM_DEFINE(rsp_sem, 0, 1);
+static int rsp_err;
+static int observe_last;
+static uint32_t observe_count;
+static uint32_t observe_out_of_order;
+static size_t blob_received;
+static uint32_t blob_blocks;
+static uint32_t blob_errors;
+
+static void server_reply(const struct coap_packet *request, int observe, int block2,
+			 const uint8_t *payload, uint16_t payload_len)
+{
+	(void)coap_test_server_reply(request, COAP_RESPONSE_CODE_CONTENT, observe, block2,
+				     payload, payload_len);
+}
+
+static void server_record(const struct coap_packet *request)
+{
+	atomic_val_t idx = atomic_inc(&server_rx_count);
+
+	if (idx < ARRAY_SIZE(server_rx_ms)) {
+		server_rx_ms[idx] = k_uptime_get_32();
+	}
+}
+
+static void server_handle_ignore(const struct coap_packet *request)
+{
+	server_record(request);
+}
+
+static void server_handle_value(const struct coap_packet *request)
+{
+	server_record(request);
+	server_reply(request, -1, -1, (const uint8_t *)"1", 1);
+}
+
+static void server_handle_observe(const struct coap_packet *request)
+{
+	int observe = coap_get_option_int(request, COAP_OPTION_OBSERVE);
+
+	if (observe != 0) {
+		/* Deregistration */
+		server_reply(request, -1, -1, (const uint8_t *)"0", 1);
+		return;
+	}
+
+	observe_tkl = coap_header_get_token(request, observe_token);
+
+	server_reply(request, 1, -1, (const uint8_t *)"1", 1);
+
+	k_sem_give(&observe_registered_sem);
+}
+
+static void server_handle_blob(const struct coap_packet *request)
+{
+	int block2 = coap_get_option_int(request, COAP_OPTION_BLOCK2);
+	int num = 0;
+	int szx = BLOB_BLOCK_SZX;
+	size_t block_size;
+	size_t off;
+	size_t len;
+	bool more;
+
+	if (block2 >= 0) {
+		num = block2 >> 4;
+		szx = MIN(block2 & 0x7, BLOB_BLOCK_SZX);
+	}
+
+	block_size = coap_block_size_to_bytes(szx);
+	off = num * block_size;
+	if (off >= BLOB_SIZE) {
+		LOG_ERR("Block %d out of range", num);
+		return;
+	}
+
+	len = MIN(block_size, BLOB_SIZE - off);
+	more = (off + len < BLOB_SIZE);
+
+	server_reply(request, -1, (num << 4) | (more << 3) | szx, &blob[off], len);
+}
+
+static int value_cb(struct golioth_req_rsp *rsp)
+{
+	rsp_err = rsp->err;
+	k_sem_give(&rsp_sem);
+
+	return 0;
+}
+
+static int observe_cb(struct golioth_req_rsp *rsp)
+{
+	char str[12];
+	int value;
+
+	if (rsp->err) {
+		if (rsp->err != -ECANCELED) {
+			rsp_err = rsp->err;
+		}
+		return 0;
+	}
+
+	if (rsp->len >= sizeof(str)) {
+		rsp_err = -EMSGSIZE;
+		return 0;
+	}
+
+	memcpy(str, rsp->data, rsp->len);
+	str[rsp->len] = '\0';
+	value = atoi(str);
+
+	if (value <= observe_last) {
+		observe_out_of_order++;
+	}
+
+	observe_last = value;
+	observe_count++;
+
+	return 0;
+}
+
+static int blob_cb(struct golioth_req_rsp *rsp)
+{
+	if (rsp->err) {
+		rsp_err = rsp->err;
+		k_sem_give(&rsp_sem);
+		return 0;
+	}
+
+	blob_blocks++;
+
+	if (rsp->off != blob_received || rsp->off + rsp->len > BLOB_SIZE ||
+	    memcmp(rsp->data, &blob[rsp->off], rsp->len)) {
+		LOG_ERR("Unexpected block at %zu (len %zu), expected %zu",
+			rsp->off, rsp->len, blob_received);
+		blob_errors++;
+	} else {
+		blob_received += rsp->len;
+	}
+
+	if (rsp->get_next) {
+		rsp->get_next(rsp->get_next_data, 0);
+	} else {
+		k_sem_give(&rsp_sem);
+	}
+
+	return 0;
+}
+
+static void impairment_set(int fd, const struct sockets_impairment_config *config)
+{
+	int err;
+
+	err = sockets_impairment_set(fd, config);
+	zassert_ok(err, "Failed to set impairments: %d", err);
+}
+
+ZTEST(coap_impairment, test_retransmission_backoff)
+{
+	struct golioth_req_opts opts = {
+		.max_retries = 3,
+		.ack_timeout_ms = ACK_TIMEOUT_MS,
+	};
+	uint32_t expected_ms = ACK_TIMEOUT_MS;
+	int err;
+
+	coap_test_server_handler_set(server_handle_ignore);
+
+	err = golioth_lightdb_get_cb_opts(client, "value", GOLIOTH_CONTENT_FORMAT_APP_JSON,
+					  value_cb, NULL, &opts);
+	zassert_ok(err, "Failed to request: %d", err);
+
+	err = k_sem_take(&rsp_sem, K_SECONDS(5));
+	zassert_ok(err, "Callback was not invoked");
+
+	zassert_equal(rsp_err, -ETIMEDOUT, "Unexpected error: %d", rsp_err);
+	zassert_equal(atomic_get(&server_rx_count), 1 + opts.max_retries,
+		      "Unexpected number of transmissions: %d",
+		      (int)atomic_get(&server_rx_count));
+
+	/* Interval between retransmissions is doubled each time */
+	for (int i = 1; i < atomic_get(&server_rx_count); i++) {
+		uint32_t interval_ms = server_rx_ms[i] - server_rx_ms[i - 1];
+
+		TC_PRINT("retransmission %d after %u ms\n", i, interval_ms);
+
+		zassert_between_inclusive(interval_ms, expected_ms - 1,
+					  expected_ms + TIMING_TOLERANCE_MS,
+					  "Unexpected interval of retransmission %d: %u ms",
+					  i, interval_ms);
+
+		expected_ms *= 2;
+	}
+}
+
+ZTEST(coap_impairment, test_retransmission_loss)
+{
+	struct golioth_req_opts opts = {
+		.max_retries = 6,
+		.ack_timeout_ms = ACK_TIMEOUT_MS,
+	};
+	struct sockets_impairment_config client_impairment = {
+		.seed = 12345,
+		.loss_pct = 50,
+	};
+	struct sockets_impairment_config server_impairment = {
+		.seed = 54321,
+		.loss_pct = 50,
+	};
+	struct sockets_impairment_stats client_stats;
+	struct sockets_impairment_stats server_stats;
+	int err;
+
+	coap_test_server_handler_set(server_handle_value);
+
+	impairment_set(client->sock, &client_impairment);
+	impairment_set(coap_test_server_sock(), &server_impairment);
+
+	err = golioth_lightdb_get_cb_opts(client, "value", GOLIOTH_CONTENT_FORMAT_APP_JSON,
+					  value_cb, NULL, &opts);
+	zassert_ok(err, "Failed to request: %d", err);
+
+	err = k_sem_take(&rsp_sem, K_SECONDS(20));
+	zassert_ok(err, "Callback was not invoked");
+
+	err = sockets_impairment_stats_get(client->sock, &client_stats);
+	zassert_ok(err, "Failed to get stats: %d", err);
+
+	err = sockets_impairment_stats_get(coap_test_server_sock(), &server_stats);
+	zassert_ok(err, "Failed to get stats: %d", err);
+
+	TC_PRINT("requests: sent %u dropped %u, responses: sent %u dropped %u\n",
+		 client_stats.sent, client_stats.dropped,
+		 server_stats.sent, server_stats.dropped);
+
+	zassert_ok(rsp_err, "Request failed: %d", rsp_err);
+	zassert_true(client_stats.dropped + server_stats.dropped > 0, "Nothing was dropped");
+}
+
+ZTEST(coap_impairment, test_observe_reordering)
+{
+	struct sockets_impairment_config server_impairment = {
+		.seed = 42,
+		.reorder_pct = 30,
+		.reorder_delay_ms = 10 * OBSERVE_INTERVAL_MS,
+	};
+	struct sockets_impairment_stats server_stats;
+	uint32_t handle;
+	struct golioth_req_opts opts = {
+		.handle = &handle,
+	};
+	char payload[12];
+	int err;
+
+	coap_test_server_handler_set(server_handle_observe);
+
+	err = golioth_lightdb_observe_cb_opts(client, "counter", GOLIOTH_CONTENT_FORMAT_APP_JSON,
+					      observe_cb, NULL, &opts);
+	zassert_ok(err, "Failed to observe: %d", err);
+
+	err = k_sem_take(&observe_registered_sem, K_SECONDS(5));
+	zassert_ok(err, "Observation was not registered");
+
+	impairment_set(coap_test_server_sock(), &server_impairment);
+
+	/* Registration response had sequence number 1 */
+	for (int seq = 2; seq < 2 + OBSERVE_NOTIFICATIONS; seq++) {
+		snprintk(payload, sizeof(payload), "%d", seq);
+
+		coap_test_server_send(COAP_TYPE_NON_CON, COAP_RESPONSE_CODE_CONTENT,
+				      coap_next_id(), observe_token, observe_tkl,
+				      seq, -1, (const uint8_t *)payload, strlen(payload));
+
+		k_sleep(K_MSEC(OBSERVE_INTERVAL_MS));
+	}
+
+	/* Wait for all delayed notifications */
+	k_sleep(K_MSEC(server_impairment.reorder_delay_ms + 100));
+
+	err = sockets_impairment_stats_get(coap_test_server_sock(), &server_stats);
+	zassert_ok(err, "Failed to get stats: %d", err);
+
+	TC_PRINT("notifications: sent %u reordered %u, delivered to callback %u\n",
+		 server_stats.sent, server_stats.reordered, observe_count);
+
+	err = golioth_observe_stop(client, handle);
+	zassert_ok(err, "Failed to stop observation: %d", err);
+
+	/* Let server acknowledge deregistration, so it is not retransmitted during next test */
+	k_sleep(K_MSEC(100));
+
+	zassert_ok(rsp_err, "Observation failed: %d", rsp_err);
+	zassert_true(server_stats.reordered > 0, "Nothing was reordered");
+	zassert_equal(observe_out_of_order, 0, "%u stale notifications passed to callback",
+		      observe_out_of_order);
+	zassert_equal(observe_last, 1 + OBSERVE_NOTIFICATIONS, "Last notification not received");
+	zassert_true(observe_count < 1 + OBSERVE_NOTIFICATIONS,
+		     "Stale notifications were not dropped");
+}
+
+ZTEST(coap_impairment, test_block2_duplicates)
+{
+	struct sockets_impairment_config server_impairment = {
+		.seed = 1,
+		.dup_pct = 100,
+	};
+	struct sockets_impairment_stats server_stats;
+	uint32_t expected_blocks = DIV_ROUND_UP(BLOB_SIZE, coap_block_size_to_bytes(BLOB_BLOCK_SZX));
+	int err;
+
+	coap_test_server_handler_set(server_handle_blob);
+
+	impairment_set(coap_test_server_sock(), &server_impairment);
+
+	err = golioth_lightdb_get_cb(client, "blob", GOLIOTH_CONTENT_FORMAT_APP_OCTET_STREAM,
+				     blob_cb, NULL);
+	zassert_ok(err, "Failed to request: %d", err);
+
+	err = k_sem_take(&rsp_sem, K_SECONDS(10));
+	zassert_ok(err, "Transfer did not finish");
+
+	/* Let client process duplicate of last block */
+	k_sleep(K_MSEC(100));
+
+	err = sockets_impairment_stats_get(coap_test_server_sock(), &server_stats);
+	zassert_ok(err, "Failed to get stats: %d", err);
+
+	TC_PRINT("blocks: sent %u duplicated %u, delivered to callback %u\n",
+		 server_stats.sent, server_stats.duplicated, blob_blocks);
+
+	zassert_ok(rsp_err, "Transfer failed: %d", rsp_err);
+	zassert_equal(server_stats.duplicated, server_stats.sent, "Not all blocks duplicated");
+	zassert_equal(blob_errors, 0, "Blocks were not contiguous");
+	zassert_equal(blob_blocks, expected_blocks, "Unexpected number of blocks");
+	zassert_equal(blob_received, BLOB_SIZE, "Unexpected size of received data");
+}
+
+/*
+ * Benchmarks of request completion under seeded loss (the same loss on both directions). Each
+ * loss rate runs BENCH_REQUESTS sequential requests and one Block2 transfer, reporting elapsed
+ * time, latency and number of transmissions seen by server. Results are printed, but only request
+ * failures are asserted, so timing of CI machine does not affect the outcome.
+ */
+
+#define BENCH_REQUESTS		50
+#define BENCH_MAX_RETRIES	8
+
+static const uint8_t bench_loss_pct[] = { 0, 5, 20 };
+
+ZTEST(coap_impairment, test_bench_loss)
+{
+	struct golioth_req_opts opts = {
+		.max_retries = BENCH_MAX_RETRIES,
+		.ack_timeout_ms = ACK_TIMEOUT_MS,
+	};
+	uint32_t failed;
+	uint32_t start_ms, elapsed_ms;
+	uint32_t latency_ms, latency_max_ms;
+	int err;
+
+	for (size_t i = 0; i < ARRAY_SIZE(bench_loss_pct); i++) {
+		struct sockets_impairment_config impairment = {
+			.seed = 1000 + i,
+			.loss_pct = bench_loss_pct[i],
+		};
+
+		impairment_set(client->sock, &impairment);
+		impairment_set(coap_test_server_sock(), &impairment);
+
+		coap_test_server_handler_set(server_handle_value);
+		atomic_clear(&server_rx_count);
+		failed = 0;
+		latency_max_ms = 0;
+
+		start_ms = k_uptime_get_32();
+
+		for (int n = 0; n < BENCH_REQUESTS; n++) {
+			uint32_t req_start_ms = k_uptime_get_32();
+
+			err = golioth_lightdb_get_cb_opts(client, "value",
+							  GOLIOTH_CONTENT_FORMAT_APP_JSON,
+							  value_cb, NULL, &opts);
+			zassert_ok(err, "Failed to request: %d", err);
+
+			err = k_sem_take(&rsp_sem, K_SECONDS(60));
+			zassert_ok(err, "Callback was not invoked");
+
+			if (rsp_err) {
+				failed++;
+			}
+
+			latency_ms = k_uptime_get_32() - req_start_ms;
+			latency_max_ms = MAX(latency_max_ms, latency_ms);
+		}
+
+		elapsed_ms = k_uptime_get_32() - start_ms;
+
+		TC_PRINT("[loss %u%%] requests: %d, failed: %u, transmissions: %u, "
+			 "elapsed: %u ms, avg: %u ms, max: %u ms\n",
+			 bench_loss_pct[i], BENCH_REQUESTS, failed,
+			 (unsigned int)atomic_get(&server_rx_count), elapsed_ms,
+			 elapsed_ms / BENCH_REQUESTS, latency_max_ms);
+
+		zassert_equal(failed, 0, "%u requests failed with %u%% loss",
+			      failed, bench_loss_pct[i]);
+
+		coap_test_server_handler_set(server_handle_blob);
+		blob_received = 0;
+		blob_blocks = 0;
+		rsp_err = 0;
+
+		start_ms = k_uptime_get_32();
+
+		err = golioth_lightdb_get_cb_opts(client, "blob",
+						  GOLIOTH_CONTENT_FORMAT_APP_OCTET_STREAM,
+						  blob_cb, NULL, &opts);
+		zassert_ok(err, "Failed to request: %d", err);
+
+		err = k_sem_take(&rsp_sem, K_SECONDS(60));
+		zassert_ok(err, "Transfer did not finish");
+
+		elapsed_ms = k_uptime_get_32() - start_ms;
+
+		TC_PRINT("[loss %u%%] block2: %zu B in %u blocks, elapsed: %u ms\n",
+			 bench_loss_pct[i], blob_received, blob_blocks, elapsed_ms);
+
+		zassert_ok(rsp_err, "Transfer failed: %d", rsp_err);
+		zassert_equal(blob_received, BLOB_SIZE, "Unexpected size of received data");
+	}
+}
+
+static void *coap_impairment_setup(void)
+{
+	int err;
+
+	for (size_t i = 0; i < sizeof(blob); i++) {
+		blob[i] = i & 0xff;
+	}
+
+	err = coap_test_server_start(SERVER_PORT, server_stack, K_THREAD_STACK_SIZEOF(server_stack),
+				     THREAD_PRIO);
+	zassert_ok(err, "Failed to start server: %d", err);
+
+	golioth_init(client);
+	client->rx_buffer = rx_buffer;
+	client->rx_buffer_len = sizeof(rx_buffer);
+
+	err = golioth_set_proto_coap_udp(client);
+	zassert_ok(err, "Failed to set protocol: %d", err);
+
+	err = golioth_connect(client, "127.0.0.1", SERVER_PORT);
+	zassert_ok(err, "Failed to connect: %d", err);
+
+	err = golioth_test_loop_start(client, loop_stack, K_THREAD_STACK_SIZEOF(loop_stack),
+				      THREAD_PRIO);
+	zassert_ok(err, "Failed to start loop: %d", err);
+
+	return NULL;
+}
+
+static void coap_impairment_before(void *fixture)
+{
+	atomic_clear(&server_rx_count);
+	k_sem_reset(&rsp_sem);
+	k_sem_reset(&observe_registered_sem);
+	rsp_err = 0;
+	observe_last = 0;
+	observe_count = 0;
+	observe_out_of_order = 0;
+	blob_received = 0;
+	blob_blocks = 0;
+	blob_errors = 0;
+}
+
+static void coap_impairment_after(void *fixture)
+{
+	static const struct sockets_impairment_config no_impairment;
+
+	coap_test_server_handler_set(NULL);
+
+	(void)sockets_impairment_set(client->sock, &no_impairment);
+	(void)sockets_impairment_set(coap_test_server_sock(), &no_impairment);
+}
+
+ZTEST_SUITE(coap_impairment, NULL, coap_impairment_setup, coap_impairment_before,
+	    coap_impairment_after, NULL);
@@ -0,0 +1,575 @@
+/*
+ * Copyright (c) 2023 Golioth, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <zephyr/logging/log.h>
+LOG_MODULE_REGISTER(coap_req_test);
+
+#include <string.h>
+
+#include <zephyr/ztest.h>
+
+#include <net/golioth.h>
+#include <net/golioth/lightdb.h>
+#include <zephyr/net/coap.h>
+
+#include "coap_test_server.h"
+#include "golioth_test_loop.h"
+
+/*
+ * Tests of CoAP request handling (observations, scheduling, request options). Client is connected
+ * over plain UDP to a minimal CoAP server on loopback interface. Each test installs its own server
+ * handler and leaves client connected with no observations.
+ */
+
+#define SERVER_PORT		5683
+#define STACK_SIZE		4096
+#define THREAD_PRIO		K_PRIO_PREEMPT(5)
+
+#define SERVER_RX_MAX		16
+
+#define TEST_ETAG		"etag1"
+
+static struct golioth_client _client;
+static struct golioth_client *client = &_client;
+static uint8_t rx_buffer[256];
+
+static K_THREAD_STACK_DEFINE(server_stack, STACK_SIZE);
+static K_THREAD_STACK_DEFINE(loop_stack, STACK_SIZE);
+
+/* Requests received by server */
+struct server_rx {
+	uint8_t token[COAP_TOKEN_MAX_LEN];
+	uint8_t tkl;
+	int observe;
+	bool etag;
+	char path[16];
+};
+
+static struct server_rx server_rx[SERVER_RX_MAX];
+static atomic_t server_rx_count;
+static K_SEM_DEFINE(server_rx_sem, 0, SERVER_RX_MAX);
+
+/* Results collected by request callbacks */
+struct cb_result {
+	uint32_t calls;
+	uint32_t cancelled;
+	int err;
+};
+
+static struct cb_result results[2];
+static K_SEM_DEFINE(rsp_sem, 0, 1);
+
+static void server_record(const struct coap_packet *request)
+{
+	atomic_val_t idx = atomic_inc(&server_rx_count);
+	struct coap_option options[4];
+	struct server_rx *rx;
+	size_t len;
+	int num;
+
+	if (idx >= ARRAY_SIZE(server_rx)) {
+		return;
+	}
+
+	rx = &server_rx[idx];
+
+	rx->tkl = coap_header_get_token(request, rx->token);
+	rx->observe = coap_get_option_int(request, COAP_OPTION_OBSERVE);
+	rx->etag = (coap_find_options(request, COAP_OPTION_ETAG, options, 1) == 1);
+
+	/* Last segment of path is enough to tell requests apart */
+	num = coap_find_options(request, COAP_OPTION_URI_PATH, options, ARRAY_SIZE(options));
+	if (num > 0) {
+		len = MIN(options[num - 1].len, sizeof(rx->path) - 1);
+		memcpy(rx->path, options[num - 1].value, len);
+		rx->path[len] = '\0';
+	}
+
+	k_sem_give(&server_rx_sem);
+}
+
+static void server_handle_observe(const struct coap_packet *request)
+{
+	int observe = coap_get_option_int(request, COAP_OPTION_OBSERVE);
+
+	server_record(request);
+
+	(void)coap_test_server_reply(request, COAP_RESPONSE_CODE_CONTENT,
+				     observe == 0 ? 1 : -1, -1, (const uint8_t *)"1", 1);
+}
+
+static int result_cb(struct golioth_req_rsp *rsp)
+{
+	struct cb_result *result = rsp->user_data;
+
+	if (rsp->err == -ECANCELED) {
+		result->cancelled++;
+	} else {
+		result->calls++;
+		result->err = rsp->err;
+	}
+
+	k_sem_give(&rsp_sem);
+
+	return 0;
+}
+
+static struct server_rx *server_rx_wait(void)
+{
+	int idx;
+	int err;
+
+	err = k_sem_take(&server_rx_sem, K_SECONDS(5));
+	zassert_ok(err, "Request was not received by server");
+
+	idx = atomic_get(&server_rx_count) - 1;
+	zassert_true(idx < ARRAY_SIZE(server_rx), "Too many requests");
+
+	return &server_rx[idx];
+}
+
+static void server_rx_none(k_timeout_t timeout)
+{
+	int err;
+
+	err = k_sem_take(&server_rx_sem, timeout);
+	zassert_equal(err, -EAGAIN, "Unexpected request received by server");
+}
+
+static void client_reconnect(void)
+{
+	int err;
+
+	err = golioth_disconnect(client);
+	zassert_ok(err, "Failed to disconnect: %d", err);
+
+	err = golioth_connect(client, "127.0.0.1", SERVER_PORT);
+	zassert_ok(err, "Failed to connect: %d", err);
+}
+
+ZTEST(coap_req, test_observe_dedup)
+{
+	uint32_t handle[3];
+	struct golioth_req_opts opts[3] = {
+		{ .handle = &handle[0] },
+		{ .handle = &handle[1] },
+		{ .handle = &handle[2] },
+	};
+	int err;
+
+	coap_test_server_handler_set(server_handle_observe);
+
+	err = golioth_lightdb_observe_cb_opts(client, "counter", GOLIOTH_CONTENT_FORMAT_APP_JSON,
+					      result_cb, &results[0], &opts[0]);
+	zassert_ok(err, "Failed to observe: %d", err);
+
+	(void)server_rx_wait();
+
+	/* Identical observation is not registered again */
+	err = golioth_lightdb_observe_cb_opts(client, "counter", GOLIOTH_CONTENT_FORMAT_APP_JSON,
+					      result_cb, &results[0], &opts[1]);
+	zassert_ok(err, "Failed to observe: %d", err);
+	zassert_equal(handle[1], handle[0], "Handle of existing observation not reported");
+
+	server_rx_none(K_MSEC(100));
+
+	/* Different user data makes it a distinct observation */
+	err = golioth_lightdb_observe_cb_opts(client, "counter", GOLIOTH_CONTENT_FORMAT_APP_JSON,
+					      result_cb, &results[1], &opts[2]);
+	zassert_ok(err, "Failed to observe: %d", err);
+	zassert_not_equal(handle[2], handle[0], "Distinct observation has the same handle");
+
+	(void)server_rx_wait();
+
+	zassert_equal(atomic_get(&server_rx_count), 2, "Unexpected number of registrations");
+}
+
+ZTEST(coap_req, test_observe_resume)
+{
+	struct server_rx registration;
+	struct server_rx *rx;
+	int err;
+
+	coap_test_server_handler_set(server_handle_observe);
+
+	err = golioth_lightdb_observe_cb(client, "counter", GOLIOTH_CONTENT_FORMAT_APP_JSON,
+					 result_cb, &results[0]);
+	zassert_ok(err, "Failed to observe: %d", err);
+
+	registration = *server_rx_wait();
+	zassert_equal(registration.observe, 0, "Not a registration");
+
+	err = k_sem_take(&rsp_sem, K_SECONDS(1));
+	zassert_ok(err, "Callback was not invoked");
+
+	client_reconnect();
+
+	/* Observation is registered again with the same token */
+	rx = server_rx_wait();
+	zassert_equal(rx->observe, 0, "Not a registration");
+	zassert_equal(rx->tkl, registration.tkl, "Token changed");
+	zassert_mem_equal(rx->token, registration.token, rx->tkl, "Token changed");
+
+	err = k_sem_take(&rsp_sem, K_SECONDS(1));
+	zassert_ok(err, "Callback was not invoked after resuming");
+
+	/* Notification matching token of registration is delivered */
+	err = coap_test_server_send(COAP_TYPE_NON_CON, COAP_RESPONSE_CODE_CONTENT,
+				    coap_next_id(), registration.token, registration.tkl,
+				    2, -1, (const uint8_t *)"2", 1);
+	zassert_ok(err, "Failed to send notification: %d", err);
+
+	err = k_sem_take(&rsp_sem, K_SECONDS(1));
+	zassert_ok(err, "Notification was not delivered");
+
+	zassert_equal(results[0].calls, 3, "Unexpected number of callbacks: %u",
+		      results[0].calls);
+	zassert_ok(results[0].err, "Observation failed: %d", results[0].err);
+	zassert_equal(results[0].cancelled, 0, "Observation was cancelled by reconnect");
+}
+
+/*
+ * Observation requested again after its value was cached carries ETag, which must not make it
+ * a distinct observation.
+ */
+ZTEST(coap_req, test_observe_dedup_cached)
+{
+	uint32_t handle[2];
+	struct golioth_req_opts opts[2] = {
+		{ .handle = &handle[0] },
+		{ .handle = &handle[1] },
+	};
+	struct server_rx *rx;
+	int err;
+
+	coap_test_server_etag_set(TEST_ETAG, sizeof(TEST_ETAG) - 1);
+	coap_test_server_handler_set(server_handle_observe);
+
+	err = golioth_lightdb_observe_cb_opts(client, "cached", GOLIOTH_CONTENT_FORMAT_APP_JSON,
+					      result_cb, &results[0], &opts[0]);
+	zassert_ok(err, "Failed to observe: %d", err);
+
+	rx = server_rx_wait();
+	zassert_false(rx->etag, "Nothing was cached yet");
+
+	err = k_sem_take(&rsp_sem, K_SECONDS(1));
+	zassert_ok(err, "Callback was not invoked");
+
+	/* Value is cached after callback returns */
+	k_sleep(K_MSEC(100));
+
+	err = golioth_lightdb_observe_cb_opts(client, "cached", GOLIOTH_CONTENT_FORMAT_APP_JSON,
+					      result_cb, &results[0], &opts[1]);
+	zassert_ok(err, "Failed to observe: %d", err);
+	zassert_equal(handle[1], handle[0], "Handle of existing observation not reported");
+
+	server_rx_none(K_MSEC(100));
+}
+
+/*
+ * Resumed observation is registered without ETag, as cached value it refers to might have been
+ * evicted meanwhile.
+ */
+ZTEST(coap_req, test_observe_resume_without_etag)
+{
+	struct server_rx *rx;
+	int err;
+
+	coap_test_server_etag_set(TEST_ETAG, sizeof(TEST_ETAG) - 1);
+	coap_test_server_handler_set(server_handle_observe);
+
+	err = golioth_lightdb_observe_cb(client, "resumed", GOLIOTH_CONTENT_FORMAT_APP_JSON,
+					 result_cb, &results[0]);
+	zassert_ok(err, "Failed to observe: %d", err);
+
+	(void)server_rx_wait();
+
+	err = k_sem_take(&rsp_sem, K_SECONDS(1));
+	zassert_ok(err, "Callback was not invoked");
+
+	/* Value is cached after callback returns */
+	k_sleep(K_MSEC(100));
+
+	/* Distinct observation (other user data), which is registered with ETag */
+	err = golioth_lightdb_observe_cb(client, "resumed", GOLIOTH_CONTENT_FORMAT_APP_JSON,
+					 result_cb, &results[1]);
+	zassert_ok(err, "Failed to observe: %d", err);
+
+	rx = server_rx_wait();
+	zassert_true(rx->etag, "Cached value was not validated");
+
+	client_reconnect();
+
+	for (int i = 0; i < 2; i++) {
+		rx = server_rx_wait();
+		zassert_equal(rx->observe, 0, "Not a registration");
+		zassert_false(rx->etag, "Resumed observation registered with ETag");
+	}
+
+	zassert_equal(results[0].cancelled + results[1].cancelled, 0,
+		      "Observation was cancelled by reconnect");
+}
+
+ZTEST(coap_req, test_observe_cancel_all)
+{
+	int err;
+
+	coap_test_server_handler_set(server_handle_observe);
+
+	err = golioth_lightdb_observe_cb(client, "counter", GOLIOTH_CONTENT_FORMAT_APP_JSON,
+					 result_cb, &results[0]);
+	zassert_ok(err, "Failed to observe: %d", err);
+
+	(void)server_rx_wait();
+
+	err = golioth_disconnect(client);
+	zassert_ok(err, "Failed to disconnect: %d", err);
+
+	/* Suspended observation is freed and reported as cancelled */
+	golioth_observe_cancel_all(client);
+	zassert_equal(results[0].cancelled, 1, "Callback was not invoked with -ECANCELED");
+
+	err = golioth_connect(client, "127.0.0.1", SERVER_PORT);
+	zassert_ok(err, "Failed to connect: %d", err);
+
+	server_rx_none(K_MSEC(100));
+}
+
+/*
+ * Request pushed by thread, which still saw previous connection, is failed on reconnect instead of
+ * being sent over the new connection. Race is simulated by pretending to be connected while
+ * submitting. Request list lock is held until reconnected, so that the loop thread does not drain
+ * the request before that.
+ */
+ZTEST(coap_req, test_stale_submission_on_connect)
+{
+	int err;
+
+	coap_test_server_handler_set(server_handle_observe);
+
+	err = golioth_disconnect(client);
+	zassert_ok(err, "Failed to disconnect: %d", err);
+
+	k_mutex_lock(&client->coap_reqs_lock, K_FOREVER);
+
+	atomic_set(&client->coap_reqs_connected, true);
+	err = golioth_lightdb_get_cb(client, "counter", GOLIOTH_CONTENT_FORMAT_APP_JSON,
+				     result_cb, &results[0]);
+	atomic_clear(&client->coap_reqs_connected);
+
+	if (!err) {
+		err = golioth_connect(client, "127.0.0.1", SERVER_PORT);
+	}
+
+	k_mutex_unlock(&client->coap_reqs_lock);
+
+	zassert_ok(err, "Failed to submit or connect: %d", err);
+
+	err = k_sem_take(&rsp_sem, K_SECONDS(1));
+	zassert_ok(err, "Callback was not invoked");
+	zassert_equal(results[0].err, -ENETDOWN, "Unexpected error: %d", results[0].err);
+
+	server_rx_none(K_MSEC(100));
+}
+
+/*
+ * Requests are transmitted in order of their priority class, with at most
+ * CONFIG_GOLIOTH_COAP_REQ_MAX_IN_FLIGHT of them waiting for response. Server does not reply, so
+ * space in the window is made only by request, which missed its deadline.
+ */
+ZTEST(coap_req, test_in_flight_window)
+{
+	const struct golioth_req_opts opts[] = {
+		{
+			.priority = GOLIOTH_REQ_PRIORITY_BULK,
+			.ack_timeout_ms = 10 * MSEC_PER_SEC,
+		},
+		{
+			.priority = GOLIOTH_REQ_PRIORITY_INTERACTIVE,
+			.ack_timeout_ms = 10 * MSEC_PER_SEC,
+		},
+		{
+			.priority = GOLIOTH_REQ_PRIORITY_CONTROL,
+			.ack_timeout_ms = 10 * MSEC_PER_SEC,
+			.deadline_ms = 500,
+		},
+	};
+	const char *paths[] = { "bulk", "interactive", "control" };
+	struct server_rx *rx;
+	int err = 0;
+
+	coap_test_server_handler_set(server_record);
+
+	/* Submit all requests before any of them is scheduled */
+	k_mutex_lock(&client->coap_reqs_lock, K_FOREVER);
+
+	for (int i = 0; i < ARRAY_SIZE(opts) && !err; i++) {
+		err = golioth_lightdb_get_cb_opts(client, paths[i], GOLIOTH_CONTENT_FORMAT_APP_JSON,
+						  result_cb, &results[0], &opts[i]);
+	}
+
+	k_mutex_unlock(&client->coap_reqs_lock);
+
+	zassert_ok(err, "Failed to submit: %d", err);
+
+	rx = server_rx_wait();
+	zassert_equal(strcmp(rx->path, "control"), 0, "Unexpected first request: %s", rx->path);
+
+	rx = server_rx_wait();
+	zassert_equal(strcmp(rx->path, "interactive"), 0, "Unexpected second request: %s",
+		      rx->path);
+
+	/* Window is full */
+	server_rx_none(K_MSEC(250));
+
+	/* Control request missed its deadline, which makes space for bulk one */
+	err = k_sem_take(&rsp_sem, K_SECONDS(1));
+	zassert_ok(err, "Callback was not invoked");
+	zassert_equal(results[0].err, -ETIMEDOUT, "Unexpected error: %d", results[0].err);
+
+	rx = server_rx_wait();
+	zassert_equal(strcmp(rx->path, "bulk"), 0, "Unexpected third request: %s", rx->path);
+
+	/* Cancel requests left without response */
+	client_reconnect();
+}
+
+/*
+ * Request waiting for space in the in-flight window for longer than its whole retransmission span
+ * (10 ms + 20 ms here) is still transmitted once admitted, as its retransmission timeouts start
+ * only then.
+ */
+ZTEST(coap_req, test_in_flight_window_long_wait)
+{
+	const struct golioth_req_opts blocking_opts = {
+		.priority = GOLIOTH_REQ_PRIORITY_CONTROL,
+		.ack_timeout_ms = 10 * MSEC_PER_SEC,
+		.deadline_ms = 500,
+	};
+	const struct golioth_req_opts queued_opts = {
+		.ack_timeout_ms = 10,
+		.max_retries = 1,
+	};
+	struct server_rx *rx;
+	int err = 0;
+
+	coap_test_server_handler_set(server_record);
+
+	/* Fill the window with requests, which are never replied to */
+	for (int i = 0; i < CONFIG_GOLIOTH_COAP_REQ_MAX_IN_FLIGHT && !err; i++) {
+		err = golioth_lightdb_get_cb_opts(client, "blocking",
+						  GOLIOTH_CONTENT_FORMAT_APP_JSON,
+						  result_cb, &results[0], &blocking_opts);
+	}
+
+	zassert_ok(err, "Failed to submit: %d", err);
+
+	for (int i = 0; i < CONFIG_GOLIOTH_COAP_REQ_MAX_IN_FLIGHT; i++) {
+		rx = server_rx_wait();
+		zassert_equal(strcmp(rx->path, "blocking"), 0, "Unexpected request: %s", rx->path);
+	}
+
+	err = golioth_lightdb_get_cb_opts(client, "queued", GOLIOTH_CONTENT_FORMAT_APP_JSON,
+					  result_cb, &results[1], &queued_opts);
+	zassert_ok(err, "Failed to submit: %d", err);
+
+	server_rx_none(K_MSEC(250));
+
+	/* Blocking requests miss their deadline, queued one is transmitted */
+	rx = server_rx_wait();
+	zassert_equal(strcmp(rx->path, "queued"), 0, "Unexpected request: %s", rx->path);
+	zassert_equal(results[0].err, -ETIMEDOUT, "Unexpected error: %d", results[0].err);
+
+	/* Followed by single retransmission */
+	rx = server_rx_wait();
+	zassert_equal(strcmp(rx->path, "queued"), 0, "Unexpected request: %s", rx->path);
+
+	client_reconnect();
+}
+
+/*
+ * Shortest ACK timeout is used as is (too short to be randomized), while the one above
+ * GOLIOTH_REQ_ACK_TIMEOUT_MAX_MS is rejected.
+ */
+ZTEST(coap_req, test_ack_timeout_limits)
+{
+	const struct golioth_req_opts opts_min = {
+		.ack_timeout_ms = 1,
+		.max_retries = 2,
+	};
+	const struct golioth_req_opts opts_max = {
+		.ack_timeout_ms = GOLIOTH_REQ_ACK_TIMEOUT_MAX_MS + 1,
+	};
+	int err;
+
+	coap_test_server_handler_set(server_record);
+
+	err = golioth_lightdb_get_cb_opts(client, "counter", GOLIOTH_CONTENT_FORMAT_APP_JSON,
+					  result_cb, &results[0], &opts_max);
+	zassert_equal(err, -EINVAL, "Too long ACK timeout accepted: %d", err);
+
+	server_rx_none(K_MSEC(100));
+
+	err = golioth_lightdb_get_cb_opts(client, "counter", GOLIOTH_CONTENT_FORMAT_APP_JSON,
+					  result_cb, &results[0], &opts_min);
+	zassert_ok(err, "Failed to submit: %d", err);
+
+	/* Initial transmission and 2 retransmissions, then request times out */
+	for (int i = 0; i < 3; i++) {
+		(void)server_rx_wait();
+	}
+
+	err = k_sem_take(&rsp_sem, K_SECONDS(1));
+	zassert_ok(err, "Callback was not invoked");
+	zassert_equal(results[0].err, -ETIMEDOUT, "Unexpected error: %d", results[0].err);
+
+	server_rx_none(K_MSEC(100));
+}
+
+static void *coap_req_setup(void)
+{
+	int err;
+
+	err = coap_test_server_start(SERVER_PORT, server_stack, K_THREAD_STACK_SIZEOF(server_stack),
+				     THREAD_PRIO);
+	zassert_ok(err, "Failed to start server: %d", err);
+
+	golioth_init(client);
+	client->rx_buffer = rx_buffer;
+	client->rx_buffer_len = sizeof(rx_buffer);
+
+	err = golioth_set_proto_coap_udp(client);
+	zassert_ok(err, "Failed to set protocol: %d", err);
+
+	err = golioth_connect(client, "127.0.0.1", SERVER_PORT);
+	zassert_ok(err, "Failed to connect: %d", err);
+
+	err = golioth_test_loop_start(client, loop_stack, K_THREAD_STACK_SIZEOF(loop_stack),
+				      THREAD_PRIO);
+	zassert_ok(err, "Failed to start loop: %d", err);
+
+	return NULL;
+}
+
+static void coap_req_before(void *fixture)
+{
+	atomic_clear(&server_rx_count);
+	k_sem_reset(&server_rx_sem);
+	k_sem_reset(&rsp_sem);
+	memset(server_rx, 0, sizeof(server_rx));
+	memset(results, 0, sizeof(results));
+}
+
+static void coap_req_after(void *fixture)
+{
+	/* Drop observations without deregistration, server does not keep any state */
+	golioth_observe_cancel_all(client);
+
+	coap_test_server_handler_set(NULL);
+	coap_test_server_etag_set(NULL, 0);
+}
+
+ZTEST_SUITE(coap_req, NULL, coap_req_setup, coap_req_before, coap_req_after, NULL);
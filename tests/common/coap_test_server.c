@@ -0,0 +1,191 @@
+/*
+ * Copyright (c) 2023 Golioth, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <errno.h>
+#include <string.h>
+
+#include <zephyr/kernel.h>
+#include <zephyr/net/socket.h>
+
+#include "coap_test_server.h"
+
+#include <zephyr/logging/log.h>
+LOG_MODULE_REGISTER(coap_test_server);
+
+#define SERVER_BUF_SIZE		256
+
+static struct k_thread server_thread;
+static int server_sock = -1;
+
+static coap_test_server_handler_t server_handler;
+static struct sockaddr server_peer;
+static socklen_t server_peer_len;
+
+/* ETag option is at most 8 bytes long */
+static uint8_t server_etag[8];
+static uint8_t server_etag_len;
+
+static void server_main(void *arg1, void *arg2, void *arg3)
+{
+	struct coap_packet request;
+	struct sockaddr addr;
+	socklen_t addrlen;
+	coap_test_server_handler_t handler;
+	uint8_t buf[SERVER_BUF_SIZE];
+	ssize_t len;
+	int err;
+
+	while (true) {
+		addrlen = sizeof(addr);
+		len = zsock_recvfrom(server_sock, buf, sizeof(buf), 0, &addr, &addrlen);
+		if (len <= 0) {
+			continue;
+		}
+
+		err = coap_packet_parse(&request, buf, len, NULL, 0);
+		if (err) {
+			LOG_WRN("Failed to parse request: %d", err);
+			continue;
+		}
+
+		server_peer = addr;
+		server_peer_len = addrlen;
+
+		handler = server_handler;
+		if (handler) {
+			handler(&request);
+		}
+	}
+}
+
+int coap_test_server_start(uint16_t port, k_thread_stack_t *stack, size_t stack_size, int prio)
+{
+	struct sockaddr_in addr = {
+		.sin_family = AF_INET,
+		.sin_port = htons(port),
+		.sin_addr = INADDR_LOOPBACK_INIT,
+	};
+	int err;
+
+	if (server_sock >= 0) {
+		return -EALREADY;
+	}
+
+	server_sock = zsock_socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+	if (server_sock < 0) {
+		return -errno;
+	}
+
+	err = zsock_bind(server_sock, (struct sockaddr *)&addr, sizeof(addr));
+	if (err) {
+		err = -errno;
+		zsock_close(server_sock);
+		server_sock = -1;
+		return err;
+	}
+
+	k_thread_create(&server_thread, stack, stack_size, server_main, NULL, NULL, NULL,
+			prio, 0, K_NO_WAIT);
+	k_thread_name_set(&server_thread, "coap_test_server");
+
+	return 0;
+}
+
+void coap_test_server_handler_set(coap_test_server_handler_t handler)
+{
+	server_handler = handler;
+}
+
+void coap_test_server_etag_set(const uint8_t *etag, uint8_t etag_len)
+{
+	server_etag_len = etag ? MIN(etag_len, sizeof(server_etag)) : 0;
+	if (server_etag_len) {
+		memcpy(server_etag, etag, server_etag_len);
+	}
+}
+
+int coap_test_server_sock(void)
+{
+	return server_sock;
+}
+
+const struct sockaddr *coap_test_server_peer(void)
+{
+	return &server_peer;
+}
+
+int coap_test_server_send(uint8_t type, uint8_t code, uint16_t id,
+			  const uint8_t *token, uint8_t tkl,
+			  int observe, int block2,
+			  const uint8_t *payload, uint16_t payload_len)
+{
+	struct coap_packet packet;
+	uint8_t buf[SERVER_BUF_SIZE];
+	int err;
+
+	err = coap_packet_init(&packet, buf, sizeof(buf), COAP_VERSION_1, type, tkl, token,
+			       code, id);
+	if (err) {
+		LOG_ERR("Failed to init response: %d", err);
+		return err;
+	}
+
+	if (server_etag_len) {
+		err = coap_packet_append_option(&packet, COAP_OPTION_ETAG, server_etag,
+						server_etag_len);
+		if (err) {
+			LOG_ERR("Failed to append ETag: %d", err);
+			return err;
+		}
+	}
+
+	if (observe >= 0) {
+		err = coap_append_option_int(&packet, COAP_OPTION_OBSERVE, observe);
+		if (err) {
+			LOG_ERR("Failed to append Observe: %d", err);
+			return err;
+		}
+	}
+
+	if (block2 >= 0) {
+		err = coap_append_option_int(&packet, COAP_OPTION_BLOCK2, block2);
+		if (err) {
+			LOG_ERR("Failed to append Block2: %d", err);
+			return err;
+		}
+	}
+
+	if (payload_len) {
+		err = coap_packet_append_payload_marker(&packet);
+		if (!err) {
+			err = coap_packet_append_payload(&packet, payload, payload_len);
+		}
+		if (err) {
+			LOG_ERR("Failed to append payload: %d", err);
+			return err;
+		}
+	}
+
+	if (zsock_sendto(server_sock, packet.data, packet.offset, 0,
+			 &server_peer, server_peer_len) < 0) {
+		err = -errno;
+		LOG_ERR("Failed to send response: %d", err);
+		return err;
+	}
+
+	return 0;
+}
+
+int coap_test_server_reply(const struct coap_packet *request, uint8_t code,
+			   int observe, int block2,
+			   const uint8_t *payload, uint16_t payload_len)
+{
+	uint8_t token[COAP_TOKEN_MAX_LEN];
+	uint8_t tkl = coap_header_get_token(request, token);
+
+	return coap_test_server_send(COAP_TYPE_ACK, code, coap_header_get_id(request),
+				     token, tkl, observe, block2, payload, payload_len);
+}
@@ -0,0 +1,112 @@
+/*
+ * Copyright (c) 2023 Golioth, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef GOLIOTH_TESTS_COMMON_COAP_TEST_SERVER_H_
+#define GOLIOTH_TESTS_COMMON_COAP_TEST_SERVER_H_
+
+#include <zephyr/kernel.h>
+#include <zephyr/net/coap.h>
+
+/**
+ * @brief Handler of requests received by test server
+ *
+ * Invoked from server thread for each parsed datagram.
+ */
+typedef void (*coap_test_server_handler_t)(const struct coap_packet *request);
+
+/**
+ * @brief Start minimal CoAP server on loopback interface
+ *
+ * Test-only server (tests/common/coap_test_server.c linked into test application). It binds UDP
+ * socket to 127.0.0.1:@p port and passes received requests to the handler set with
+ * coap_test_server_handler_set(). Requests are dropped when there is no handler. Responses are
+ * sent to the sender of last received request.
+ *
+ * Only single server is supported.
+ *
+ * @param port UDP port to bind to
+ * @param stack Stack of server thread
+ * @param stack_size Size of @p stack, as returned by K_THREAD_STACK_SIZEOF()
+ * @param prio Priority of server thread
+ *
+ * @retval 0 On success
+ * @retval <0 On failure
+ */
+int coap_test_server_start(uint16_t port, k_thread_stack_t *stack, size_t stack_size, int prio);
+
+/**
+ * @brief Set handler of received requests
+ *
+ * @param handler Handler, NULL to drop all requests
+ */
+void coap_test_server_handler_set(coap_test_server_handler_t handler);
+
+/**
+ * @brief Set ETag of responses
+ *
+ * ETag option is added to all following responses sent with coap_test_server_send() or
+ * coap_test_server_reply().
+ *
+ * @param etag ETag, NULL to send responses without ETag
+ * @param etag_len Length of @p etag
+ */
+void coap_test_server_etag_set(const uint8_t *etag, uint8_t etag_len);
+
+/**
+ * @brief Get server socket, e.g. for applying impairments
+ *
+ * @return Socket descriptor, or -1 when server is not started
+ */
+int coap_test_server_sock(void);
+
+/**
+ * @brief Get sender of last received request
+ *
+ * Meant to be called from request handler, e.g. to tell clients apart by source port.
+ *
+ * @return Address of sender
+ */
+const struct sockaddr *coap_test_server_peer(void);
+
+/**
+ * @brief Send message to the sender of last received request
+ *
+ * @param type Message type (COAP_TYPE_*)
+ * @param code Message code (e.g. COAP_RESPONSE_CODE_CONTENT)
+ * @param id Message ID
+ * @param token Token
+ * @param tkl Token length
+ * @param observe Value of Observe option, or negative value to skip it
+ * @param block2 Value of Block2 option, or negative value to skip it
+ * @param payload Payload
+ * @param payload_len Length of @p payload, 0 for no payload
+ *
+ * @retval 0 On success
+ * @retval <0 On failure
+ */
+int coap_test_server_send(uint8_t type, uint8_t code, uint16_t id,
+			  const uint8_t *token, uint8_t tkl,
+			  int observe, int block2,
+			  const uint8_t *payload, uint16_t payload_len);
+
+/**
+ * @brief Send piggybacked (ACK) response to request
+ *
+ * @param request Received request
+ * @param code Response code
+ * @param observe Value of Observe option, or negative value to skip it
+ * @param block2 Value of Block2 option, or negative value to skip it
+ * @param payload Payload
+ * @param payload_len Length of @p payload, 0 for no payload
+ *
+ * @retval 0 On success
+ * @retval <0 On failure
+ */
+int coap_test_server_reply(const struct coap_packet *request, uint8_t code,
+			   int observe, int block2,
+			   const uint8_t *payload, uint16_t payload_len);
+
+#endif /* GOLIOTH_TESTS_COMMON_COAP_TEST_SERVER_H_ */
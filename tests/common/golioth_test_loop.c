@@ -0,0 +1,99 @@
+/*
+ * Copyright (c) 2023 Golioth, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <string.h>
+
+#include <zephyr/kernel.h>
+#include <zephyr/net/socket.h>
+#include <zephyr/posix/sys/eventfd.h>
+
+#include "golioth_test_loop.h"
+
+static struct golioth_client *loop_client;
+static struct k_thread loop_thread;
+static int loop_eventfd = -1;
+static struct golioth_test_loop_stats loop_stats;
+
+static void loop_wakeup(struct golioth_client *client)
+{
+	eventfd_write(loop_eventfd, 1);
+}
+
+static void loop_main(void *arg1, void *arg2, void *arg3)
+{
+	struct golioth_client *client = arg1;
+	struct zsock_pollfd fds[2] = {
+		{ .fd = -1, .events = ZSOCK_POLLIN },
+		{ .fd = loop_eventfd, .events = ZSOCK_POLLIN },
+	};
+	eventfd_t eventfd_value;
+	int64_t timeout;
+	uint32_t start, cycles;
+	int ret;
+
+	while (true) {
+		golioth_poll_prepare(client, k_uptime_get(), &fds[0].fd, &timeout);
+
+		ret = zsock_poll(fds, ARRAY_SIZE(fds), MIN(timeout, 1000));
+		if (ret < 0) {
+			k_sleep(K_MSEC(10));
+			continue;
+		}
+
+		if (fds[1].revents) {
+			(void)eventfd_read(loop_eventfd, &eventfd_value);
+		}
+
+		if (fds[0].revents) {
+			start = k_cycle_get_32();
+			ret = golioth_process_rx(client);
+			cycles = k_cycle_get_32() - start;
+
+			if (ret == 0) {
+				loop_stats.rx_calls++;
+				loop_stats.rx_cycles += cycles;
+				loop_stats.rx_cycles_max = MAX(loop_stats.rx_cycles_max, cycles);
+			}
+		}
+	}
+}
+
+int golioth_test_loop_start(struct golioth_client *client, k_thread_stack_t *stack,
+			    size_t stack_size, int prio)
+{
+	if (loop_client) {
+		return -EALREADY;
+	}
+
+	loop_eventfd = eventfd(0, EFD_NONBLOCK);
+	if (loop_eventfd < 0) {
+		return -errno;
+	}
+
+	loop_client = client;
+	client->wakeup = loop_wakeup;
+
+	k_thread_create(&loop_thread, stack, stack_size, loop_main, client, NULL, NULL,
+			prio, 0, K_NO_WAIT);
+	k_thread_name_set(&loop_thread, "golioth_test_loop");
+
+	return 0;
+}
+
+struct k_thread *golioth_test_loop_thread(void)
+{
+	return &loop_thread;
+}
+
+void golioth_test_loop_stats_get(struct golioth_test_loop_stats *stats)
+{
+	*stats = loop_stats;
+}
+
+void golioth_test_loop_stats_reset(void)
+{
+	memset(&loop_stats, 0, sizeof(loop_stats));
+}
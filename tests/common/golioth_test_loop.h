@@ -0,0 +1,65 @@
+/*
+ * Copyright (c) 2023 Golioth, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef GOLIOTH_TESTS_COMMON_GOLIOTH_TEST_LOOP_H_
+#define GOLIOTH_TESTS_COMMON_GOLIOTH_TEST_LOOP_H_
+
+#include <net/golioth.h>
+#include <zephyr/kernel.h>
+
+/**
+ * @brief Statistics of golioth_process_rx() calls made by test loop
+ */
+struct golioth_test_loop_stats {
+	/** Number of golioth_process_rx() calls, which succeeded */
+	uint32_t rx_calls;
+	/** Sum of cycles spent in successful golioth_process_rx() calls */
+	uint64_t rx_cycles;
+	/** Longest successful golioth_process_rx() call in cycles */
+	uint32_t rx_cycles_max;
+};
+
+/**
+ * @brief Start thread driving Golioth client
+ *
+ * Test-only replacement of system client (tests/common/golioth_test_loop.c linked into test
+ * application). Thread polls client socket together with an eventfd signalled by client wakeup
+ * callback, processes received data and lets client send or retransmit requests. There is no
+ * reconnect logic, so client needs to be connected by test.
+ *
+ * Only single client is supported.
+ *
+ * @param client Initialized client instance
+ * @param stack Stack of loop thread
+ * @param stack_size Size of @p stack, as returned by K_THREAD_STACK_SIZEOF()
+ * @param prio Priority of loop thread
+ *
+ * @retval 0 On success
+ * @retval <0 On failure
+ */
+int golioth_test_loop_start(struct golioth_client *client, k_thread_stack_t *stack,
+			    size_t stack_size, int prio);
+
+/**
+ * @brief Get loop thread
+ *
+ * @return Loop thread, e.g. for checking its stack usage
+ */
+struct k_thread *golioth_test_loop_thread(void);
+
+/**
+ * @brief Get statistics of golioth_process_rx() calls
+ *
+ * @param stats Statistics to be filled
+ */
+void golioth_test_loop_stats_get(struct golioth_test_loop_stats *stats);
+
+/**
+ * @brief Reset statistics of golioth_process_rx() calls
+ */
+void golioth_test_loop_stats_reset(void);
+
+#endif /* GOLIOTH_TESTS_COMMON_GOLIOTH_TEST_LOOP_H_ */
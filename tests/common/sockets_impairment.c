@@ -0,0 +1,510 @@
+/*
+ * Copyright (c) 2023 Golioth, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <zephyr/logging/log.h>
+#include <zephyr/net/socket.h>
+
+#include "sockets_internal.h"
+#include "sockets_impairment.h"
+
+LOG_MODULE_REGISTER(net_sock_impairment, LOG_LEVEL_INF);
+
+/*
+ * Socket shim, which injects network impairments (loss, duplication, reordering, delay and
+ * truncation) into datagrams sent over UDP sockets. It registers with higher priority than native
+ * sockets, creates the native socket underneath and forwards all calls to it. Delayed datagrams are
+ * kept in a static pool and sent from system workqueue.
+ *
+ * Intended for tests only.
+ */
+
+#define IMPAIRMENT_SOCKET_PRIORITY	10
+#define IMPAIRMENT_CONTEXT_MAX		4
+#define IMPAIRMENT_DELAYED_MAX		32
+#define IMPAIRMENT_DGRAM_MAX		1280
+
+__net_socket struct impairment_context {
+	int fd;
+	bool is_used;
+	uint32_t rng;
+	struct sockets_impairment_config config;
+	struct sockets_impairment_stats stats;
+};
+
+struct impairment_delayed {
+	struct k_work_delayable work;
+	struct impairment_context *ctx;
+	bool is_used;
+	struct sockaddr addr;
+	socklen_t addrlen;
+	size_t len;
+	uint8_t buf[IMPAIRMENT_DGRAM_MAX];
+};
+
+static struct impairment_context impairment_contexts[IMPAIRMENT_CONTEXT_MAX];
+static struct impairment_delayed impairment_delayed[IMPAIRMENT_DELAYED_MAX];
+
+static K_MUTEX_DEFINE(impairment_lock);
+
+static const struct socket_op_vtable impairment_fd_op_vtable;
+
+static int impairment_create(int family, int type, int proto);
+
+static ssize_t impairment_sendto_vmeth(void *obj, const void *buf, size_t len, int flags,
+				       const struct sockaddr *addr, socklen_t addrlen);
+
+static ssize_t impairment_recvfrom_vmeth(void *obj, void *buf, size_t max_len, int flags,
+					 struct sockaddr *addr, socklen_t *addrlen);
+
+/* xorshift32, so that impairments are reproducible for given seed */
+static uint32_t impairment_rand(struct impairment_context *ctx)
+{
+	uint32_t x = ctx->rng;
+
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+
+	ctx->rng = x;
+
+	return x;
+}
+
+static bool impairment_hit(struct impairment_context *ctx, uint8_t pct)
+{
+	if (!pct) {
+		return false;
+	}
+
+	return (impairment_rand(ctx) % 100) < pct;
+}
+
+static void impairment_delayed_handler(struct k_work *work)
+{
+	struct k_work_delayable *dwork = k_work_delayable_from_work(work);
+	struct impairment_delayed *delayed =
+		CONTAINER_OF(dwork, struct impairment_delayed, work);
+	ssize_t ret;
+
+	ret = zsock_sendto(delayed->ctx->fd, delayed->buf, delayed->len, 0,
+			   delayed->addrlen ? &delayed->addr : NULL, delayed->addrlen);
+	if (ret < 0) {
+		LOG_WRN("Failed to send delayed datagram: %d", errno);
+	}
+
+	(void)k_mutex_lock(&impairment_lock, K_FOREVER);
+	delayed->is_used = false;
+	k_mutex_unlock(&impairment_lock);
+}
+
+static int impairment_send_delayed(struct impairment_context *ctx, const void *buf, size_t len,
+				   const struct sockaddr *addr, socklen_t addrlen,
+				   uint32_t delay_ms)
+{
+	struct impairment_delayed *delayed = NULL;
+
+	if (len > IMPAIRMENT_DGRAM_MAX || addrlen > sizeof(delayed->addr)) {
+		errno = EMSGSIZE;
+		return -1;
+	}
+
+	(void)k_mutex_lock(&impairment_lock, K_FOREVER);
+
+	for (int i = 0; i < ARRAY_SIZE(impairment_delayed); i++) {
+		if (!impairment_delayed[i].is_used) {
+			delayed = &impairment_delayed[i];
+			delayed->is_used = true;
+			break;
+		}
+	}
+
+	k_mutex_unlock(&impairment_lock);
+
+	if (!delayed) {
+		errno = ENOBUFS;
+		return -1;
+	}
+
+	delayed->ctx = ctx;
+	delayed->len = len;
+	memcpy(delayed->buf, buf, len);
+
+	if (addr) {
+		memcpy(&delayed->addr, addr, addrlen);
+		delayed->addrlen = addrlen;
+	} else {
+		delayed->addrlen = 0;
+	}
+
+	k_work_schedule(&delayed->work, K_MSEC(delay_ms));
+
+	return 0;
+}
+
+static int impairment_socket(int family, int type, int proto)
+{
+	STRUCT_SECTION_FOREACH(net_socket_register, sock_family) {
+		/* Ignore shim itself */
+		if (sock_family->handler == impairment_create) {
+			continue;
+		}
+
+		if (sock_family->family != family &&
+		    sock_family->family != AF_UNSPEC) {
+			continue;
+		}
+
+		NET_ASSERT(sock_family->is_supported);
+
+		if (!sock_family->is_supported(family, type, proto)) {
+			continue;
+		}
+
+		return sock_family->handler(family, type, proto);
+	}
+
+	errno = EAFNOSUPPORT;
+	return -1;
+}
+
+static ssize_t impairment_read_vmeth(void *obj, void *buffer, size_t count)
+{
+	return impairment_recvfrom_vmeth(obj, buffer, count, 0, NULL, 0);
+}
+
+static ssize_t impairment_write_vmeth(void *obj, const void *buffer, size_t count)
+{
+	return impairment_sendto_vmeth(obj, buffer, count, 0, NULL, 0);
+}
+
+static int impairment_ioctl_vmeth(void *obj, unsigned int request, va_list args)
+{
+	struct impairment_context *ctx = obj;
+	const struct fd_op_vtable *vtable;
+	struct k_mutex *lock;
+	void *wrapped_obj;
+	int ret;
+
+	/* Forward everything, including poll() related requests, to native socket */
+	wrapped_obj = z_get_fd_obj_and_vtable(ctx->fd, &vtable, &lock);
+	if (!wrapped_obj) {
+		return -1;
+	}
+
+	if (lock) {
+		k_mutex_lock(lock, K_FOREVER);
+	}
+
+	ret = vtable->ioctl(wrapped_obj, request, args);
+
+	if (lock) {
+		k_mutex_unlock(lock);
+	}
+
+	return ret;
+}
+
+static int impairment_shutdown_vmeth(void *obj, int how)
+{
+	struct impairment_context *ctx = obj;
+
+	return zsock_shutdown(ctx->fd, how);
+}
+
+static int impairment_bind_vmeth(void *obj, const struct sockaddr *addr, socklen_t addrlen)
+{
+	struct impairment_context *ctx = obj;
+
+	return zsock_bind(ctx->fd, addr, addrlen);
+}
+
+static int impairment_connect_vmeth(void *obj, const struct sockaddr *addr, socklen_t addrlen)
+{
+	struct impairment_context *ctx = obj;
+
+	return zsock_connect(ctx->fd, addr, addrlen);
+}
+
+static int impairment_listen_vmeth(void *obj, int backlog)
+{
+	struct impairment_context *ctx = obj;
+
+	return zsock_listen(ctx->fd, backlog);
+}
+
+static int impairment_accept_vmeth(void *obj, struct sockaddr *addr, socklen_t *addrlen)
+{
+	struct impairment_context *ctx = obj;
+
+	return zsock_accept(ctx->fd, addr, addrlen);
+}
+
+static ssize_t impairment_sendto_vmeth(void *obj, const void *buf, size_t len, int flags,
+				       const struct sockaddr *addr, socklen_t addrlen)
+{
+	struct impairment_context *ctx = obj;
+	struct sockets_impairment_config config;
+	size_t send_len = len;
+	bool duplicate;
+	bool reorder;
+	uint32_t delay_ms;
+	ssize_t ret;
+
+	(void)k_mutex_lock(&impairment_lock, K_FOREVER);
+
+	config = ctx->config;
+
+	if (config.mtu && send_len > config.mtu) {
+		send_len = config.mtu;
+		ctx->stats.truncated++;
+	}
+
+	if (impairment_hit(ctx, config.loss_pct)) {
+		ctx->stats.dropped++;
+		k_mutex_unlock(&impairment_lock);
+
+		/* Dropped by "network", so sender does not know about it */
+		return len;
+	}
+
+	duplicate = impairment_hit(ctx, config.dup_pct);
+	reorder = impairment_hit(ctx, config.reorder_pct);
+
+	ctx->stats.sent++;
+	if (duplicate) {
+		ctx->stats.duplicated++;
+	}
+	if (reorder) {
+		ctx->stats.reordered++;
+	}
+
+	k_mutex_unlock(&impairment_lock);
+
+	delay_ms = config.delay_ms + (reorder ? config.reorder_delay_ms : 0);
+
+	for (int i = 0; i < (duplicate ? 2 : 1); i++) {
+		if (delay_ms) {
+			ret = impairment_send_delayed(ctx, buf, send_len, addr, addrlen, delay_ms);
+		} else {
+			ret = zsock_sendto(ctx->fd, buf, send_len, flags, addr, addrlen);
+		}
+
+		if (ret < 0) {
+			return ret;
+		}
+	}
+
+	return len;
+}
+
+static ssize_t impairment_sendmsg_vmeth(void *obj, const struct msghdr *msg, int flags)
+{
+	struct impairment_context *ctx = obj;
+
+	/* Not used by Golioth client, so forwarded without impairments */
+	return zsock_sendmsg(ctx->fd, msg, flags);
+}
+
+static ssize_t impairment_recvfrom_vmeth(void *obj, void *buf, size_t max_len, int flags,
+					 struct sockaddr *addr, socklen_t *addrlen)
+{
+	struct impairment_context *ctx = obj;
+
+	return zsock_recvfrom(ctx->fd, buf, max_len, flags, addr, addrlen);
+}
+
+static int impairment_getsockopt_vmeth(void *obj, int level, int optname,
+				       void *optval, socklen_t *optlen)
+{
+	struct impairment_context *ctx = obj;
+
+	return zsock_getsockopt(ctx->fd, level, optname, optval, optlen);
+}
+
+static int impairment_setsockopt_vmeth(void *obj, int level, int optname,
+				       const void *optval, socklen_t optlen)
+{
+	struct impairment_context *ctx = obj;
+
+	return zsock_setsockopt(ctx->fd, level, optname, optval, optlen);
+}
+
+static int impairment_close_vmeth(void *obj)
+{
+	struct impairment_context *ctx = obj;
+	struct k_work_sync sync;
+
+	/* Drop datagrams, which are still delayed */
+	for (int i = 0; i < ARRAY_SIZE(impairment_delayed); i++) {
+		struct impairment_delayed *delayed = &impairment_delayed[i];
+
+		if (!delayed->is_used || delayed->ctx != ctx) {
+			continue;
+		}
+
+		k_work_cancel_delayable_sync(&delayed->work, &sync);
+
+		(void)k_mutex_lock(&impairment_lock, K_FOREVER);
+		delayed->is_used = false;
+		k_mutex_unlock(&impairment_lock);
+	}
+
+	zsock_close(ctx->fd);
+
+	(void)k_mutex_lock(&impairment_lock, K_FOREVER);
+	ctx->fd = -1;
+	ctx->is_used = false;
+	k_mutex_unlock(&impairment_lock);
+
+	return 0;
+}
+
+static int impairment_getpeername_vmeth(void *obj, struct sockaddr *addr, socklen_t *addrlen)
+{
+	struct impairment_context *ctx = obj;
+
+	return zsock_getpeername(ctx->fd, addr, addrlen);
+}
+
+static int impairment_getsockname_vmeth(void *obj, struct sockaddr *addr, socklen_t *addrlen)
+{
+	struct impairment_context *ctx = obj;
+
+	return zsock_getsockname(ctx->fd, addr, addrlen);
+}
+
+static const struct socket_op_vtable impairment_fd_op_vtable = {
+	.fd_vtable = {
+		.read = impairment_read_vmeth,
+		.write = impairment_write_vmeth,
+		.close = impairment_close_vmeth,
+		.ioctl = impairment_ioctl_vmeth,
+	},
+	.shutdown = impairment_shutdown_vmeth,
+	.bind = impairment_bind_vmeth,
+	.connect = impairment_connect_vmeth,
+	.listen = impairment_listen_vmeth,
+	.accept = impairment_accept_vmeth,
+	.sendto = impairment_sendto_vmeth,
+	.sendmsg = impairment_sendmsg_vmeth,
+	.recvfrom = impairment_recvfrom_vmeth,
+	.getsockopt = impairment_getsockopt_vmeth,
+	.setsockopt = impairment_setsockopt_vmeth,
+	.getpeername = impairment_getpeername_vmeth,
+	.getsockname = impairment_getsockname_vmeth,
+};
+
+static int impairment_create(int family, int type, int proto)
+{
+	struct impairment_context *ctx = NULL;
+	int fd;
+
+	fd = impairment_socket(family, type, proto);
+	if (fd < 0) {
+		return fd;
+	}
+
+	(void)k_mutex_lock(&impairment_lock, K_FOREVER);
+
+	for (int i = 0; i < ARRAY_SIZE(impairment_contexts); i++) {
+		if (!impairment_contexts[i].is_used) {
+			ctx = &impairment_contexts[i];
+			break;
+		}
+	}
+
+	if (!ctx) {
+		errno = ENOMEM;
+		goto unlock_and_close;
+	}
+
+	memset(ctx, 0, sizeof(*ctx));
+	ctx->is_used = true;
+	ctx->fd = fd;
+	ctx->rng = 1;
+
+	fd = z_reserve_fd();
+	if (fd < 0) {
+		fd = ctx->fd;
+		ctx->is_used = false;
+		goto unlock_and_close;
+	}
+
+	LOG_DBG("wrapping fd %d as %d", ctx->fd, fd);
+
+	z_finalize_fd(fd, ctx, (const struct fd_op_vtable *)&impairment_fd_op_vtable);
+
+	k_mutex_unlock(&impairment_lock);
+
+	return fd;
+
+unlock_and_close:
+	k_mutex_unlock(&impairment_lock);
+
+	zsock_close(fd);
+
+	return -1;
+}
+
+static bool is_supported(int family, int type, int proto)
+{
+	/* Plain UDP only, DTLS sockets need to be impaired below (D)TLS layer */
+	return type == SOCK_DGRAM && (proto == 0 || proto == IPPROTO_UDP);
+}
+
+NET_SOCKET_REGISTER(sockets_impairment, IMPAIRMENT_SOCKET_PRIORITY, AF_UNSPEC, is_supported,
+		    impairment_create);
+
+static struct impairment_context *impairment_context_get(int fd)
+{
+	return z_get_fd_obj(fd, (const struct fd_op_vtable *)&impairment_fd_op_vtable, EBADF);
+}
+
+int sockets_impairment_set(int fd, const struct sockets_impairment_config *config)
+{
+	struct impairment_context *ctx = impairment_context_get(fd);
+
+	if (!ctx) {
+		return -EBADF;
+	}
+
+	(void)k_mutex_lock(&impairment_lock, K_FOREVER);
+
+	ctx->config = *config;
+	/* xorshift32 state must not be zero */
+	ctx->rng = config->seed ? config->seed : 1;
+	memset(&ctx->stats, 0, sizeof(ctx->stats));
+
+	k_mutex_unlock(&impairment_lock);
+
+	return 0;
+}
+
+int sockets_impairment_stats_get(int fd, struct sockets_impairment_stats *stats)
+{
+	struct impairment_context *ctx = impairment_context_get(fd);
+
+	if (!ctx) {
+		return -EBADF;
+	}
+
+	(void)k_mutex_lock(&impairment_lock, K_FOREVER);
+	*stats = ctx->stats;
+	k_mutex_unlock(&impairment_lock);
+
+	return 0;
+}
+
+static int impairment_init(void)
+{
+	for (int i = 0; i < ARRAY_SIZE(impairment_delayed); i++) {
+		k_work_init_delayable(&impairment_delayed[i].work, impairment_delayed_handler);
+	}
+
+	return 0;
+}
+
+SYS_INIT(impairment_init, APPLICATION, 0);
@@ -0,0 +1,81 @@
+/*
+ * Copyright (c) 2023 Golioth, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef GOLIOTH_TESTS_COMMON_SOCKETS_IMPAIRMENT_H_
+#define GOLIOTH_TESTS_COMMON_SOCKETS_IMPAIRMENT_H_
+
+#include <stdint.h>
+
+/**
+ * @brief Impairments applied to datagrams sent over a socket
+ *
+ * Test-only socket shim (sockets_impairment.c linked into test application) wraps every UDP socket
+ * created by application, so impairments can be configured on both client and (local, in-test)
+ * server sockets, covering both directions of traffic. Impairments are applied to datagrams sent
+ * with send() and sendto().
+ *
+ * Only plain UDP sockets are wrapped, so Golioth client needs to use plain CoAP over UDP (see
+ * CONFIG_GOLIOTH_PROTO_COAP_UDP) for its traffic to be impaired.
+ *
+ * All random decisions are made with a per-socket generator seeded with @a seed, so results are
+ * reproducible.
+ *
+ * Zero-initialized structure means no impairments.
+ */
+struct sockets_impairment_config {
+	/** Seed of random generator */
+	uint32_t seed;
+	/** Probability (in percent) of dropping datagram */
+	uint8_t loss_pct;
+	/** Probability (in percent) of sending datagram twice */
+	uint8_t dup_pct;
+	/** Probability (in percent) of delaying datagram by additional @a reorder_delay_ms */
+	uint8_t reorder_pct;
+	/** Delay of every datagram in milliseconds */
+	uint32_t delay_ms;
+	/** Additional delay of reordered datagrams in milliseconds */
+	uint32_t reorder_delay_ms;
+	/** Datagrams longer than this are truncated (0 means no truncation) */
+	uint16_t mtu;
+};
+
+/**
+ * @brief Statistics of impairments applied to a socket
+ */
+struct sockets_impairment_stats {
+	uint32_t sent;
+	uint32_t dropped;
+	uint32_t duplicated;
+	uint32_t reordered;
+	uint32_t truncated;
+};
+
+/**
+ * @brief Configure impairments of socket
+ *
+ * Resets random generator with seed from @p config and clears statistics.
+ *
+ * @param fd UDP socket created by application
+ *
+ * @param config Impairments to be applied to datagrams sent from now on
+ *
+ * @retval 0 On success
+ * @retval -EBADF @a fd is not wrapped by shim
+ */
+int sockets_impairment_set(int fd, const struct sockets_impairment_config *config);
+
+/**
+ * @brief Get statistics of socket impairments
+ *
+ * @param fd UDP socket created by application
+ * @param stats Statistics to be filled
+ *
+ * @retval 0 On success
+ * @retval -EBADF @a fd is not wrapped by shim
+ */
+int sockets_impairment_stats_get(int fd, struct sockets_impairment_stats *stats);
+
+#endif /* GOLIOTH_TESTS_COMMON_SOCKETS_IMPAIRMENT_H_ */
@@ -0,0 +1,286 @@
+/*
+ * Copyright (c) 2023 Golioth, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <zephyr/logging/log.h>
+LOG_MODULE_REGISTER(footprint, LOG_LEVEL_INF);
+
+#include <net/golioth.h>
+#include <net/golioth/fw.h>
+#include <net/golioth/metrics.h>
+#include <net/golioth/rpc.h>
+#include <net/golioth/settings.h>
+#include <net/golioth/system_client.h>
+#include <zephyr/debug/thread_analyzer.h>
+#include <zephyr/kernel.h>
+
+#if defined(CONFIG_GOLIOTH_SAMPLES_COMMON)
+#include <samples/common/net_connect.h>
+#endif
+
+#if !defined(CONFIG_GOLIOTH_SYSTEM_CLIENT)
+#include "golioth_test_loop.h"
+#endif
+
+/*
+ * Application used for measuring memory footprint of Golioth library with various feature sets
+ * (see scripts/footprint_report.py).
+ *
+ * Each enabled feature is used, so that its code is not garbage collected by linker. After
+ * connecting, standard workload is executed: FOOTPRINT_ITERATIONS of LightDB State set, LightDB
+ * State get and LightDB Stream push, with at most FOOTPRINT_WINDOW requests in flight. Then peak
+ * heap used by requests (from client metrics) and stack usage of all threads are printed.
+ */
+
+#define ITERATIONS	CONFIG_FOOTPRINT_ITERATIONS
+#define WINDOW		CONFIG_FOOTPRINT_WINDOW
+
+#if defined(CONFIG_GOLIOTH_SYSTEM_CLIENT)
+
+static struct golioth_client *client = GOLIOTH_SYSTEM_CLIENT_GET();
+
+#else /* CONFIG_GOLIOTH_SYSTEM_CLIENT */
+
+#define LOOP_STACK_SIZE	3072
+#define LOOP_PRIO	K_PRIO_PREEMPT(5)
+
+static struct golioth_client _client;
+static struct golioth_client *client = &_client;
+static uint8_t rx_buffer[CONFIG_FOOTPRINT_RX_BUFFER_SIZE];
+static sec_tag_t sec_tag_list[] = { CONFIG_FOOTPRINT_SEC_TAG };
+
+static K_THREAD_STACK_DEFINE(loop_stack, LOOP_STACK_SIZE);
+
+#endif /* CONFIG_GOLIOTH_SYSTEM_CLIENT */
+
+static K_SEM_DEFINE(connected, 0, 1);
+static K_SEM_DEFINE(window_sem, WINDOW, WINDOW);
+static atomic_t completed;
+static atomic_t errors;
+
+#if defined(CONFIG_GOLIOTH_RPC)
+static enum golioth_rpc_status on_footprint(zcbor_state_t *request_params_array,
+					    zcbor_state_t *response_detail_map,
+					    void *callback_arg)
+{
+	return GOLIOTH_RPC_OK;
+}
+#endif
+
+#if defined(CONFIG_GOLIOTH_SETTINGS)
+static enum golioth_settings_status on_setting(const char *key,
+					       const struct golioth_settings_value *value)
+{
+	LOG_INF("Setting %s", key);
+
+	return GOLIOTH_SETTINGS_SUCCESS;
+}
+#endif
+
+#if defined(CONFIG_GOLIOTH_FW)
+static int fw_desired_cb(struct golioth_req_rsp *rsp)
+{
+	if (rsp->err) {
+		LOG_WRN("Failed to receive desired firmware: %d", rsp->err);
+	}
+
+	return 0;
+}
+#endif
+
+static int observe_cb(struct golioth_req_rsp *rsp)
+{
+	if (rsp->err) {
+		LOG_WRN("Observation failed: %d", rsp->err);
+	}
+
+	return 0;
+}
+
+static int workload_cb(struct golioth_req_rsp *rsp)
+{
+	if (rsp->err) {
+		atomic_inc(&errors);
+	}
+
+	atomic_inc(&completed);
+	k_sem_give(&window_sem);
+
+	return 0;
+}
+
+static void golioth_on_connect(struct golioth_client *c)
+{
+	int err;
+
+	err = golioth_lightdb_observe_cb(c, "footprint/observed", GOLIOTH_CONTENT_FORMAT_APP_JSON,
+					 observe_cb, NULL);
+	if (err) {
+		LOG_WRN("Failed to observe: %d", err);
+	}
+
+#if defined(CONFIG_GOLIOTH_RPC)
+	err = golioth_rpc_observe(c);
+	if (err) {
+		LOG_WRN("Failed to observe RPC: %d", err);
+	}
+#endif
+
+#if defined(CONFIG_GOLIOTH_SETTINGS)
+	err = golioth_settings_observe(c);
+	if (err) {
+		LOG_WRN("Failed to observe settings: %d", err);
+	}
+#endif
+
+#if defined(CONFIG_GOLIOTH_FW)
+	err = golioth_fw_report_state(c, "main", "1.0.0", NULL,
+				      GOLIOTH_FW_STATE_IDLE, GOLIOTH_DFU_RESULT_INITIAL);
+	if (err) {
+		LOG_WRN("Failed to report firmware state: %d", err);
+	}
+
+	err = golioth_fw_observe_desired(c, fw_desired_cb, NULL);
+	if (err) {
+		LOG_WRN("Failed to observe desired firmware: %d", err);
+	}
+#endif
+
+	k_sem_give(&connected);
+}
+
+#if !defined(CONFIG_GOLIOTH_SYSTEM_CLIENT)
+
+static int client_start(void)
+{
+	int err;
+
+	golioth_init(client);
+	client->rx_buffer = rx_buffer;
+	client->rx_buffer_len = sizeof(rx_buffer);
+
+	err = golioth_set_proto_coap_dtls(client, sec_tag_list, ARRAY_SIZE(sec_tag_list));
+	if (err) {
+		return err;
+	}
+
+	err = golioth_connect(client, CONFIG_FOOTPRINT_SERVER_HOST, CONFIG_FOOTPRINT_SERVER_PORT);
+	if (err) {
+		return err;
+	}
+
+	err = golioth_test_loop_start(client, loop_stack, K_THREAD_STACK_SIZEOF(loop_stack),
+				      LOOP_PRIO);
+	if (err) {
+		return err;
+	}
+
+	golioth_on_connect(client);
+
+	return 0;
+}
+
+#else /* !CONFIG_GOLIOTH_SYSTEM_CLIENT */
+
+static int client_start(void)
+{
+	client->on_connect = golioth_on_connect;
+	golioth_system_client_start();
+
+	return 0;
+}
+
+#endif /* !CONFIG_GOLIOTH_SYSTEM_CLIENT */
+
+static void workload(void)
+{
+	char value[12];
+	int err;
+
+	for (int i = 0; i < ITERATIONS; i++) {
+		snprintk(value, sizeof(value), "%d", i);
+
+		k_sem_take(&window_sem, K_FOREVER);
+		err = golioth_lightdb_set_cb(client, "footprint/value",
+					     GOLIOTH_CONTENT_FORMAT_APP_JSON,
+					     value, strlen(value), workload_cb, NULL);
+		if (err) {
+			workload_cb(&(struct golioth_req_rsp) { .err = err });
+		}
+
+		k_sem_take(&window_sem, K_FOREVER);
+		err = golioth_lightdb_get_cb(client, "footprint/value",
+					     GOLIOTH_CONTENT_FORMAT_APP_JSON,
+					     workload_cb, NULL);
+		if (err) {
+			workload_cb(&(struct golioth_req_rsp) { .err = err });
+		}
+
+		k_sem_take(&window_sem, K_FOREVER);
+		err = golioth_stream_push_cb(client, "footprint",
+					     GOLIOTH_CONTENT_FORMAT_APP_JSON,
+					     value, strlen(value), workload_cb, NULL);
+		if (err) {
+			workload_cb(&(struct golioth_req_rsp) { .err = err });
+		}
+
+		/* Goes through Golioth logging backend, when enabled */
+		LOG_INF("Iteration %d", i);
+	}
+
+	/* Wait for outstanding requests */
+	for (int i = 0; i < WINDOW; i++) {
+		k_sem_take(&window_sem, K_FOREVER);
+	}
+}
+
+int main(void)
+{
+	struct golioth_metrics m;
+	int err;
+
+#if defined(CONFIG_GOLIOTH_SAMPLES_COMMON)
+	net_connect();
+#endif
+
+#if defined(CONFIG_GOLIOTH_RPC)
+	err = golioth_rpc_init(client);
+	if (!err) {
+		err = golioth_rpc_register(client, "footprint", on_footprint, NULL);
+	}
+	if (err) {
+		LOG_ERR("Failed to register RPC: %d", err);
+	}
+#endif
+
+#if defined(CONFIG_GOLIOTH_SETTINGS)
+	err = golioth_settings_register_callback(client, on_setting);
+	if (err) {
+		LOG_ERR("Failed to register settings callback: %d", err);
+	}
+#endif
+
+	err = client_start();
+	if (err) {
+		LOG_ERR("Failed to start client: %d", err);
+		return 0;
+	}
+
+	k_sem_take(&connected, K_FOREVER);
+
+	workload();
+
+	golioth_metrics_get(client, &m);
+
+	printk("footprint: requests: %u, errors: %u\n",
+	       (unsigned int)atomic_get(&completed), (unsigned int)atomic_get(&errors));
+	printk("footprint: heap max: %u B\n", m.heap_used_max);
+
+	thread_analyzer_print();
+
+	printk("footprint: done\n");
+
+	return 0;
+}
@@ -0,0 +1,258 @@
+/*
+ * Copyright (c) 2023 Golioth, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <zephyr/logging/log.h>
+LOG_MODULE_REGISTER(keepalive_test);
+
+#include <string.h>
+
+#include <zephyr/ztest.h>
+
+#include <net/golioth.h>
+#include <net/golioth/system_client.h>
+#include <zephyr/net/coap.h>
+#include <zephyr/net/socket.h>
+#include <zephyr/net/tls_credentials.h>
+
+#include "coap_test_server.h"
+
+/*
+ * Tests of adaptive keepalive. Instances are connected over plain UDP to a minimal CoAP server on
+ * loopback interface, which answers pings. Server simulates NAT binding timeout by dropping all
+ * datagrams from client port, which was silent for longer than NAT_TIMEOUT_MS, or server outage
+ * by dropping all datagrams.
+ *
+ * Keepalive interval is probed at 1 s, 2 s and 3 s (see prj.conf), so NAT binding expires only
+ * with the longest interval.
+ */
+
+#define SERVER_PORT		5683
+#define STACK_SIZE		4096
+#define THREAD_PRIO		K_PRIO_PREEMPT(5)
+
+#define TEST_SEC_TAG		1
+#define TEST_PSK_ID		"test@golioth"
+#define TEST_PSK		"secret"
+
+#define NAT_TIMEOUT_MS		2500
+#define NAT_BINDINGS_MAX	4
+
+static K_THREAD_STACK_DEFINE(server_stack, STACK_SIZE);
+
+static struct golioth_system_client nat_sc;
+static uint8_t nat_sc_rx_buffer[256];
+static struct k_thread nat_sc_thread;
+static K_THREAD_STACK_DEFINE(nat_sc_stack, STACK_SIZE);
+
+static struct golioth_system_client outage_sc;
+static uint8_t outage_sc_rx_buffer[256];
+static struct k_thread outage_sc_thread;
+static K_THREAD_STACK_DEFINE(outage_sc_stack, STACK_SIZE);
+
+/* Whether server answers at all */
+static atomic_t server_online = ATOMIC_INIT(1);
+
+/* Simulated NAT bindings, accessed only from server thread (and before each test) */
+struct nat_binding {
+	uint16_t port;
+	int64_t last_rx;
+	bool expired;
+};
+
+static atomic_t nat_enabled;
+static struct nat_binding nat_bindings[NAT_BINDINGS_MAX];
+static int nat_bindings_next;
+
+static bool nat_pass(uint16_t port)
+{
+	int64_t now = k_uptime_get();
+	struct nat_binding *binding;
+
+	for (int i = 0; i < ARRAY_SIZE(nat_bindings); i++) {
+		binding = &nat_bindings[i];
+
+		if (binding->port != port) {
+			continue;
+		}
+
+		if (binding->expired) {
+			return false;
+		}
+
+		if (now - binding->last_rx > NAT_TIMEOUT_MS) {
+			LOG_INF("NAT binding of port %u expired", (unsigned int)ntohs(port));
+			binding->expired = true;
+			return false;
+		}
+
+		binding->last_rx = now;
+		return true;
+	}
+
+	/* New binding, oldest one is replaced */
+	binding = &nat_bindings[nat_bindings_next];
+	nat_bindings_next = (nat_bindings_next + 1) % ARRAY_SIZE(nat_bindings);
+
+	binding->port = port;
+	binding->last_rx = now;
+	binding->expired = false;
+
+	return true;
+}
+
+static void server_handle(const struct coap_packet *request)
+{
+	const struct sockaddr_in *peer = (const struct sockaddr_in *)coap_test_server_peer();
+	uint8_t code = coap_header_get_code(request);
+	uint8_t type = coap_header_get_type(request);
+
+	if (!atomic_get(&server_online)) {
+		return;
+	}
+
+	if (atomic_get(&nat_enabled) && !nat_pass(peer->sin_port)) {
+		return;
+	}
+
+	if (type != COAP_TYPE_CON) {
+		return;
+	}
+
+	if (code == COAP_CODE_EMPTY) {
+		/* Ping */
+		(void)coap_test_server_send(COAP_TYPE_RESET, COAP_CODE_EMPTY,
+					    coap_header_get_id(request), NULL, 0,
+					    -1, -1, NULL, 0);
+		return;
+	}
+
+	(void)coap_test_server_reply(request, COAP_RESPONSE_CODE_CONTENT, -1, -1, NULL, 0);
+}
+
+static bool wait_for_value(const int32_t *value, int32_t expected, int32_t timeout_ms)
+{
+	int64_t end = k_uptime_get() + timeout_ms;
+
+	while (*(const volatile int32_t *)value != expected) {
+		if (k_uptime_get() >= end) {
+			return false;
+		}
+
+		k_sleep(K_MSEC(10));
+	}
+
+	return true;
+}
+
+static void system_client_inst_init(struct golioth_system_client *inst,
+				    uint8_t *rx_buffer, size_t rx_buffer_len,
+				    struct k_thread *thread,
+				    k_thread_stack_t *stack, size_t stack_size)
+{
+	const struct golioth_system_client_config config = {
+		.host = "127.0.0.1",
+		.port = SERVER_PORT,
+		.sec_tag = TEST_SEC_TAG,
+		.rx_buffer = rx_buffer,
+		.rx_buffer_len = rx_buffer_len,
+		.thread = thread,
+		.stack = stack,
+		.stack_size = stack_size,
+		.priority = THREAD_PRIO,
+	};
+	int err;
+
+	err = golioth_system_client_init(inst, &config);
+	zassert_ok(err, "Failed to initialize instance: %d", err);
+
+	err = golioth_set_proto_coap_udp(golioth_system_client_get_client(inst));
+	zassert_ok(err, "Failed to set protocol: %d", err);
+}
+
+/*
+ * Receive timeout at 3 s interval (NAT binding expired) followed by working connection limits the
+ * interval to 2 s. The limit is raised back to 3 s after 2 successful pings.
+ */
+ZTEST(keepalive, test_nat_timeout)
+{
+	atomic_set(&nat_enabled, 1);
+
+	system_client_inst_init(&nat_sc, nat_sc_rx_buffer, sizeof(nat_sc_rx_buffer),
+				&nat_sc_thread, nat_sc_stack, K_THREAD_STACK_SIZEOF(nat_sc_stack));
+	golioth_system_client_inst_start(&nat_sc);
+
+	zassert_true(wait_for_value(&nat_sc.ping_interval_limit, 2 * MSEC_PER_SEC,
+				    30 * MSEC_PER_SEC),
+		     "Keepalive interval not limited after NAT timeout");
+	zassert_true(nat_sc.ping_interval <= 2 * MSEC_PER_SEC, "Interval above limit: %d",
+		     (int)nat_sc.ping_interval);
+
+	zassert_true(wait_for_value(&nat_sc.ping_interval_limit, 3 * MSEC_PER_SEC,
+				    30 * MSEC_PER_SEC),
+		     "Keepalive interval limit not raised again");
+
+	golioth_system_client_inst_stop(&nat_sc);
+}
+
+/*
+ * Receive timeouts caused by server outage do not limit the interval, so it grows back to
+ * maximum once server is available again.
+ */
+ZTEST(keepalive, test_server_outage)
+{
+	system_client_inst_init(&outage_sc, outage_sc_rx_buffer, sizeof(outage_sc_rx_buffer),
+				&outage_sc_thread, outage_sc_stack,
+				K_THREAD_STACK_SIZEOF(outage_sc_stack));
+	golioth_system_client_inst_start(&outage_sc);
+
+	zassert_true(wait_for_value(&outage_sc.ping_interval, 3 * MSEC_PER_SEC,
+				    15 * MSEC_PER_SEC),
+		     "Keepalive interval did not grow");
+
+	/* Long enough for receive timeout of current and of the next connection */
+	atomic_set(&server_online, 0);
+	k_sleep(K_SECONDS(12));
+	atomic_set(&server_online, 1);
+
+	zassert_true(wait_for_value(&outage_sc.ping_interval, 3 * MSEC_PER_SEC,
+				    15 * MSEC_PER_SEC),
+		     "Keepalive interval did not grow after outage");
+	zassert_equal(outage_sc.ping_interval_limit, 3 * MSEC_PER_SEC,
+		      "Keepalive interval limited by outage: %d",
+		      (int)outage_sc.ping_interval_limit);
+
+	golioth_system_client_inst_stop(&outage_sc);
+}
+
+static void *keepalive_setup(void)
+{
+	int err;
+
+	err = tls_credential_add(TEST_SEC_TAG, TLS_CREDENTIAL_PSK_ID,
+				 TEST_PSK_ID, sizeof(TEST_PSK_ID) - 1);
+	zassert_ok(err, "Failed to add PSK-ID: %d", err);
+
+	err = tls_credential_add(TEST_SEC_TAG, TLS_CREDENTIAL_PSK,
+				 TEST_PSK, sizeof(TEST_PSK) - 1);
+	zassert_ok(err, "Failed to add PSK: %d", err);
+
+	err = coap_test_server_start(SERVER_PORT, server_stack, K_THREAD_STACK_SIZEOF(server_stack),
+				     THREAD_PRIO);
+	zassert_ok(err, "Failed to start server: %d", err);
+
+	coap_test_server_handler_set(server_handle);
+
+	return NULL;
+}
+
+static void keepalive_before(void *fixture)
+{
+	atomic_set(&server_online, 1);
+	atomic_clear(&nat_enabled);
+	memset(nat_bindings, 0, sizeof(nat_bindings));
+}
+
+ZTEST_SUITE(keepalive, NULL, keepalive_setup, keepalive_before, NULL, NULL);
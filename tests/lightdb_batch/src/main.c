@@ -0,0 +1,407 @@
+/*
+ * Copyright (c) 2023 Golioth, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <zephyr/logging/log.h>
+LOG_MODULE_REGISTER(lightdb_batch_test);
+
+#include <string.h>
+
+#include <zephyr/ztest.h>
+
+#include <net/golioth.h>
+#include <net/golioth/lightdb.h>
+#include <zcbor_decode.h>
+#include <zcbor_encode.h>
+#include <zephyr/net/coap.h>
+
+#include "coap_test_server.h"
+#include "golioth_test_loop.h"
+
+/*
+ * Tests of CBOR encoding of LightDB batch set and decoding of batch get responses. Client is
+ * connected over plain UDP to a minimal CoAP server on loopback interface, which records received
+ * requests and answers with prepared payloads.
+ */
+
+#define SERVER_PORT		5683
+#define STACK_SIZE		4096
+#define THREAD_PRIO		K_PRIO_PREEMPT(5)
+
+#define SERVER_PAYLOAD_MAX	128
+
+static struct golioth_client _client;
+static struct golioth_client *client = &_client;
+static uint8_t rx_buffer[256];
+
+static K_THREAD_STACK_DEFINE(server_stack, STACK_SIZE);
+static K_THREAD_STACK_DEFINE(loop_stack, STACK_SIZE);
+
+/* Last request received by server */
+static uint8_t server_method;
+static char server_path[32];
+static uint8_t server_payload[SERVER_PAYLOAD_MAX];
+static size_t server_payload_len;
+static atomic_t server_rx_count;
+
+/* Payload of server responses */
+static uint8_t server_rsp[SERVER_PAYLOAD_MAX];
+static size_t server_rsp_len;
+
+static K_SEM_DEFINE(rsp_sem, 0, 1);
+static int rsp_err;
+
+struct item_result {
+	int err;
+	uint8_t data[16];
+	size_t len;
+	uint32_t calls;
+};
+
+static struct item_result results[3];
+
+static void server_record(const struct coap_packet *request)
+{
+	struct coap_option options[4];
+	const uint8_t *payload;
+	uint16_t payload_len;
+	size_t off = 0;
+	int num;
+
+	server_method = coap_header_get_code(request);
+
+	num = coap_find_options(request, COAP_OPTION_URI_PATH, options, ARRAY_SIZE(options));
+	for (int i = 0; i < num; i++) {
+		if (off + options[i].len + 2 > sizeof(server_path)) {
+			break;
+		}
+
+		if (i) {
+			server_path[off++] = '/';
+		}
+
+		memcpy(&server_path[off], options[i].value, options[i].len);
+		off += options[i].len;
+	}
+	server_path[off] = '\0';
+
+	payload = coap_packet_get_payload(request, &payload_len);
+	server_payload_len = MIN(payload_len, sizeof(server_payload));
+	if (payload) {
+		memcpy(server_payload, payload, server_payload_len);
+	}
+
+	atomic_inc(&server_rx_count);
+}
+
+static void server_handle_set(const struct coap_packet *request)
+{
+	server_record(request);
+
+	(void)coap_test_server_reply(request, COAP_RESPONSE_CODE_CHANGED, -1, -1, NULL, 0);
+}
+
+static void server_handle_get(const struct coap_packet *request)
+{
+	server_record(request);
+
+	(void)coap_test_server_reply(request, COAP_RESPONSE_CODE_CONTENT, -1, -1,
+				     server_rsp, server_rsp_len);
+}
+
+static void server_handle_not_found(const struct coap_packet *request)
+{
+	server_record(request);
+
+	(void)coap_test_server_reply(request, COAP_RESPONSE_CODE_NOT_FOUND, -1, -1, NULL, 0);
+}
+
+static int set_cb(struct golioth_req_rsp *rsp)
+{
+	rsp_err = rsp->err;
+	k_sem_give(&rsp_sem);
+
+	return 0;
+}
+
+static int item_cb(struct golioth_req_rsp *rsp)
+{
+	struct item_result *result = rsp->user_data;
+
+	result->calls++;
+	result->err = rsp->err;
+
+	if (!rsp->err) {
+		result->len = MIN(rsp->len, sizeof(result->data));
+		memcpy(result->data, rsp->data, result->len);
+	}
+
+	return 0;
+}
+
+static int last_item_cb(struct golioth_req_rsp *rsp)
+{
+	item_cb(rsp);
+	k_sem_give(&rsp_sem);
+
+	return 0;
+}
+
+/* Server response: {"temp": 21, "name": "dev", "extra": [1, 2]} */
+static void server_rsp_prepare(void)
+{
+	bool ok;
+
+	ZCBOR_STATE_E(zse, 2, server_rsp, sizeof(server_rsp), 1);
+
+	ok = zcbor_map_start_encode(zse, 3) &&
+	     zcbor_tstr_put_lit(zse, "temp") &&
+	     zcbor_int32_put(zse, 21) &&
+	     zcbor_tstr_put_lit(zse, "name") &&
+	     zcbor_tstr_put_lit(zse, "dev") &&
+	     zcbor_tstr_put_lit(zse, "extra") &&
+	     zcbor_list_start_encode(zse, 2) &&
+	     zcbor_int32_put(zse, 1) &&
+	     zcbor_int32_put(zse, 2) &&
+	     zcbor_list_end_encode(zse, 2) &&
+	     zcbor_map_end_encode(zse, 3);
+	zassert_true(ok, "Failed to encode server response");
+
+	server_rsp_len = zse->payload - server_rsp;
+}
+
+static void tstr_expect(zcbor_state_t *zsd, const char *expected)
+{
+	struct zcbor_string str;
+	bool ok;
+
+	ok = zcbor_tstr_decode(zsd, &str);
+	zassert_true(ok, "Failed to decode %s", expected);
+	zassert_equal(str.len, strlen(expected), "Unexpected length of %s", expected);
+	zassert_mem_equal(str.value, expected, str.len, "Unexpected %s", expected);
+}
+
+ZTEST(lightdb_batch, test_set_encode)
+{
+	const struct golioth_lightdb_set_item items[] = {
+		GOLIOTH_LIGHTDB_SET_ITEM_INT("sensor/temp", -21),
+		GOLIOTH_LIGHTDB_SET_ITEM_FLOAT("sensor/hum", 40.5),
+		GOLIOTH_LIGHTDB_SET_ITEM_BOOL("sensor/on", true),
+		GOLIOTH_LIGHTDB_SET_ITEM_STRING("sensor/name", "dev"),
+	};
+	int64_t i64;
+	double f;
+	bool b;
+	bool ok;
+	int err;
+
+	coap_test_server_handler_set(server_handle_set);
+
+	err = golioth_lightdb_set_batch(client, items, ARRAY_SIZE(items));
+	zassert_ok(err, "Failed to set batch: %d", err);
+
+	zassert_equal(server_method, COAP_METHOD_POST, "Unexpected method %u", server_method);
+	zassert_equal(strcmp(server_path, ".d/sensor"), 0, "Unexpected path %s", server_path);
+
+	ZCBOR_STATE_D(zsd, 2, server_payload, server_payload_len, 1);
+
+	ok = zcbor_map_start_decode(zsd);
+	zassert_true(ok, "Payload is not CBOR map");
+
+	tstr_expect(zsd, "temp");
+	ok = zcbor_int64_decode(zsd, &i64);
+	zassert_true(ok && i64 == -21, "Unexpected temp");
+
+	tstr_expect(zsd, "hum");
+	ok = zcbor_float64_decode(zsd, &f);
+	zassert_true(ok && f == 40.5, "Unexpected hum");
+
+	tstr_expect(zsd, "on");
+	ok = zcbor_bool_decode(zsd, &b);
+	zassert_true(ok && b, "Unexpected on");
+
+	tstr_expect(zsd, "name");
+	tstr_expect(zsd, "dev");
+
+	ok = zcbor_map_end_decode(zsd);
+	zassert_true(ok, "Unexpected items in map");
+}
+
+ZTEST(lightdb_batch, test_set_root_cb)
+{
+	const struct golioth_lightdb_set_item items[] = {
+		GOLIOTH_LIGHTDB_SET_ITEM_INT("a", 1),
+		GOLIOTH_LIGHTDB_SET_ITEM_INT("b", 2),
+	};
+	int err;
+
+	coap_test_server_handler_set(server_handle_set);
+
+	err = golioth_lightdb_set_batch_cb(client, items, ARRAY_SIZE(items), set_cb, NULL);
+	zassert_ok(err, "Failed to set batch: %d", err);
+
+	err = k_sem_take(&rsp_sem, K_SECONDS(5));
+	zassert_ok(err, "Callback was not invoked");
+
+	zassert_ok(rsp_err, "Request failed: %d", rsp_err);
+	zassert_equal(strcmp(server_path, ".d"), 0, "Unexpected path %s", server_path);
+}
+
+ZTEST(lightdb_batch, test_set_invalid)
+{
+	const struct golioth_lightdb_set_item no_common_parent[] = {
+		GOLIOTH_LIGHTDB_SET_ITEM_INT("a/x", 1),
+		GOLIOTH_LIGHTDB_SET_ITEM_INT("b/y/z", 2),
+	};
+	const struct golioth_lightdb_set_item duplicated[] = {
+		GOLIOTH_LIGHTDB_SET_ITEM_INT("a/x", 1),
+		GOLIOTH_LIGHTDB_SET_ITEM_INT("a/x", 2),
+	};
+	int err;
+
+	coap_test_server_handler_set(server_handle_set);
+
+	err = golioth_lightdb_set_batch(client, no_common_parent, ARRAY_SIZE(no_common_parent));
+	zassert_equal(err, -EINVAL, "Unexpected result: %d", err);
+
+	err = golioth_lightdb_set_batch(client, duplicated, ARRAY_SIZE(duplicated));
+	zassert_equal(err, -EINVAL, "Unexpected result: %d", err);
+
+	err = golioth_lightdb_set_batch(client, duplicated, 0);
+	zassert_equal(err, -EINVAL, "Unexpected result: %d", err);
+
+	zassert_equal(atomic_get(&server_rx_count), 0, "Invalid batch was sent");
+}
+
+static void get_items_verify(void)
+{
+	static const uint8_t temp[] = { 0x15 };
+	static const uint8_t name[] = { 0x63, 'd', 'e', 'v' };
+
+	zassert_equal(server_method, COAP_METHOD_GET, "Unexpected method %u", server_method);
+	zassert_equal(strcmp(server_path, ".d/sensor"), 0, "Unexpected path %s", server_path);
+
+	for (size_t i = 0; i < ARRAY_SIZE(results); i++) {
+		zassert_equal(results[i].calls, 1, "Item %zu callback invoked %u times",
+			      i, results[i].calls);
+	}
+
+	zassert_ok(results[0].err, "temp failed: %d", results[0].err);
+	zassert_equal(results[0].len, sizeof(temp), "Unexpected length of temp");
+	zassert_mem_equal(results[0].data, temp, sizeof(temp), "Unexpected temp");
+
+	zassert_ok(results[1].err, "name failed: %d", results[1].err);
+	zassert_equal(results[1].len, sizeof(name), "Unexpected length of name");
+	zassert_mem_equal(results[1].data, name, sizeof(name), "Unexpected name");
+
+	zassert_equal(results[2].err, -ENOENT, "Unexpected result of missing: %d",
+		      results[2].err);
+}
+
+ZTEST(lightdb_batch, test_get_decode)
+{
+	const struct golioth_lightdb_get_item items[] = {
+		{ .path = "sensor/temp", .cb = item_cb, .user_data = &results[0] },
+		{ .path = "sensor/name", .cb = item_cb, .user_data = &results[1] },
+		{ .path = "sensor/missing", .cb = item_cb, .user_data = &results[2] },
+	};
+	int err;
+
+	server_rsp_prepare();
+	coap_test_server_handler_set(server_handle_get);
+
+	err = golioth_lightdb_get_batch(client, items, ARRAY_SIZE(items));
+	zassert_ok(err, "Failed to get batch: %d", err);
+
+	get_items_verify();
+}
+
+ZTEST(lightdb_batch, test_get_decode_cb)
+{
+	/* Missing item is reported last, after all decoded items */
+	const struct golioth_lightdb_get_item items[] = {
+		{ .path = "sensor/temp", .cb = item_cb, .user_data = &results[0] },
+		{ .path = "sensor/name", .cb = item_cb, .user_data = &results[1] },
+		{ .path = "sensor/missing", .cb = last_item_cb, .user_data = &results[2] },
+	};
+	int err;
+
+	server_rsp_prepare();
+	coap_test_server_handler_set(server_handle_get);
+
+	err = golioth_lightdb_get_batch_cb(client, items, ARRAY_SIZE(items));
+	zassert_ok(err, "Failed to get batch: %d", err);
+
+	err = k_sem_take(&rsp_sem, K_SECONDS(5));
+	zassert_ok(err, "Callback was not invoked");
+
+	get_items_verify();
+}
+
+ZTEST(lightdb_batch, test_get_error)
+{
+	const struct golioth_lightdb_get_item items[] = {
+		{ .path = "sensor/temp", .cb = item_cb, .user_data = &results[0] },
+		{ .path = "sensor/name", .cb = item_cb, .user_data = &results[1] },
+	};
+	int err;
+
+	coap_test_server_handler_set(server_handle_not_found);
+
+	err = golioth_lightdb_get_batch(client, items, ARRAY_SIZE(items));
+	zassert_equal(err, -ENOENT, "Unexpected result: %d", err);
+
+	/* Error of whole request is passed to every item */
+	for (size_t i = 0; i < ARRAY_SIZE(items); i++) {
+		zassert_equal(results[i].calls, 1, "Item %zu callback invoked %u times",
+			      i, results[i].calls);
+		zassert_equal(results[i].err, -ENOENT, "Unexpected error of item %zu: %d",
+			      i, results[i].err);
+	}
+}
+
+static void *lightdb_batch_setup(void)
+{
+	int err;
+
+	err = coap_test_server_start(SERVER_PORT, server_stack, K_THREAD_STACK_SIZEOF(server_stack),
+				     THREAD_PRIO);
+	zassert_ok(err, "Failed to start server: %d", err);
+
+	golioth_init(client);
+	client->rx_buffer = rx_buffer;
+	client->rx_buffer_len = sizeof(rx_buffer);
+
+	err = golioth_set_proto_coap_udp(client);
+	zassert_ok(err, "Failed to set protocol: %d", err);
+
+	err = golioth_connect(client, "127.0.0.1", SERVER_PORT);
+	zassert_ok(err, "Failed to connect: %d", err);
+
+	err = golioth_test_loop_start(client, loop_stack, K_THREAD_STACK_SIZEOF(loop_stack),
+				      THREAD_PRIO);
+	zassert_ok(err, "Failed to start loop: %d", err);
+
+	return NULL;
+}
+
+static void lightdb_batch_before(void *fixture)
+{
+	atomic_clear(&server_rx_count);
+	server_method = 0;
+	server_path[0] = '\0';
+	server_payload_len = 0;
+	k_sem_reset(&rsp_sem);
+	rsp_err = 0;
+	memset(results, 0, sizeof(results));
+}
+
+static void lightdb_batch_after(void *fixture)
+{
+	coap_test_server_handler_set(NULL);
+}
+
+ZTEST_SUITE(lightdb_batch, NULL, lightdb_batch_setup, lightdb_batch_before,
+	    lightdb_batch_after, NULL);
@@ -0,0 +1,312 @@
+/*
+ * Copyright (c) 2023 Golioth, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <zephyr/logging/log.h>
+LOG_MODULE_REGISTER(lock_contention_test);
+
+#include <string.h>
+
+#include <zephyr/ztest.h>
+
+#include <net/golioth.h>
+#include <net/golioth/lightdb.h>
+#include <zephyr/net/coap.h>
+#include <zephyr/net/socket.h>
+
+#include "coap_test_server.h"
+
+/*
+ * Benchmark of concurrent send and receive on single client instance.
+ *
+ * Client is connected over plain UDP (no DTLS) to a minimal CoAP server on loopback interface.
+ * Client observes a LightDB path and server turns each received POST into NON notification of that
+ * observation. Several producer threads send POSTs, while receiver thread processes notifications,
+ * which are counted by observe callback. Time spent by producers waiting for socket access is
+ * reported.
+ *
+ * Each scenario runs with split RX and TX locks of client, and with a single application mutex
+ * around sending and processing received data, which approximates single socket lock for
+ * comparison.
+ */
+
+#define SERVER_PORT		5683
+#define NUM_PRODUCERS		4
+#define PACKETS_PER_PRODUCER	500
+#define STACK_SIZE		2048
+#define THREAD_PRIO		K_PRIO_PREEMPT(5)
+
+static struct golioth_client _client;
+static struct golioth_client *client = &_client;
+static uint8_t rx_buffer[256];
+
+static K_THREAD_STACK_DEFINE(server_stack, STACK_SIZE);
+
+static K_THREAD_STACK_DEFINE(receiver_stack, STACK_SIZE);
+static struct k_thread receiver_thread;
+
+static K_THREAD_STACK_ARRAY_DEFINE(producer_stacks, NUM_PRODUCERS, STACK_SIZE);
+static struct k_thread producer_threads[NUM_PRODUCERS];
+
+/* Application lock of "single lock" scenario, NULL with split locks */
+static K_MUTEX_DEFINE(app_lock);
+static struct k_mutex *single_lock;
+
+static atomic_t stop;
+static atomic_t server_posts;
+static atomic_t notified;
+
+/* Observation registered by client, accessed only from server thread */
+static uint8_t observe_token[COAP_TOKEN_MAX_LEN];
+static uint8_t observe_tkl;
+static uint32_t observe_seq;
+
+static K_SEM_DEFINE(observe_sem, 0, 1);
+
+struct producer_stats {
+	uint32_t sent;
+	uint32_t errors;
+	uint64_t send_cycles;
+	uint32_t max_send_cycles;
+};
+
+static struct producer_stats producer_stats[NUM_PRODUCERS];
+
+static void lock(void)
+{
+	if (single_lock) {
+		k_mutex_lock(single_lock, K_FOREVER);
+	}
+}
+
+static void unlock(void)
+{
+	if (single_lock) {
+		k_mutex_unlock(single_lock);
+	}
+}
+
+static void server_handle(const struct coap_packet *request)
+{
+	uint8_t code = coap_header_get_code(request);
+
+	if (code == COAP_METHOD_GET) {
+		/* Registration of observation */
+		observe_tkl = coap_header_get_token(request, observe_token);
+		observe_seq = 1;
+
+		(void)coap_test_server_reply(request, COAP_RESPONSE_CODE_CONTENT,
+					     observe_seq, -1, (const uint8_t *)"0", 1);
+		return;
+	}
+
+	if (code != COAP_METHOD_POST || !observe_tkl) {
+		return;
+	}
+
+	atomic_inc(&server_posts);
+
+	(void)coap_test_server_send(COAP_TYPE_NON_CON, COAP_RESPONSE_CODE_CONTENT,
+				    coap_next_id(), observe_token, observe_tkl,
+				    ++observe_seq, -1, (const uint8_t *)"1", 1);
+}
+
+static int observe_cb(struct golioth_req_rsp *rsp)
+{
+	if (rsp->err) {
+		return rsp->err;
+	}
+
+	if (atomic_inc(&notified) == 0) {
+		/* Response to registration */
+		k_sem_give(&observe_sem);
+	}
+
+	return 0;
+}
+
+static void receiver_main(void *arg1, void *arg2, void *arg3)
+{
+	struct zsock_pollfd fds = {
+		.fd = client->sock,
+		.events = ZSOCK_POLLIN,
+	};
+	int ret;
+
+	while (!atomic_get(&stop)) {
+		golioth_poll_prepare(client, k_uptime_get(), NULL, NULL);
+
+		ret = zsock_poll(&fds, 1, 10);
+		if (ret <= 0) {
+			continue;
+		}
+
+		lock();
+		(void)golioth_process_rx(client);
+		unlock();
+	}
+}
+
+static void producer_main(void *arg1, void *arg2, void *arg3)
+{
+	struct producer_stats *stats = arg1;
+	uint8_t buf[GOLIOTH_COAP_MAX_NON_PAYLOAD_LEN];
+	struct coap_packet packet;
+	uint32_t start, cycles;
+	int err;
+
+	for (int i = 0; i < PACKETS_PER_PRODUCER; i++) {
+		err = coap_packet_init(&packet, buf, sizeof(buf), COAP_VERSION_1,
+				       COAP_TYPE_NON_CON, 0, NULL,
+				       COAP_METHOD_POST, coap_next_id());
+		zassert_ok(err, "Failed to init packet");
+
+		err = coap_packet_append_option(&packet, COAP_OPTION_URI_PATH,
+						(const uint8_t *)".s", sizeof(".s") - 1);
+		zassert_ok(err, "Failed to append option");
+
+		start = k_cycle_get_32();
+		lock();
+		err = golioth_send_coap(client, &packet);
+		unlock();
+		cycles = k_cycle_get_32() - start;
+
+		if (err) {
+			stats->errors++;
+			continue;
+		}
+
+		stats->sent++;
+		stats->send_cycles += cycles;
+		stats->max_send_cycles = MAX(stats->max_send_cycles, cycles);
+
+		k_yield();
+	}
+}
+
+static void run_scenario(const char *name)
+{
+	uint32_t total_sent = 0;
+	uint32_t total_errors = 0;
+	uint64_t total_cycles = 0;
+	uint32_t max_cycles = 0;
+	uint32_t start_ms;
+	uint32_t elapsed_ms;
+	int64_t end;
+
+	atomic_clear(&stop);
+	atomic_clear(&server_posts);
+	atomic_set(&notified, 1);
+	memset(producer_stats, 0, sizeof(producer_stats));
+
+	k_thread_create(&receiver_thread, receiver_stack, K_THREAD_STACK_SIZEOF(receiver_stack),
+			receiver_main, NULL, NULL, NULL, THREAD_PRIO, 0, K_NO_WAIT);
+
+	start_ms = k_uptime_get_32();
+
+	for (int i = 0; i < NUM_PRODUCERS; i++) {
+		k_thread_create(&producer_threads[i], producer_stacks[i],
+				K_THREAD_STACK_SIZEOF(producer_stacks[i]),
+				producer_main, &producer_stats[i], NULL, NULL,
+				THREAD_PRIO, 0, K_NO_WAIT);
+	}
+
+	for (int i = 0; i < NUM_PRODUCERS; i++) {
+		k_thread_join(&producer_threads[i], K_FOREVER);
+	}
+
+	elapsed_ms = k_uptime_get_32() - start_ms;
+
+	/* Let receiver process remaining notifications */
+	end = k_uptime_get() + MSEC_PER_SEC;
+	while (atomic_get(&notified) - 1 < atomic_get(&server_posts) && k_uptime_get() < end) {
+		k_sleep(K_MSEC(10));
+	}
+
+	atomic_set(&stop, 1);
+	k_thread_join(&receiver_thread, K_FOREVER);
+
+	for (int i = 0; i < NUM_PRODUCERS; i++) {
+		total_sent += producer_stats[i].sent;
+		total_errors += producer_stats[i].errors;
+		total_cycles += producer_stats[i].send_cycles;
+		max_cycles = MAX(max_cycles, producer_stats[i].max_send_cycles);
+	}
+
+	TC_PRINT("[%s] producers: %d, sent: %u, errors: %u, received by server: %u, "
+		 "notified: %u\n",
+		 name, NUM_PRODUCERS, total_sent, total_errors,
+		 (unsigned int)atomic_get(&server_posts),
+		 (unsigned int)atomic_get(&notified) - 1);
+	TC_PRINT("[%s] elapsed: %u ms, avg send: %u us, max send: %u us\n",
+		 name, elapsed_ms,
+		 total_sent ? k_cyc_to_us_floor32(total_cycles / total_sent) : 0,
+		 k_cyc_to_us_floor32(max_cycles));
+
+	zassert_equal(total_errors, 0, "Failed to send %u packets", total_errors);
+	zassert_equal(total_sent, NUM_PRODUCERS * PACKETS_PER_PRODUCER, "Not all packets sent");
+	zassert_true(atomic_get(&notified) > 1, "No notification processed");
+}
+
+ZTEST(lock_contention, test_split_locks)
+{
+	single_lock = NULL;
+
+	run_scenario("split locks");
+}
+
+ZTEST(lock_contention, test_single_lock)
+{
+	single_lock = &app_lock;
+
+	run_scenario("single lock");
+}
+
+static void *lock_contention_setup(void)
+{
+	struct zsock_pollfd fds = {
+		.events = ZSOCK_POLLIN,
+	};
+	int64_t end;
+	int err;
+
+	err = coap_test_server_start(SERVER_PORT, server_stack, K_THREAD_STACK_SIZEOF(server_stack),
+				     THREAD_PRIO);
+	zassert_ok(err, "Failed to start server: %d", err);
+
+	coap_test_server_handler_set(server_handle);
+
+	golioth_init(client);
+	client->rx_buffer = rx_buffer;
+	client->rx_buffer_len = sizeof(rx_buffer);
+
+	err = golioth_set_proto_coap_udp(client);
+	zassert_ok(err, "Failed to set protocol: %d", err);
+
+	err = golioth_connect(client, "127.0.0.1", SERVER_PORT);
+	zassert_ok(err, "Failed to connect: %d", err);
+
+	err = golioth_lightdb_observe_cb(client, "counter", GOLIOTH_CONTENT_FORMAT_APP_JSON,
+					 observe_cb, NULL);
+	zassert_ok(err, "Failed to observe: %d", err);
+
+	/* Drive client until observation is registered, receiver thread is not running yet */
+	fds.fd = client->sock;
+	end = k_uptime_get() + 5 * MSEC_PER_SEC;
+
+	while (k_sem_take(&observe_sem, K_NO_WAIT) != 0) {
+		zassert_true(k_uptime_get() < end, "Observation not registered");
+
+		golioth_poll_prepare(client, k_uptime_get(), NULL, NULL);
+
+		if (zsock_poll(&fds, 1, 10) > 0) {
+			(void)golioth_process_rx(client);
+		}
+	}
+
+	return NULL;
+}
+
+ZTEST_SUITE(lock_contention, NULL, lock_contention_setup, NULL, NULL, NULL);
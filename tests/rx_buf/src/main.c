@@ -0,0 +1,142 @@
+/*
+ * Copyright (c) 2023 Golioth, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <zephyr/logging/log.h>
+LOG_MODULE_REGISTER(rx_buf_test);
+
+#include <zephyr/ztest.h>
+
+#include <net/golioth.h>
+
+#include "rx_buf.h"
+
+/*
+ * Tests of RX buffer lending. Client is never connected, processing of received datagram is
+ * simulated by claiming pointer into current RX buffer and swapping buffers afterwards, as done by
+ * golioth_process_rx().
+ */
+
+#define CLAIMED_MAX	4
+
+static struct golioth_client _client;
+static struct golioth_client *client = &_client;
+static uint8_t rx_buffer[CONFIG_GOLIOTH_RX_BUF_POOL_BLOCK_SIZE];
+
+/* Buffers claimed by test, released after each test */
+static uint8_t *claimed[CLAIMED_MAX];
+static size_t num_claimed;
+
+static uint8_t *claim_received(void)
+{
+	uint8_t *buf = golioth_rx_buf_claim(client, &client->rx_buffer[10]);
+
+	if (buf) {
+		zassert_true(num_claimed < ARRAY_SIZE(claimed), "Too many claimed buffers");
+		claimed[num_claimed++] = buf;
+	}
+
+	return buf;
+}
+
+static void release_claimed(uint8_t *buf)
+{
+	for (size_t i = 0; i < num_claimed; i++) {
+		if (claimed[i] == buf) {
+			claimed[i] = claimed[--num_claimed];
+			golioth_rx_buf_release(client, buf);
+			return;
+		}
+	}
+
+	zassert_unreachable("Buffer was not claimed");
+}
+
+ZTEST(rx_buf, test_claim_release)
+{
+	uint8_t *received = client->rx_buffer;
+	uint8_t *buf;
+
+	buf = claim_received();
+	zassert_equal(buf, received, "Claim did not return received buffer");
+
+	/* Single datagram can be claimed only once */
+	zassert_is_null(golioth_rx_buf_claim(client, &client->rx_buffer[20]),
+			"Buffer claimed twice");
+
+	golioth_rx_buf_swap(client);
+	zassert_not_null(client->rx_buffer, "No RX buffer after swap");
+	zassert_true(client->rx_buffer != received, "RX buffer was not replaced");
+
+	/* Claimed buffer is not touched by client anymore, so it can be released from anywhere */
+	release_claimed(buf);
+
+	/* Released buffer of client owner is reused by next claim instead of pool buffer */
+	buf = claim_received();
+	zassert_not_null(buf, "Failed to claim");
+	golioth_rx_buf_swap(client);
+	zassert_equal(client->rx_buffer, received, "Released buffer was not reused");
+}
+
+ZTEST(rx_buf, test_claim_not_received)
+{
+	static uint8_t other[16];
+
+	zassert_is_null(golioth_rx_buf_claim(client, other), "Claimed data outside RX buffer");
+	zassert_is_null(golioth_rx_buf_claim(client, &client->rx_buffer[sizeof(rx_buffer)]),
+			"Claimed data past RX buffer");
+
+	golioth_rx_buf_swap(client);
+	zassert_equal(client->rx_buffer, rx_buffer, "RX buffer replaced without claim");
+}
+
+ZTEST(rx_buf, test_exhaustion)
+{
+	uint8_t *buf;
+
+	/* Each claim takes one pool buffer, as none is released */
+	for (int i = 0; i < CONFIG_GOLIOTH_RX_BUF_POOL_COUNT; i++) {
+		buf = claim_received();
+		zassert_not_null(buf, "Failed to claim buffer %d", i);
+		golioth_rx_buf_swap(client);
+	}
+
+	/* Pool exhausted, payload needs to be copied and RX buffer is kept */
+	buf = client->rx_buffer;
+	zassert_is_null(claim_received(), "Claimed with exhausted pool");
+	golioth_rx_buf_swap(client);
+	zassert_equal(client->rx_buffer, buf, "RX buffer replaced without claim");
+
+	/* Any released buffer makes claim possible again */
+	release_claimed(claimed[0]);
+
+	zassert_not_null(claim_received(), "Failed to claim after release");
+	golioth_rx_buf_swap(client);
+}
+
+static void rx_buf_before(void *fixture)
+{
+	golioth_init(client);
+	client->rx_buffer = rx_buffer;
+	client->rx_buffer_len = sizeof(rx_buffer);
+}
+
+static void rx_buf_after(void *fixture)
+{
+	/* Return pool buffers, including the one currently used by client */
+	if (client->rx_buffer != rx_buffer) {
+		golioth_rx_buf_release(client, client->rx_buffer);
+	}
+
+	for (size_t i = 0; i < num_claimed; i++) {
+		if (claimed[i] != rx_buffer) {
+			golioth_rx_buf_release(client, claimed[i]);
+		}
+	}
+
+	num_claimed = 0;
+}
+
+ZTEST_SUITE(rx_buf, NULL, NULL, rx_buf_before, rx_buf_after, NULL);
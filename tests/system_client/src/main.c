@@ -0,0 +1,318 @@
+/*
+ * Copyright (c) 2023 Golioth, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <zephyr/logging/log.h>
+LOG_MODULE_REGISTER(system_client_test);
+
+#include <string.h>
+
+#include <zephyr/ztest.h>
+
+#include <net/golioth.h>
+#include <net/golioth/system_client.h>
+#include <zephyr/net/coap.h>
+#include <zephyr/net/socket.h>
+#include <zephyr/net/tls_credentials.h>
+
+#include "coap_test_server.h"
+
+/*
+ * Tests of system client instances. Instances are connected over plain UDP to a minimal CoAP
+ * server on loopback interface, which answers pings (and acknowledges any other request) unless
+ * test disables it to simulate connection loss.
+ *
+ * Dummy PSK credentials are provisioned, as instances check them before connecting.
+ */
+
+#define SERVER_PORT		5683
+#define STACK_SIZE		4096
+#define THREAD_PRIO		K_PRIO_PREEMPT(5)
+
+#define TEST_SEC_TAG		1
+#define TEST_PSK_ID		"test@golioth"
+#define TEST_PSK		"secret"
+
+#define PING_INTERVAL_MS	(CONFIG_GOLIOTH_SYSTEM_CLIENT_PING_INTERVAL_SEC * MSEC_PER_SEC)
+
+#define WAKEUPS_WINDOW_SEC	10
+
+static K_THREAD_STACK_DEFINE(server_stack, STACK_SIZE);
+
+static struct golioth_system_client sc;
+static uint8_t sc_rx_buffer[256];
+static struct k_thread sc_thread;
+static K_THREAD_STACK_DEFINE(sc_stack, STACK_SIZE);
+
+/* Instances driven by shared loop */
+static struct golioth_system_client_loop loop;
+static K_THREAD_STACK_DEFINE(loop_stack, STACK_SIZE);
+static struct golioth_system_client loop_sc[CONFIG_GOLIOTH_SYSTEM_CLIENT_LOOP_MAX_CLIENTS];
+static uint8_t loop_sc_rx_buffer[CONFIG_GOLIOTH_SYSTEM_CLIENT_LOOP_MAX_CLIENTS][256];
+
+/* Whether server answers at all */
+static atomic_t server_online = ATOMIC_INIT(1);
+static atomic_t server_pings;
+/* Source port of last request received by server */
+static atomic_t server_peer_port;
+
+/* Thread switches counted by tracing hook */
+static struct k_thread *switches_thread;
+static atomic_t switches_thread_count;
+static atomic_t switches_workq_count;
+
+void sys_trace_thread_switched_in_user(void)
+{
+	struct k_thread *thread = k_current_get();
+
+	if (thread == switches_thread) {
+		atomic_inc(&switches_thread_count);
+	} else if (thread == &k_sys_work_q.thread) {
+		atomic_inc(&switches_workq_count);
+	}
+}
+
+static void server_handle(const struct coap_packet *request)
+{
+	uint8_t code = coap_header_get_code(request);
+	uint8_t type = coap_header_get_type(request);
+
+	if (!atomic_get(&server_online) || type != COAP_TYPE_CON) {
+		return;
+	}
+
+	atomic_set(&server_peer_port,
+		   ((const struct sockaddr_in *)coap_test_server_peer())->sin_port);
+
+	if (code == COAP_CODE_EMPTY) {
+		/* Ping */
+		atomic_inc(&server_pings);
+		(void)coap_test_server_send(COAP_TYPE_RESET, COAP_CODE_EMPTY,
+					    coap_header_get_id(request), NULL, 0,
+					    -1, -1, NULL, 0);
+		return;
+	}
+
+	(void)coap_test_server_reply(request, COAP_RESPONSE_CODE_CONTENT, -1, -1, NULL, 0);
+}
+
+static bool wait_for_connected(struct golioth_system_client *inst, int32_t timeout_ms)
+{
+	struct golioth_client *client = golioth_system_client_get_client(inst);
+	int64_t end = k_uptime_get() + timeout_ms;
+
+	while (!golioth_is_connected(client)) {
+		if (k_uptime_get() >= end) {
+			return false;
+		}
+
+		k_sleep(K_MSEC(10));
+	}
+
+	return true;
+}
+
+static void system_client_inst_init(struct golioth_system_client *inst,
+				    uint8_t *rx_buffer, size_t rx_buffer_len,
+				    struct golioth_system_client_loop *loop, struct k_thread *thread,
+				    k_thread_stack_t *stack, size_t stack_size)
+{
+	const struct golioth_system_client_config config = {
+		.host = "127.0.0.1",
+		.port = SERVER_PORT,
+		.sec_tag = TEST_SEC_TAG,
+		.rx_buffer = rx_buffer,
+		.rx_buffer_len = rx_buffer_len,
+		.loop = loop,
+		.thread = thread,
+		.stack = stack,
+		.stack_size = stack_size,
+		.priority = THREAD_PRIO,
+	};
+	int err;
+
+	err = golioth_system_client_init(inst, &config);
+	zassert_ok(err, "Failed to initialize instance: %d", err);
+
+	err = golioth_set_proto_coap_udp(golioth_system_client_get_client(inst));
+	zassert_ok(err, "Failed to set protocol: %d", err);
+}
+
+/*
+ * Wakeups of idle, connected instance. Loop thread should wake up only for keepalive (poll timeout
+ * when ping is due) and for received ping response, without any help of system workqueue.
+ *
+ * Number of wakeups per minute is printed for comparison between builds.
+ */
+ZTEST(system_client, test_idle_wakeups)
+{
+	uint32_t thread_count, workq_count, pings;
+	uint32_t expected_max;
+
+	zassert_true(wait_for_connected(&sc, 5 * MSEC_PER_SEC), "Instance not connected");
+
+	/* Let connection settle */
+	k_sleep(K_MSEC(PING_INTERVAL_MS));
+
+	atomic_clear(&server_pings);
+	atomic_clear(&switches_workq_count);
+	atomic_clear(&switches_thread_count);
+	switches_thread = &sc_thread;
+
+	k_sleep(K_SECONDS(WAKEUPS_WINDOW_SEC));
+
+	switches_thread = NULL;
+	thread_count = atomic_get(&switches_thread_count);
+	workq_count = atomic_get(&switches_workq_count);
+	pings = atomic_get(&server_pings);
+
+	TC_PRINT("idle wakeups per minute: system client thread %u, system workqueue %u "
+		 "(pings %u)\n",
+		 thread_count * 60 / WAKEUPS_WINDOW_SEC,
+		 workq_count * 60 / WAKEUPS_WINDOW_SEC,
+		 pings * 60 / WAKEUPS_WINDOW_SEC);
+
+	zassert_true(pings > 0, "No keepalive sent");
+
+	/* Poll timeout and ping response for each ping, with some slack for scheduling */
+	expected_max = 2 * pings + 2;
+	zassert_true(thread_count <= expected_max, "Too many wakeups: %u (expected <= %u)",
+		     thread_count, expected_max);
+}
+
+ZTEST(system_client, test_thread_name)
+{
+	const char *name = k_thread_name_get(&sc_thread);
+
+	zassert_not_null(name, "Thread has no name");
+	zassert_equal(strcmp(name, "golioth_system_1"), 0, "Unexpected thread name %s", name);
+}
+
+/*
+ * Instances driven by shared loop connect and are kept alive independently of each other, up to
+ * the capacity of the loop.
+ */
+ZTEST(system_client, test_loop)
+{
+	const struct golioth_system_client_loop_config loop_config = {
+		.stack = loop_stack,
+		.stack_size = K_THREAD_STACK_SIZEOF(loop_stack),
+		.priority = THREAD_PRIO,
+	};
+	const struct golioth_system_client_config config = {
+		.host = "127.0.0.1",
+		.port = SERVER_PORT,
+		.sec_tag = TEST_SEC_TAG,
+		.rx_buffer = sc_rx_buffer,
+		.rx_buffer_len = sizeof(sc_rx_buffer),
+		.loop = &loop,
+	};
+	struct golioth_system_client extra;
+	uint32_t pings;
+	int err;
+
+	err = golioth_system_client_loop_init(&loop, &loop_config);
+	zassert_ok(err, "Failed to initialize loop: %d", err);
+
+	for (int i = 0; i < ARRAY_SIZE(loop_sc); i++) {
+		system_client_inst_init(&loop_sc[i], loop_sc_rx_buffer[i],
+					sizeof(loop_sc_rx_buffer[i]), &loop, NULL, NULL, 0);
+	}
+
+	err = golioth_system_client_init(&extra, &config);
+	zassert_equal(err, -ENOMEM, "Instance added over loop capacity: %d", err);
+
+	for (int i = 0; i < ARRAY_SIZE(loop_sc); i++) {
+		golioth_system_client_inst_start(&loop_sc[i]);
+	}
+
+	for (int i = 0; i < ARRAY_SIZE(loop_sc); i++) {
+		zassert_true(wait_for_connected(&loop_sc[i], 5 * MSEC_PER_SEC),
+			     "Instance %d not connected", i);
+	}
+
+	atomic_clear(&server_pings);
+
+	k_sleep(K_MSEC(3 * PING_INTERVAL_MS));
+
+	pings = atomic_get(&server_pings);
+	for (int i = 0; i < ARRAY_SIZE(loop_sc); i++) {
+		zassert_true(golioth_is_connected(golioth_system_client_get_client(&loop_sc[i])),
+			     "Instance %d disconnected", i);
+	}
+
+	/* Each instance (and the instance with own thread) keeps sending pings */
+	zassert_true(pings >= 2 * (ARRAY_SIZE(loop_sc) + 1), "Too few pings: %u", pings);
+
+	for (int i = 0; i < ARRAY_SIZE(loop_sc); i++) {
+		golioth_system_client_inst_stop(&loop_sc[i]);
+	}
+}
+
+/*
+ * Without DTLS Connection ID (plain UDP here) network change makes instance reconnect right away,
+ * so server receives following pings from new socket.
+ */
+ZTEST(system_client, test_network_changed)
+{
+	atomic_val_t port;
+	int64_t end;
+
+	zassert_true(wait_for_connected(&sc, 5 * MSEC_PER_SEC), "Instance not connected");
+
+	/* Wait for ping to learn source port of current socket */
+	atomic_clear(&server_pings);
+	atomic_clear(&server_peer_port);
+	end = k_uptime_get() + 3 * PING_INTERVAL_MS;
+	while (!atomic_get(&server_pings) && k_uptime_get() < end) {
+		k_sleep(K_MSEC(10));
+	}
+
+	port = atomic_get(&server_peer_port);
+	zassert_not_equal(port, 0, "No ping received");
+
+	golioth_system_client_inst_network_changed(&sc);
+
+	end = k_uptime_get() + 3 * PING_INTERVAL_MS;
+	while (atomic_get(&server_peer_port) == port && k_uptime_get() < end) {
+		k_sleep(K_MSEC(10));
+	}
+
+	zassert_not_equal(atomic_get(&server_peer_port), port, "Instance did not reconnect");
+	zassert_true(wait_for_connected(&sc, 5 * MSEC_PER_SEC), "Instance not connected");
+}
+
+static void *system_client_setup(void)
+{
+	int err;
+
+	err = tls_credential_add(TEST_SEC_TAG, TLS_CREDENTIAL_PSK_ID,
+				 TEST_PSK_ID, sizeof(TEST_PSK_ID) - 1);
+	zassert_ok(err, "Failed to add PSK-ID: %d", err);
+
+	err = tls_credential_add(TEST_SEC_TAG, TLS_CREDENTIAL_PSK,
+				 TEST_PSK, sizeof(TEST_PSK) - 1);
+	zassert_ok(err, "Failed to add PSK: %d", err);
+
+	err = coap_test_server_start(SERVER_PORT, server_stack, K_THREAD_STACK_SIZEOF(server_stack),
+				     THREAD_PRIO);
+	zassert_ok(err, "Failed to start server: %d", err);
+
+	coap_test_server_handler_set(server_handle);
+
+	system_client_inst_init(&sc, sc_rx_buffer, sizeof(sc_rx_buffer), NULL,
+				&sc_thread, sc_stack, K_THREAD_STACK_SIZEOF(sc_stack));
+
+	golioth_system_client_inst_start(&sc);
+
+	return NULL;
+}
+
+static void system_client_before(void *fixture)
+{
+	atomic_set(&server_online, 1);
+}
+
+ZTEST_SUITE(system_client, NULL, system_client_setup, system_client_before, NULL, NULL);